@@ -6,27 +6,37 @@
 
 /* Method predeclarations */
 /* Memory management */
-void *AVLAllocNode(NODE pNode);
+void *AVLAllocTreeAux(TREE pTree);
 
 /* AVL height and balancing */
-int AVLGetHeight(NODE pNode);
 void AVLSetHeight(NODE pNode);
 int AVLBalanceFactor(NODE pNode);
 void AVLRotationSetHeights(NODE pNode);
-void AVLBalance(NODE pNode);
 void AVLRemoveBalance(NODE pNode, unsigned char ucOriginal);
+void AVLBuildSetHeight(NODE pNode, int nDepth);
+
+/* Split and join on detached subtrees */
+NODE AVLRotateLeftNode(NODE pNode);
+NODE AVLRotateRightNode(NODE pNode);
+NODE AVLJoinRight(NODE pLeft, NODE pNode, NODE pRight);
+NODE AVLJoinLeft(NODE pLeft, NODE pNode, NODE pRight);
+NODE AVLJoinNodes(NODE pLeft, NODE pNode, NODE pRight);
+NODE AVLSplitLast(NODE pNode, NODE *ppLast);
+NODE AVLSplitRecurse(NODE pNode, KEY uKey, TREE pTree, NODE *ppLeft, NODE *ppRight);
+NODE AVLFirst(NODE pNode);
+NODE AVLLast(NODE pNode);
+unsigned char AVLCanMove(TREE pFrom, TREE pTo);
+int AVLReown(NODE pNode, TREE pTree);
+void AVLMoveCounters(TREE pFrom, TREE pTo, int nCount);
 
 /*
- * Allocate an AVL node and return it to be attached to a tree Node.
+ * Prepare a new AVL tree, reserving room for the AVL node data
+ * inline in every tree Node.
  */
-void *AVLAllocNode(NODE pNode)
+void *AVLAllocTreeAux(TREE pTree)
 {
-    AVLNODE pAVLNode;
-
-    pAVLNode = (AVLNODE)malloc(sizeof(*pAVLNode));
-    pAVLNode->nHeight = 0;
-
-    return pAVLNode;
+    pTree->nNodeMetaSize = sizeof(struct AVLNode);
+    return NULL;
 }
 
 /*
@@ -34,7 +44,7 @@ void *AVLAllocNode(NODE pNode)
  */
 int AVLGetHeight(NODE pNode)
 {
-    return (pNode != NULL ? ((AVLNODE)pNode->pAuxiliary)->nHeight : -1);
+    return (pNode != NULL ? AVL_NODE(pNode)->nHeight : -1);
 }
 
 /*
@@ -44,7 +54,7 @@ void AVLSetHeight(NODE pNode)
 {
     int nLeftHeight = AVLGetHeight(pNode->pLeftChild);
     int nRightHeight = AVLGetHeight(pNode->pRightChild);
-    ((AVLNODE)pNode->pAuxiliary)->nHeight = (nLeftHeight > nRightHeight ? nLeftHeight : nRightHeight) + 1;
+    AVL_NODE(pNode)->nHeight = (nLeftHeight > nRightHeight ? nLeftHeight : nRightHeight) + 1;
 }
 
 /*
@@ -68,14 +78,23 @@ void AVLRotationSetHeights(NODE pNode)
 }
 
 /*
- * Balance the AVL tree, performing rotations if necessary.
+ * Balance the AVL tree, performing rotations if necessary. The walk up
+ * stops once a subtree's height is unchanged, as nothing above it can
+ * have changed either; after an insertion that is at most a rotation
+ * away, so appending sorted keys costs amortized constant work.
  */
 void AVLBalance(NODE pNode)
 {
     int nBalance = 0;
     int nChildBalance = 0;
+    int nHeight;
+    unsigned char ucFirst = TRUE;
     while (pNode != NULL)
     {
+        TREE_STAT(pNode->pTree, nRetraceSteps, 1);
+        /* The starting node may be a new leaf, whose height was never stored */
+        nHeight = ucFirst ? -1 : AVL_NODE(pNode)->nHeight;
+        ucFirst = FALSE;
         AVLSetHeight(pNode);
         nBalance = AVLBalanceFactor(pNode);
 
@@ -101,6 +120,10 @@ void AVLBalance(NODE pNode)
                 pNode = LeftRotation(pNode);
             }
         }
+        if (AVL_NODE(pNode)->nHeight == nHeight)
+        {
+            break;
+        }
         pNode = pNode->pParent;
     }
 }
@@ -113,15 +136,431 @@ void AVLRemoveBalance(NODE pNode, unsigned char ucOriginal)
     AVLBalance(pNode);
 }
 
+/*
+ * Set the height of a node placed by a bulk build (children are already set).
+ */
+void AVLBuildSetHeight(NODE pNode, int nDepth)
+{
+    AVLSetHeight(pNode);
+}
+
 /*
  * Allocate a new tree and establish the appropriate callbacks.
+ * nFlags is a combination of the TREE_* creation flags.
  */
-TREE AVLAllocTree()
+TREE AVLAllocTree(int nFlags)
 {
-    TREE pTree = AllocTree(NULL);
-    pTree->cbAllocNode = AVLAllocNode;
+    TREE pTree = AllocTree(AVLAllocTreeAux, nFlags);
     pTree->cbInsert = AVLBalance;
     pTree->cbRemove = AVLRemoveBalance;
     pTree->cbRotation = AVLRotationSetHeights;
+    pTree->cbBuild = AVLBuildSetHeight;
     return pTree;
+}
+
+/*
+ * Make pLeft and pRight the children of a detached node and return the
+ * node, its height (and subtree size) recomputed.
+ */
+NODE AVLLink(NODE pLeft, NODE pNode, NODE pRight)
+{
+    pNode->pLeftChild = pLeft;
+    pNode->pRightChild = pRight;
+    if (pLeft != NULL)
+    {
+        pLeft->pParent = pNode;
+    }
+    if (pRight != NULL)
+    {
+        pRight->pParent = pNode;
+    }
+    AVLSetHeight(pNode);
+    if (pNode->pTree->nFlags & TREE_ORDER_STATS)
+    {
+        NODE_COUNT(pNode) = (pLeft != NULL ? NODE_COUNT(pLeft) : 0) +
+            (pRight != NULL ? NODE_COUNT(pRight) : 0) + 1;
+    }
+    return pNode;
+}
+
+/*
+ * Left rotation of a detached subtree, returning its new root. Unlike
+ * LeftRotation it leaves the tree's root alone.
+ */
+NODE AVLRotateLeftNode(NODE pNode)
+{
+    NODE pChild = pNode->pRightChild;
+    TREE_STAT(pNode->pTree, nRotations, 1);
+    AVLLink(pNode->pLeftChild, pNode, pChild->pLeftChild);
+    return AVLLink(pNode, pChild, pChild->pRightChild);
+}
+
+/*
+ * Right rotation of a detached subtree, returning its new root.
+ */
+NODE AVLRotateRightNode(NODE pNode)
+{
+    NODE pChild = pNode->pLeftChild;
+    TREE_STAT(pNode->pTree, nRotations, 1);
+    AVLLink(pChild->pRightChild, pNode, pNode->pRightChild);
+    return AVLLink(pChild->pLeftChild, pChild, pNode);
+}
+
+/*
+ * Join when pLeft is the taller subtree: walk down its right spine to
+ * a subtree as high as pRight, link there and rebalance on the way up.
+ */
+NODE AVLJoinRight(NODE pLeft, NODE pNode, NODE pRight)
+{
+    NODE pLeftChild = pLeft->pLeftChild, pChild = pLeft->pRightChild;
+
+    if (AVLGetHeight(pChild) <= AVLGetHeight(pRight) + 1)
+    {
+        pChild = AVLLink(pChild, pNode, pRight);
+        if (AVLGetHeight(pChild) <= AVLGetHeight(pLeftChild) + 1)
+        {
+            return AVLLink(pLeftChild, pLeft, pChild);
+        }
+        return AVLRotateLeftNode(AVLLink(pLeftChild, pLeft, AVLRotateRightNode(pChild)));
+    }
+
+    pChild = AVLJoinRight(pChild, pNode, pRight);
+    AVLLink(pLeftChild, pLeft, pChild);
+    if (AVLGetHeight(pChild) <= AVLGetHeight(pLeftChild) + 1)
+    {
+        return pLeft;
+    }
+    return AVLRotateLeftNode(pLeft);
+}
+
+/*
+ * Join when pRight is the taller subtree, mirroring AVLJoinRight.
+ */
+NODE AVLJoinLeft(NODE pLeft, NODE pNode, NODE pRight)
+{
+    NODE pRightChild = pRight->pRightChild, pChild = pRight->pLeftChild;
+
+    if (AVLGetHeight(pChild) <= AVLGetHeight(pLeft) + 1)
+    {
+        pChild = AVLLink(pLeft, pNode, pChild);
+        if (AVLGetHeight(pChild) <= AVLGetHeight(pRightChild) + 1)
+        {
+            return AVLLink(pChild, pRight, pRightChild);
+        }
+        return AVLRotateRightNode(AVLLink(AVLRotateLeftNode(pChild), pRight, pRightChild));
+    }
+
+    pChild = AVLJoinLeft(pLeft, pNode, pChild);
+    AVLLink(pChild, pRight, pRightChild);
+    if (AVLGetHeight(pChild) <= AVLGetHeight(pRightChild) + 1)
+    {
+        return pRight;
+    }
+    return AVLRotateRightNode(pRight);
+}
+
+/*
+ * Join two detached AVL subtrees, every key of pLeft less than pNode's
+ * and every key of pRight greater, into one. Takes O(height difference).
+ * In-order links are left alone.
+ */
+NODE AVLJoinNodes(NODE pLeft, NODE pNode, NODE pRight)
+{
+    if (AVLGetHeight(pLeft) > AVLGetHeight(pRight) + 1)
+    {
+        return AVLJoinRight(pLeft, pNode, pRight);
+    }
+    if (AVLGetHeight(pRight) > AVLGetHeight(pLeft) + 1)
+    {
+        return AVLJoinLeft(pLeft, pNode, pRight);
+    }
+    return AVLLink(pLeft, pNode, pRight);
+}
+
+/*
+ * Join as AVLJoinNodes, also threading pNode between the last node of
+ * pLeft and the first of pRight if the tree is threaded.
+ */
+NODE AVLJoinThreaded(NODE pLeft, NODE pNode, NODE pRight)
+{
+    NODE pPrevious, pNext;
+
+    if (pNode->pTree->nFlags & TREE_THREADED)
+    {
+        pPrevious = AVLLast(pLeft);
+        pNext = AVLFirst(pRight);
+        NODE_LINKS(pNode)->pPrevious = pPrevious;
+        NODE_LINKS(pNode)->pNext = pNext;
+        if (pPrevious != NULL)
+        {
+            NODE_LINKS(pPrevious)->pNext = pNode;
+        }
+        if (pNext != NULL)
+        {
+            NODE_LINKS(pNext)->pPrevious = pNode;
+        }
+    }
+    return AVLJoinNodes(pLeft, pNode, pRight);
+}
+
+/*
+ * Join two detached subtrees without a middle node, using the last
+ * node of pLeft as the middle node.
+ */
+NODE AVLJoin2(NODE pLeft, NODE pRight)
+{
+    NODE pLast, pFirst;
+
+    if (pLeft == NULL)
+    {
+        return pRight;
+    }
+    if (pRight == NULL)
+    {
+        return pLeft;
+    }
+
+    pFirst = AVLFirst(pRight);
+    pLeft = AVLSplitLast(pLeft, &pLast);
+    if (pLast->pTree->nFlags & TREE_THREADED)
+    {
+        NODE_LINKS(pLast)->pNext = pFirst;
+        NODE_LINKS(pFirst)->pPrevious = pLast;
+    }
+    return AVLJoinNodes(pLeft, pLast, pRight);
+}
+
+/*
+ * Detach the last node of a subtree into *ppLast, returning the rest.
+ */
+NODE AVLSplitLast(NODE pNode, NODE *ppLast)
+{
+    if (pNode->pRightChild == NULL)
+    {
+        *ppLast = pNode;
+        return pNode->pLeftChild;
+    }
+    return AVLJoinNodes(pNode->pLeftChild, pNode, AVLSplitLast(pNode->pRightChild, ppLast));
+}
+
+/*
+ * Split a detached subtree into the subtrees of keys less than and
+ * greater than uKey, returning the node holding uKey (detached) or NULL.
+ * Takes O(height). In a threaded tree the in-order links across the
+ * split are cut, so each piece's links end in NULL.
+ */
+NODE AVLSplitNodes(NODE pNode, KEY uKey, TREE pTree, NODE *ppLeft, NODE *ppRight)
+{
+    NODE pFound, pLast, pFirst;
+
+    pFound = AVLSplitRecurse(pNode, uKey, pTree, ppLeft, ppRight);
+    if (pTree->nFlags & TREE_THREADED)
+    {
+        pLast = AVLLast(*ppLeft);
+        pFirst = AVLFirst(*ppRight);
+        if (pLast != NULL)
+        {
+            NODE_LINKS(pLast)->pNext = NULL;
+        }
+        if (pFirst != NULL)
+        {
+            NODE_LINKS(pFirst)->pPrevious = NULL;
+        }
+        if (pFound != NULL)
+        {
+            NODE_LINKS(pFound)->pPrevious = NULL;
+            NODE_LINKS(pFound)->pNext = NULL;
+        }
+    }
+    return pFound;
+}
+
+/*
+ * Recursive part of AVLSplitNodes: nodes on the search path are joined
+ * back onto the side they belong to.
+ */
+NODE AVLSplitRecurse(NODE pNode, KEY uKey, TREE pTree, NODE *ppLeft, NODE *ppRight)
+{
+    NODE pFound, pPiece;
+    int nCompare;
+
+    if (pNode == NULL)
+    {
+        *ppLeft = NULL;
+        *ppRight = NULL;
+        return NULL;
+    }
+
+    nCompare = COMPARE_KEYS(pTree, uKey, pNode->uKey);
+    if (nCompare == 0)
+    {
+        *ppLeft = pNode->pLeftChild;
+        *ppRight = pNode->pRightChild;
+        return pNode;
+    }
+    if (nCompare < 0)
+    {
+        pFound = AVLSplitRecurse(pNode->pLeftChild, uKey, pTree, ppLeft, &pPiece);
+        *ppRight = AVLJoinNodes(pPiece, pNode, pNode->pRightChild);
+    }
+    else
+    {
+        pFound = AVLSplitRecurse(pNode->pRightChild, uKey, pTree, &pPiece, ppRight);
+        *ppLeft = AVLJoinNodes(pNode->pLeftChild, pNode, pPiece);
+    }
+    return pFound;
+}
+
+/*
+ * Return the first node of a subtree, NULL if it is empty.
+ */
+NODE AVLFirst(NODE pNode)
+{
+    while (pNode != NULL && pNode->pLeftChild != NULL)
+    {
+        pNode = pNode->pLeftChild;
+    }
+    return pNode;
+}
+
+/*
+ * Return the last node of a subtree, NULL if it is empty.
+ */
+NODE AVLLast(NODE pNode)
+{
+    while (pNode != NULL && pNode->pRightChild != NULL)
+    {
+        pNode = pNode->pRightChild;
+    }
+    return pNode;
+}
+
+/*
+ * Check that nodes may move from one AVL tree to another: both trees
+ * unpooled, alike and with no iterators attached.
+ */
+unsigned char AVLCanMove(TREE pFrom, TREE pTo)
+{
+    return (pFrom != pTo &&
+        pFrom->cbInsert == AVLBalance && pTo->cbInsert == AVLBalance &&
+        pFrom->pNodePool == NULL && pTo->pNodePool == NULL &&
+        pFrom->nFlags == pTo->nFlags &&
+        pFrom->nKeyType == pTo->nKeyType && pFrom->cbCompare == pTo->cbCompare &&
+        pFrom->nIterators == 0 && pTo->nIterators == 0);
+}
+
+/*
+ * Hand every node of a subtree over to another tree, returning the
+ * number of nodes moved.
+ */
+int AVLReown(NODE pNode, TREE pTree)
+{
+    if (pNode == NULL)
+    {
+        return 0;
+    }
+    pNode->pTree = pTree;
+    return AVLReown(pNode->pLeftChild, pTree) + AVLReown(pNode->pRightChild, pTree) + 1;
+}
+
+/*
+ * Move the memory counters of nCount nodes from one tree to another.
+ */
+void AVLMoveCounters(TREE pFrom, TREE pTo, int nCount)
+{
+    pFrom->sCounters.nObjects -= nCount;
+    pFrom->sCounters.nBytes -= (long)(nCount * pFrom->nNodeSize);
+    pTo->sCounters.nObjects += nCount;
+    pTo->sCounters.nBytes += (long)(nCount * pTo->nNodeSize);
+    if (pTo->sCounters.nObjects > pTo->sCounters.nPeakObjects)
+    {
+        pTo->sCounters.nPeakObjects = pTo->sCounters.nObjects;
+    }
+    if (pTo->sCounters.nBytes > pTo->sCounters.nPeakBytes)
+    {
+        pTo->sCounters.nPeakBytes = pTo->sCounters.nBytes;
+    }
+}
+
+/*
+ * Install a joined subtree as a tree's root, refreshing its first and
+ * last nodes. The size is left to the caller.
+ */
+void AVLSetRoot(TREE pTree, NODE pRoot)
+{
+    pTree->pRoot = pRoot;
+    if (pRoot != NULL)
+    {
+        pRoot->pParent = NULL;
+    }
+    pTree->pFirst = AVLFirst(pRoot);
+    pTree->pLast = AVLLast(pRoot);
+}
+
+/*
+ * Split a tree, moving every key greater than uKey into the empty tree
+ * pRight. Both trees must be unpooled AVL trees created with the same
+ * flags and key type. Restructuring takes O(log n), but every moved node
+ * is handed over to pRight as well. Returns FALSE if the trees don't
+ * qualify.
+ */
+unsigned char AVLSplit(TREE pTree, KEY uKey, TREE pRight)
+{
+    NODE pLeftNodes, pRightNodes, pFound;
+    int nMoved;
+
+    if (!AVLCanMove(pTree, pRight) || pRight->pRoot != NULL)
+    {
+        return FALSE;
+    }
+
+    pFound = AVLSplitNodes(pTree->pRoot, uKey, pTree, &pLeftNodes, &pRightNodes);
+    if (pFound != NULL)
+    {
+        pLeftNodes = AVLJoinThreaded(pLeftNodes, pFound, NULL);
+    }
+
+    nMoved = AVLReown(pRightNodes, pRight);
+    AVLMoveCounters(pTree, pRight, nMoved);
+    AVLSetRoot(pTree, pLeftNodes);
+    AVLSetRoot(pRight, pRightNodes);
+    pTree->nSize -= nMoved;
+    pRight->nSize = nMoved;
+    return TRUE;
+}
+
+/*
+ * Join a key and the whole of pRight onto pLeft, leaving pRight empty.
+ * Every key of pLeft must be less than uKey and every key of pRight
+ * greater. Both trees must be unpooled AVL trees created with the same
+ * flags and key type. Restructuring takes O(log n), but every node of
+ * pRight is handed over to pLeft as well. Returns FALSE if the trees or
+ * keys don't qualify.
+ */
+unsigned char AVLJoin(TREE pLeft, KEY uKey, void *pContent, TREE pRight)
+{
+    NODE pNode;
+    int nMoved;
+
+    if (!AVLCanMove(pRight, pLeft))
+    {
+        return FALSE;
+    }
+    if ((pLeft->pLast != NULL && COMPARE_KEYS(pLeft, pLeft->pLast->uKey, uKey) >= 0) ||
+        (pRight->pFirst != NULL && COMPARE_KEYS(pLeft, uKey, pRight->pFirst->uKey) >= 0))
+    {
+        return FALSE;
+    }
+
+    pNode = AllocNode(pLeft);
+    pNode->uKey = uKey;
+    pNode->pContent = pContent;
+
+    nMoved = AVLReown(pRight->pRoot, pLeft);
+    AVLMoveCounters(pRight, pLeft, nMoved);
+    AVLSetRoot(pLeft, AVLJoinThreaded(pLeft->pRoot, pNode, pRight->pRoot));
+    AVLSetRoot(pRight, NULL);
+    pLeft->nSize += nMoved + 1;
+    pRight->nSize = 0;
+    return TRUE;
 }
\ No newline at end of file
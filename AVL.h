@@ -10,14 +10,30 @@
 #include "BinarySearchTree.h"
 
 
-/* Represents extra node data required for AVL */
+/* Represents extra node data required for AVL, stored inline after each node */
 typedef struct AVLNode
 {
     short int nHeight;
 } *AVLNODE;
 
+/* Access the AVL data of a tree Node */
+#define AVL_NODE(pNode) ((AVLNODE)NODE_META(pNode))
+
 
 /* Allocate AVL tree */
-TREE AVLAllocTree(void);
+TREE AVLAllocTree(int nFlags);
+
+/* Split and join, between unpooled AVL trees created with the same flags */
+unsigned char AVLSplit(TREE pTree, KEY uKey, TREE pRight);
+unsigned char AVLJoin(TREE pLeft, KEY uKey, void *pContent, TREE pRight);
+
+/* Balancing and detached subtree operations, shared with AVLSet.c */
+void AVLBalance(NODE pNode);
+int AVLGetHeight(NODE pNode);
+NODE AVLLink(NODE pLeft, NODE pNode, NODE pRight);
+NODE AVLJoinThreaded(NODE pLeft, NODE pNode, NODE pRight);
+NODE AVLJoin2(NODE pLeft, NODE pRight);
+NODE AVLSplitNodes(NODE pNode, KEY uKey, TREE pTree, NODE *ppLeft, NODE *ppRight);
+void AVLSetRoot(TREE pTree, NODE pRoot);
 
 #endif /* __AVL_H__ */
\ No newline at end of file
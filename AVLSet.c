@@ -0,0 +1,217 @@
+#include <stdlib.h>
+
+#include "BinarySearchTree.h"
+#include "AVL.h"
+#include "AVLSet.h"
+
+/* Method predeclarations */
+/* Set operations */
+unsigned char AVLSetOperation(TREE pTree, TREE pOther, TASKPOOL pPool, int nOperation);
+void AVLSetTaskRun(TASKWORKER pWorker, void *pArgument);
+NODE AVLSetNodes(TASKWORKER pWorker, AVLSETOPERATION pOperation, NODE pMine, NODE pOther, int *pnChange);
+NODE AVLCopyNodes(AVLSETOPERATION pOperation, NODE pOther, NODE *ppPrevious, int *pnChange);
+int AVLFreeNodes(AVLSETOPERATION pOperation, NODE pNode);
+
+/*
+ * Add every key of pOther missing from pTree, with its contents.
+ */
+unsigned char AVLUnion(TREE pTree, TREE pOther, TASKPOOL pPool)
+{
+    return AVLSetOperation(pTree, pOther, pPool, AVL_UNION);
+}
+
+/*
+ * Remove every key of pTree missing from pOther.
+ */
+unsigned char AVLIntersection(TREE pTree, TREE pOther, TASKPOOL pPool)
+{
+    return AVLSetOperation(pTree, pOther, pPool, AVL_INTERSECTION);
+}
+
+/*
+ * Remove every key of pTree found in pOther.
+ */
+unsigned char AVLDifference(TREE pTree, TREE pOther, TASKPOOL pPool)
+{
+    return AVLSetOperation(pTree, pOther, pPool, AVL_DIFFERENCE);
+}
+
+/*
+ * Run a set operation, in parallel on the pool's threads if given one.
+ * pOther must be a different AVL tree with the same key type, but may
+ * have other flags. It is only read, so it may be searched meanwhile.
+ * Returns FALSE if the trees don't qualify or pTree has iterators.
+ */
+unsigned char AVLSetOperation(TREE pTree, TREE pOther, TASKPOOL pPool, int nOperation)
+{
+    struct AVLSetOperation sOperation;
+    struct AVLSetTask sTask;
+
+    if (pTree == pOther || pTree->nIterators > 0 ||
+        pTree->cbInsert != AVLBalance || pOther->cbInsert != AVLBalance ||
+        pTree->nKeyType != pOther->nKeyType || pTree->cbCompare != pOther->cbCompare)
+    {
+        return FALSE;
+    }
+
+    sOperation.pTree = pTree;
+    sOperation.nOperation = nOperation;
+    pthread_mutex_init(&sOperation.sLock, NULL);
+    sTask.pOperation = &sOperation;
+    sTask.pMine = pTree->pRoot;
+    sTask.pOther = pOther->pRoot;
+
+    if (pPool != NULL)
+    {
+        TaskPoolRun(pPool, AVLSetTaskRun, &sTask);
+    }
+    else
+    {
+        AVLSetTaskRun(NULL, &sTask);
+    }
+
+    pthread_mutex_destroy(&sOperation.sLock);
+    AVLSetRoot(pTree, sTask.pResult);
+    pTree->nSize += sTask.nChange;
+    return TRUE;
+}
+
+/*
+ * Task running a set operation on a pair of subtrees.
+ */
+void AVLSetTaskRun(TASKWORKER pWorker, void *pArgument)
+{
+    AVLSETTASK pTask = (AVLSETTASK)pArgument;
+    pTask->nChange = 0;
+    pTask->pResult = AVLSetNodes(pWorker, pTask->pOperation, pTask->pMine, pTask->pOther, &pTask->nChange);
+}
+
+/*
+ * Apply a set operation to a subtree of pTree and one of the other
+ * tree, returning the resulting subtree. pMine is split by the root key
+ * of pOther, the halves are processed against pOther's children (the
+ * left half as a task when the subtrees are high enough and there is a
+ * worker) and then joined back together.
+ */
+NODE AVLSetNodes(TASKWORKER pWorker, AVLSETOPERATION pOperation, NODE pMine, NODE pOther, int *pnChange)
+{
+    TREE pTree = pOperation->pTree;
+    NODE pFound, pLeft, pRight, pPrevious = NULL;
+    struct AVLSetTask sLeftTask;
+    struct Task sTask;
+
+    if (pOther == NULL)
+    {
+        if (pOperation->nOperation == AVL_INTERSECTION)
+        {
+            *pnChange -= AVLFreeNodes(pOperation, pMine);
+            return NULL;
+        }
+        return pMine;
+    }
+    if (pMine == NULL)
+    {
+        if (pOperation->nOperation == AVL_UNION)
+        {
+            return AVLCopyNodes(pOperation, pOther, &pPrevious, pnChange);
+        }
+        return NULL;
+    }
+
+    pFound = AVLSplitNodes(pMine, pOther->uKey, pTree, &pLeft, &pRight);
+
+    sLeftTask.pOperation = pOperation;
+    sLeftTask.pMine = pLeft;
+    sLeftTask.pOther = pOther->pLeftChild;
+    if (pWorker != NULL && AVLGetHeight(pOther) >= AVL_PARALLEL_HEIGHT)
+    {
+        TaskSpawn(pWorker, &sTask, AVLSetTaskRun, &sLeftTask);
+        pRight = AVLSetNodes(pWorker, pOperation, pRight, pOther->pRightChild, pnChange);
+        TaskWait(pWorker, &sTask);
+    }
+    else
+    {
+        AVLSetTaskRun(pWorker, &sLeftTask);
+        pRight = AVLSetNodes(pWorker, pOperation, pRight, pOther->pRightChild, pnChange);
+    }
+    pLeft = sLeftTask.pResult;
+    *pnChange += sLeftTask.nChange;
+
+    if (pOperation->nOperation == AVL_UNION && pFound == NULL)
+    {
+        pthread_mutex_lock(&pOperation->sLock);
+        pFound = AllocNode(pTree);
+        pthread_mutex_unlock(&pOperation->sLock);
+        pFound->uKey = pOther->uKey;
+        pFound->pContent = pOther->pContent;
+        (*pnChange)++;
+    }
+    else if (pOperation->nOperation == AVL_DIFFERENCE && pFound != NULL)
+    {
+        pthread_mutex_lock(&pOperation->sLock);
+        FreeNode(pFound);
+        pthread_mutex_unlock(&pOperation->sLock);
+        pFound = NULL;
+        (*pnChange)--;
+    }
+
+    if (pFound != NULL)
+    {
+        return AVLJoinThreaded(pLeft, pFound, pRight);
+    }
+    return AVLJoin2(pLeft, pRight);
+}
+
+/*
+ * Copy a subtree of the other tree into pTree's nodes, keeping its
+ * shape. *ppPrevious is the last node copied so far, for threading,
+ * and *pnChange counts the nodes copied.
+ */
+NODE AVLCopyNodes(AVLSETOPERATION pOperation, NODE pOther, NODE *ppPrevious, int *pnChange)
+{
+    NODE pNode, pLeft;
+
+    if (pOther == NULL)
+    {
+        return NULL;
+    }
+
+    pLeft = AVLCopyNodes(pOperation, pOther->pLeftChild, ppPrevious, pnChange);
+    pthread_mutex_lock(&pOperation->sLock);
+    pNode = AllocNode(pOperation->pTree);
+    pthread_mutex_unlock(&pOperation->sLock);
+    pNode->uKey = pOther->uKey;
+    pNode->pContent = pOther->pContent;
+    if (pOperation->pTree->nFlags & TREE_THREADED)
+    {
+        NODE_LINKS(pNode)->pPrevious = *ppPrevious;
+        NODE_LINKS(pNode)->pNext = NULL;
+        if (*ppPrevious != NULL)
+        {
+            NODE_LINKS(*ppPrevious)->pNext = pNode;
+        }
+    }
+    *ppPrevious = pNode;
+    (*pnChange)++;
+
+    return AVLLink(pLeft, pNode, AVLCopyNodes(pOperation, pOther->pRightChild, ppPrevious, pnChange));
+}
+
+/*
+ * Free every node of a detached subtree, returning the number freed.
+ */
+int AVLFreeNodes(AVLSETOPERATION pOperation, NODE pNode)
+{
+    int nCount;
+
+    if (pNode == NULL)
+    {
+        return 0;
+    }
+
+    nCount = AVLFreeNodes(pOperation, pNode->pLeftChild) + AVLFreeNodes(pOperation, pNode->pRightChild) + 1;
+    pthread_mutex_lock(&pOperation->sLock);
+    FreeNode(pNode);
+    pthread_mutex_unlock(&pOperation->sLock);
+    return nCount;
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+/*
+ * Set operations between AVL trees, splitting one tree by the keys of
+ * the other and joining the results, optionally in parallel on a task
+ * pool. Kept apart from AVL.c so plain AVL trees need no threads.
+ *
+ * Adam Doyle
+ */
+
+#ifndef __AVLSET_H__
+#define __AVLSET_H__
+
+#include "BinarySearchTree.h"
+#include "AVL.h"
+#include "TaskPool.h"
+
+
+/* Set operations on subtrees at least this high are split across a task pool */
+#define AVL_PARALLEL_HEIGHT 10
+
+
+/* Set operations */
+#define AVL_UNION 0
+#define AVL_INTERSECTION 1
+#define AVL_DIFFERENCE 2
+
+/* Represents a set operation shared by all of its tasks */
+typedef struct AVLSetOperation
+{
+    TREE pTree; /* Tree being updated */
+    int nOperation; /* One of the AVL_* set operations */
+    pthread_mutex_t sLock; /* Serializes node allocation between tasks */
+} *AVLSETOPERATION;
+
+/* Represents a set operation on a pair of subtrees, run as a task */
+typedef struct AVLSetTask
+{
+    AVLSETOPERATION pOperation;
+    NODE pMine; /* Subtree of pTree, consumed by the task */
+    NODE pOther; /* Subtree of the other tree, only read */
+    NODE pResult; /* Resulting subtree */
+    int nChange; /* Number of nodes added to (or removed from, if negative) pTree */
+} *AVLSETTASK;
+
+
+/* Set operations updating pTree in place from another AVL tree, which is left untouched. pPool may be NULL */
+unsigned char AVLUnion(TREE pTree, TREE pOther, TASKPOOL pPool);
+unsigned char AVLIntersection(TREE pTree, TREE pOther, TASKPOOL pPool);
+unsigned char AVLDifference(TREE pTree, TREE pOther, TASKPOOL pPool);
+
+#endif /* __AVLSET_H__ */
\ No newline at end of file
@@ -0,0 +1,774 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "BinarySearchTree.h"
+#include "BTree.h"
+
+/* Method predeclarations */
+/* Memory management */
+void *BTreeAllocTreeAux(TREE pTree);
+void BTreeFree(TREE pTree);
+BTREENODE BTreeAllocNode(TREE pTree, unsigned char ucLeaf);
+void BTreeFreeNode(BTREENODE pNode, TREE pTree);
+void BTreeFreeNodes(BTREENODE pNode, TREE pTree);
+
+/* Searching */
+int BTreeFindSlot(BTREENODE pNode, KEY uKey, TREE pTree, unsigned char ucStrict);
+BTREENODE BTreeFindLeaf(KEY uKey, TREE pTree);
+void *BTreeSearch(KEY uKey, TREE pTree);
+void **BTreeSlot(KEY uKey, TREE pTree);
+
+/* Insertion */
+unsigned char BTreeInsert(KEY uKey, void *pContent, TREE pTree);
+unsigned char BTreeInsertInto(BTREENODE pNode, KEY uKey, void *pContent, TREE pTree, KEY *pSplitKey, BTREENODE *ppSplit);
+unsigned char BTreeBuild(KEY *pKeys, void **ppContents, int nCount, TREE pTree);
+BTREENODE BTreeSplitLeaf(BTREENODE pNode, int nSlot, KEY uKey, void *pContent, TREE pTree);
+BTREENODE BTreeSplitInner(BTREENODE pNode, int nSlot, KEY uKey, BTREENODE pChild, TREE pTree, KEY *pSplitKey);
+
+/* Removal */
+unsigned char BTreeRemove(KEY uKey, TREE pTree, void **ppContent);
+unsigned char BTreeRemoveFrom(BTREENODE pNode, KEY uKey, TREE pTree, void **ppContent);
+void BTreeFixChild(BTREENODE pParent, int nSlot, TREE pTree);
+void BTreeBorrowLeft(BTREENODE pParent, int nSlot);
+void BTreeBorrowRight(BTREENODE pParent, int nSlot);
+void BTreeMerge(BTREENODE pParent, int nSlot, TREE pTree);
+
+/* Iteration */
+void BTreeSeekEnd(ITERATOR pIter, unsigned char ucDirection);
+void BTreeSeek(ITERATOR pIter, KEY uKey, unsigned char ucStrict);
+void BTreeStep(ITERATOR pIter, unsigned char ucDirection);
+void BTreeCurrent(ITERATOR pIter, KEY *pKey, void **ppContent);
+
+/* Operations forwarded to by the core tree */
+static struct TreeEngine sBTreeEngine =
+{
+    BTreeFree,
+    BTreeSearch,
+    BTreeInsert,
+    BTreeRemove,
+    BTreeSeekEnd,
+    BTreeSeek,
+    BTreeStep,
+    BTreeCurrent,
+    NULL,
+    BTreeSlot,
+    BTreeBuild,
+    NULL
+};
+
+/* Binary search over the keys of a node for the first slot past uKey
+ * (or, unless ucStrict, the first slot not less than uKey) */
+#define SLOT_LOOP(COMPARE) \
+    while (nLow < nHigh) \
+    { \
+        nMiddle = (nLow + nHigh) / 2; \
+        TREE_STAT(pTree, nComparisons, 1); \
+        nCompare = COMPARE; \
+        if (nCompare < 0 || (nCompare == 0 && ucStrict)) \
+        { \
+            nLow = nMiddle + 1; \
+        } \
+        else \
+        { \
+            nHigh = nMiddle; \
+        } \
+    }
+
+/*
+ * Allocate a tree whose entries are stored in a B+ tree
+ * instead of binary nodes.
+ */
+TREE BTreeAllocTree(int nFlags)
+{
+    return AllocTree(BTreeAllocTreeAux, nFlags & ~(TREE_THREADED | TREE_ORDER_STATS));
+}
+
+/*
+ * Prepare a new B+ tree, installing the engine and sizing the
+ * tree's pool for B+ tree nodes.
+ */
+void *BTreeAllocTreeAux(TREE pTree)
+{
+    BTREE pBTree;
+
+    pBTree = (BTREE)malloc(sizeof(*pBTree));
+    pBTree->pRoot = NULL;
+    pBTree->pFirstLeaf = NULL;
+    pBTree->pLastLeaf = NULL;
+
+    pTree->pEngine = &sBTreeEngine;
+    pTree->nNodeSize = sizeof(struct BTreeNode);
+
+    return pBTree;
+}
+
+/*
+ * Free every B+ tree node, unless the tree's pool releases
+ * them in bulk, along with the B+ tree data.
+ */
+void BTreeFree(TREE pTree)
+{
+    BTREE pBTree = BTREE_DATA(pTree);
+
+    if (pTree->pNodePool == NULL && pBTree->pRoot != NULL)
+    {
+        BTreeFreeNodes(pBTree->pRoot, pTree);
+    }
+
+    free(pBTree);
+    pTree->pAuxiliary = NULL;
+}
+
+/*
+ * Allocate an empty node from the tree's pool if it has one.
+ */
+BTREENODE BTreeAllocNode(TREE pTree, unsigned char ucLeaf)
+{
+    BTREENODE pNode;
+
+    if (pTree->pNodePool != NULL)
+    {
+        pNode = (BTREENODE)PoolAlloc(pTree->pNodePool);
+    }
+    else
+    {
+        pNode = (BTREENODE)CountedMalloc(pTree->nNodeSize, &pTree->sCounters);
+    }
+    pNode->nCount = 0;
+    pNode->ucLeaf = ucLeaf;
+    pNode->pNext = NULL;
+    pNode->pPrevious = NULL;
+
+    return pNode;
+}
+
+/*
+ * Free a node's memory, returning it to the tree's pool if
+ * it has one.
+ */
+void BTreeFreeNode(BTREENODE pNode, TREE pTree)
+{
+    if (pTree->pNodePool != NULL)
+    {
+        PoolFree(pTree->pNodePool, pNode);
+    }
+    else
+    {
+        CountedFree(pNode, pTree->nNodeSize, &pTree->sCounters);
+    }
+}
+
+/*
+ * Free a node and everything below it. The recursion is bounded
+ * by the height of the tree, which stays very small.
+ */
+void BTreeFreeNodes(BTREENODE pNode, TREE pTree)
+{
+    int i;
+
+    if (!pNode->ucLeaf)
+    {
+        for (i = 0; i <= pNode->nCount; i++)
+        {
+            BTreeFreeNodes(pNode->u.pChildren[i], pTree);
+        }
+    }
+    BTreeFreeNode(pNode, pTree);
+}
+
+/*
+ * Return the first slot of a node whose key is not less than uKey,
+ * or if ucStrict, greater than uKey. Integer keys are compared inline.
+ */
+int BTreeFindSlot(BTREENODE pNode, KEY uKey, TREE pTree, unsigned char ucStrict)
+{
+    int nLow = 0, nHigh = pNode->nCount, nMiddle, nCompare;
+
+    TREE_STAT(pTree, nNodesVisited, 1);
+    switch (pTree->nKeyType)
+    {
+    case KEY_INT:
+        SLOT_LOOP(COMPARE_VALUES(pNode->uKeys[nMiddle].nInt, uKey.nInt));
+        break;
+    case KEY_INT64:
+        SLOT_LOOP(COMPARE_VALUES(pNode->uKeys[nMiddle].llInt, uKey.llInt));
+        break;
+    case KEY_STRING:
+        SLOT_LOOP(strcmp(pNode->uKeys[nMiddle].szString, uKey.szString));
+        break;
+    default:
+        SLOT_LOOP(pTree->cbCompare(pNode->uKeys[nMiddle], uKey));
+        break;
+    }
+
+    return nLow;
+}
+
+/*
+ * Return the leaf in which a key is or would be stored, NULL if
+ * the tree is empty.
+ */
+BTREENODE BTreeFindLeaf(KEY uKey, TREE pTree)
+{
+    BTREENODE pNode = BTREE_DATA(pTree)->pRoot;
+
+    TREE_STAT(pTree, nDescents, 1);
+    while (pNode != NULL && !pNode->ucLeaf)
+    {
+        pNode = pNode->u.pChildren[BTreeFindSlot(pNode, uKey, pTree, TRUE)];
+    }
+
+    return pNode;
+}
+
+/*
+ * Return the contents stored for a key, NULL if missing.
+ */
+void *BTreeSearch(KEY uKey, TREE pTree)
+{
+    void **ppSlot = BTreeSlot(uKey, pTree);
+
+    return ppSlot != NULL ? *ppSlot : NULL;
+}
+
+/*
+ * Return the address of the contents stored for a key in its leaf,
+ * NULL if missing.
+ */
+void **BTreeSlot(KEY uKey, TREE pTree)
+{
+    BTREENODE pLeaf = BTreeFindLeaf(uKey, pTree);
+    int nSlot;
+
+    if (pLeaf == NULL)
+    {
+        return NULL;
+    }
+
+    nSlot = BTreeFindSlot(pLeaf, uKey, pTree, FALSE);
+    if (nSlot < pLeaf->nCount && COMPARE_KEYS(pTree, pLeaf->uKeys[nSlot], uKey) == 0)
+    {
+        return &pLeaf->u.pContents[nSlot];
+    }
+
+    return NULL;
+}
+
+/*
+ * Insert a key, growing the tree by a new root when the old
+ * root splits. Returns FALSE if the key already exists.
+ */
+unsigned char BTreeInsert(KEY uKey, void *pContent, TREE pTree)
+{
+    BTREE pBTree = BTREE_DATA(pTree);
+    BTREENODE pSplit = NULL, pRoot;
+    KEY uSplitKey;
+
+    if (pBTree->pRoot == NULL)
+    {
+        pBTree->pRoot = BTreeAllocNode(pTree, TRUE);
+        pBTree->pFirstLeaf = pBTree->pRoot;
+        pBTree->pLastLeaf = pBTree->pRoot;
+    }
+
+    if (!BTreeInsertInto(pBTree->pRoot, uKey, pContent, pTree, &uSplitKey, &pSplit))
+    {
+        return FALSE;
+    }
+
+    if (pSplit != NULL)
+    {
+        pRoot = BTreeAllocNode(pTree, FALSE);
+        pRoot->nCount = 1;
+        pRoot->uKeys[0] = uSplitKey;
+        pRoot->u.pChildren[0] = pBTree->pRoot;
+        pRoot->u.pChildren[1] = pSplit;
+        pBTree->pRoot = pRoot;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Insert a key below a node. If the node had to split, its new right
+ * sibling is returned in ppSplit along with the separator to push up.
+ */
+unsigned char BTreeInsertInto(BTREENODE pNode, KEY uKey, void *pContent, TREE pTree, KEY *pSplitKey, BTREENODE *ppSplit)
+{
+    BTREENODE pChildSplit = NULL;
+    KEY uChildKey;
+    int nSlot;
+
+    if (pNode->ucLeaf)
+    {
+        nSlot = BTreeFindSlot(pNode, uKey, pTree, FALSE);
+        if (nSlot < pNode->nCount && COMPARE_KEYS(pTree, pNode->uKeys[nSlot], uKey) == 0)
+        {
+            return FALSE;
+        }
+
+        if (pNode->nCount < BTREE_MAX_KEYS)
+        {
+            memmove(&pNode->uKeys[nSlot + 1], &pNode->uKeys[nSlot], (pNode->nCount - nSlot) * sizeof(KEY));
+            memmove(&pNode->u.pContents[nSlot + 1], &pNode->u.pContents[nSlot], (pNode->nCount - nSlot) * sizeof(void *));
+            pNode->uKeys[nSlot] = uKey;
+            pNode->u.pContents[nSlot] = pContent;
+            pNode->nCount++;
+        }
+        else
+        {
+            *ppSplit = BTreeSplitLeaf(pNode, nSlot, uKey, pContent, pTree);
+            *pSplitKey = (*ppSplit)->uKeys[0];
+        }
+        return TRUE;
+    }
+
+    nSlot = BTreeFindSlot(pNode, uKey, pTree, TRUE);
+    if (!BTreeInsertInto(pNode->u.pChildren[nSlot], uKey, pContent, pTree, &uChildKey, &pChildSplit))
+    {
+        return FALSE;
+    }
+
+    if (pChildSplit != NULL)
+    {
+        if (pNode->nCount < BTREE_MAX_KEYS)
+        {
+            memmove(&pNode->uKeys[nSlot + 1], &pNode->uKeys[nSlot], (pNode->nCount - nSlot) * sizeof(KEY));
+            memmove(&pNode->u.pChildren[nSlot + 2], &pNode->u.pChildren[nSlot + 1], (pNode->nCount - nSlot) * sizeof(BTREENODE));
+            pNode->uKeys[nSlot] = uChildKey;
+            pNode->u.pChildren[nSlot + 1] = pChildSplit;
+            pNode->nCount++;
+        }
+        else
+        {
+            *ppSplit = BTreeSplitInner(pNode, nSlot, uChildKey, pChildSplit, pTree, pSplitKey);
+        }
+    }
+
+    return TRUE;
+}
+
+/*
+ * Fill an empty B+ tree from ascending keys bottom up: the keys are
+ * spread evenly over as few leaves as can hold them, then each level's
+ * nodes are spread over as few parents as can hold them, until a single
+ * root remains. Every node ends up at least half full.
+ */
+unsigned char BTreeBuild(KEY *pKeys, void **ppContents, int nCount, TREE pTree)
+{
+    BTREE pBTree = BTREE_DATA(pTree);
+    BTREENODE *ppLevel, pNode;
+    KEY *pLows;
+    int nNodes, nParents, nTake, nNext = 0, i, j;
+
+    if (nCount <= 0)
+    {
+        return TRUE;
+    }
+
+    nNodes = (nCount + BTREE_MAX_KEYS - 1) / BTREE_MAX_KEYS;
+    ppLevel = (BTREENODE *)malloc(nNodes * sizeof(*ppLevel));
+    pLows = (KEY *)malloc(nNodes * sizeof(*pLows));
+
+    for (i = 0; i < nNodes; i++)
+    {
+        pNode = BTreeAllocNode(pTree, TRUE);
+        nTake = (nCount - nNext) / (nNodes - i);
+        for (j = 0; j < nTake; j++)
+        {
+            pNode->uKeys[j] = pKeys[nNext + j];
+            pNode->u.pContents[j] = (ppContents != NULL ? ppContents[nNext + j] : NULL);
+        }
+        pNode->nCount = nTake;
+        if (i > 0)
+        {
+            pNode->pPrevious = ppLevel[i - 1];
+            ppLevel[i - 1]->pNext = pNode;
+        }
+        ppLevel[i] = pNode;
+        pLows[i] = pKeys[nNext];
+        nNext += nTake;
+    }
+    pBTree->pFirstLeaf = ppLevel[0];
+    pBTree->pLastLeaf = ppLevel[nNodes - 1];
+
+    /* Parents are written over the level below, never ahead of the children still to be read */
+    while (nNodes > 1)
+    {
+        nParents = (nNodes + BTREE_MAX_KEYS) / (BTREE_MAX_KEYS + 1);
+        nNext = 0;
+        for (i = 0; i < nParents; i++)
+        {
+            pNode = BTreeAllocNode(pTree, FALSE);
+            nTake = (nNodes - nNext) / (nParents - i);
+            for (j = 0; j < nTake; j++)
+            {
+                pNode->u.pChildren[j] = ppLevel[nNext + j];
+                if (j > 0)
+                {
+                    pNode->uKeys[j - 1] = pLows[nNext + j];
+                }
+            }
+            pNode->nCount = nTake - 1;
+            pLows[i] = pLows[nNext];
+            ppLevel[i] = pNode;
+            nNext += nTake;
+        }
+        nNodes = nParents;
+    }
+
+    pBTree->pRoot = ppLevel[0];
+    free(ppLevel);
+    free(pLows);
+    return TRUE;
+}
+
+/*
+ * Split a full leaf while inserting a key at nSlot, returning the
+ * new right leaf. The right leaf's first key becomes the separator.
+ */
+BTREENODE BTreeSplitLeaf(BTREENODE pNode, int nSlot, KEY uKey, void *pContent, TREE pTree)
+{
+    KEY uKeys[BTREE_MAX_KEYS + 1];
+    void *pContents[BTREE_MAX_KEYS + 1];
+    BTREENODE pRight = BTreeAllocNode(pTree, TRUE);
+    int nLeft = (BTREE_MAX_KEYS + 1) / 2;
+
+    memcpy(uKeys, pNode->uKeys, nSlot * sizeof(KEY));
+    memcpy(pContents, pNode->u.pContents, nSlot * sizeof(void *));
+    uKeys[nSlot] = uKey;
+    pContents[nSlot] = pContent;
+    memcpy(&uKeys[nSlot + 1], &pNode->uKeys[nSlot], (BTREE_MAX_KEYS - nSlot) * sizeof(KEY));
+    memcpy(&pContents[nSlot + 1], &pNode->u.pContents[nSlot], (BTREE_MAX_KEYS - nSlot) * sizeof(void *));
+
+    memcpy(pNode->uKeys, uKeys, nLeft * sizeof(KEY));
+    memcpy(pNode->u.pContents, pContents, nLeft * sizeof(void *));
+    pNode->nCount = nLeft;
+    memcpy(pRight->uKeys, &uKeys[nLeft], (BTREE_MAX_KEYS + 1 - nLeft) * sizeof(KEY));
+    memcpy(pRight->u.pContents, &pContents[nLeft], (BTREE_MAX_KEYS + 1 - nLeft) * sizeof(void *));
+    pRight->nCount = BTREE_MAX_KEYS + 1 - nLeft;
+
+    pRight->pNext = pNode->pNext;
+    pRight->pPrevious = pNode;
+    if (pNode->pNext != NULL)
+    {
+        pNode->pNext->pPrevious = pRight;
+    }
+    else
+    {
+        BTREE_DATA(pTree)->pLastLeaf = pRight;
+    }
+    pNode->pNext = pRight;
+
+    return pRight;
+}
+
+/*
+ * Split a full inner node while inserting a separator at nSlot (with
+ * its right child), returning the new right node. The middle separator
+ * moves up and is returned in pSplitKey.
+ */
+BTREENODE BTreeSplitInner(BTREENODE pNode, int nSlot, KEY uKey, BTREENODE pChild, TREE pTree, KEY *pSplitKey)
+{
+    KEY uKeys[BTREE_MAX_KEYS + 1];
+    BTREENODE pChildren[BTREE_MAX_KEYS + 2];
+    BTREENODE pRight = BTreeAllocNode(pTree, FALSE);
+    int nLeft = (BTREE_MAX_KEYS + 1) / 2;
+
+    memcpy(uKeys, pNode->uKeys, nSlot * sizeof(KEY));
+    uKeys[nSlot] = uKey;
+    memcpy(&uKeys[nSlot + 1], &pNode->uKeys[nSlot], (BTREE_MAX_KEYS - nSlot) * sizeof(KEY));
+    memcpy(pChildren, pNode->u.pChildren, (nSlot + 1) * sizeof(BTREENODE));
+    pChildren[nSlot + 1] = pChild;
+    memcpy(&pChildren[nSlot + 2], &pNode->u.pChildren[nSlot + 1], (BTREE_MAX_KEYS - nSlot) * sizeof(BTREENODE));
+
+    memcpy(pNode->uKeys, uKeys, nLeft * sizeof(KEY));
+    memcpy(pNode->u.pChildren, pChildren, (nLeft + 1) * sizeof(BTREENODE));
+    pNode->nCount = nLeft;
+    *pSplitKey = uKeys[nLeft];
+    memcpy(pRight->uKeys, &uKeys[nLeft + 1], (BTREE_MAX_KEYS - nLeft) * sizeof(KEY));
+    memcpy(pRight->u.pChildren, &pChildren[nLeft + 1], (BTREE_MAX_KEYS - nLeft + 1) * sizeof(BTREENODE));
+    pRight->nCount = BTREE_MAX_KEYS - nLeft;
+
+    return pRight;
+}
+
+/*
+ * Remove a key, shrinking the tree when the root runs out of
+ * separators. Returns FALSE if the key doesn't exist, otherwise stores
+ * the contents it had in *ppContent if ppContent isn't NULL.
+ */
+unsigned char BTreeRemove(KEY uKey, TREE pTree, void **ppContent)
+{
+    BTREE pBTree = BTREE_DATA(pTree);
+    BTREENODE pRoot = pBTree->pRoot;
+
+    if (pRoot == NULL || !BTreeRemoveFrom(pRoot, uKey, pTree, ppContent))
+    {
+        return FALSE;
+    }
+
+    if (pRoot->nCount == 0)
+    {
+        if (pRoot->ucLeaf)
+        {
+            pBTree->pRoot = NULL;
+            pBTree->pFirstLeaf = NULL;
+            pBTree->pLastLeaf = NULL;
+        }
+        else
+        {
+            pBTree->pRoot = pRoot->u.pChildren[0];
+        }
+        BTreeFreeNode(pRoot, pTree);
+    }
+
+    return TRUE;
+}
+
+/*
+ * Remove a key below a node, refilling any child left with
+ * too few keys on the way back up.
+ */
+unsigned char BTreeRemoveFrom(BTREENODE pNode, KEY uKey, TREE pTree, void **ppContent)
+{
+    int nSlot;
+
+    if (pNode->ucLeaf)
+    {
+        nSlot = BTreeFindSlot(pNode, uKey, pTree, FALSE);
+        if (nSlot >= pNode->nCount || COMPARE_KEYS(pTree, pNode->uKeys[nSlot], uKey) != 0)
+        {
+            return FALSE;
+        }
+        if (ppContent != NULL)
+        {
+            *ppContent = pNode->u.pContents[nSlot];
+        }
+
+        pNode->nCount--;
+        memmove(&pNode->uKeys[nSlot], &pNode->uKeys[nSlot + 1], (pNode->nCount - nSlot) * sizeof(KEY));
+        memmove(&pNode->u.pContents[nSlot], &pNode->u.pContents[nSlot + 1], (pNode->nCount - nSlot) * sizeof(void *));
+        return TRUE;
+    }
+
+    nSlot = BTreeFindSlot(pNode, uKey, pTree, TRUE);
+    if (!BTreeRemoveFrom(pNode->u.pChildren[nSlot], uKey, pTree, ppContent))
+    {
+        return FALSE;
+    }
+
+    if (pNode->u.pChildren[nSlot]->nCount < BTREE_MIN_KEYS)
+    {
+        BTreeFixChild(pNode, nSlot, pTree);
+    }
+
+    return TRUE;
+}
+
+/*
+ * Refill an underfull child by borrowing a key from a sibling
+ * with keys to spare, or otherwise merging it with a sibling.
+ */
+void BTreeFixChild(BTREENODE pParent, int nSlot, TREE pTree)
+{
+    BTREENODE pLeft = (nSlot > 0 ? pParent->u.pChildren[nSlot - 1] : NULL);
+    BTREENODE pRight = (nSlot < pParent->nCount ? pParent->u.pChildren[nSlot + 1] : NULL);
+
+    if (pLeft != NULL && pLeft->nCount > BTREE_MIN_KEYS)
+    {
+        BTreeBorrowLeft(pParent, nSlot);
+    }
+    else if (pRight != NULL && pRight->nCount > BTREE_MIN_KEYS)
+    {
+        BTreeBorrowRight(pParent, nSlot);
+    }
+    else if (pLeft != NULL)
+    {
+        BTreeMerge(pParent, nSlot - 1, pTree);
+    }
+    else
+    {
+        BTreeMerge(pParent, nSlot, pTree);
+    }
+}
+
+/*
+ * Move the last key of a child's left sibling into the child.
+ */
+void BTreeBorrowLeft(BTREENODE pParent, int nSlot)
+{
+    BTREENODE pNode = pParent->u.pChildren[nSlot], pLeft = pParent->u.pChildren[nSlot - 1];
+
+    memmove(&pNode->uKeys[1], &pNode->uKeys[0], pNode->nCount * sizeof(KEY));
+    if (pNode->ucLeaf)
+    {
+        memmove(&pNode->u.pContents[1], &pNode->u.pContents[0], pNode->nCount * sizeof(void *));
+        pNode->uKeys[0] = pLeft->uKeys[pLeft->nCount - 1];
+        pNode->u.pContents[0] = pLeft->u.pContents[pLeft->nCount - 1];
+        pParent->uKeys[nSlot - 1] = pNode->uKeys[0];
+    }
+    else
+    {
+        memmove(&pNode->u.pChildren[1], &pNode->u.pChildren[0], (pNode->nCount + 1) * sizeof(BTREENODE));
+        pNode->uKeys[0] = pParent->uKeys[nSlot - 1];
+        pNode->u.pChildren[0] = pLeft->u.pChildren[pLeft->nCount];
+        pParent->uKeys[nSlot - 1] = pLeft->uKeys[pLeft->nCount - 1];
+    }
+    pNode->nCount++;
+    pLeft->nCount--;
+}
+
+/*
+ * Move the first key of a child's right sibling into the child.
+ */
+void BTreeBorrowRight(BTREENODE pParent, int nSlot)
+{
+    BTREENODE pNode = pParent->u.pChildren[nSlot], pRight = pParent->u.pChildren[nSlot + 1];
+
+    if (pNode->ucLeaf)
+    {
+        pNode->uKeys[pNode->nCount] = pRight->uKeys[0];
+        pNode->u.pContents[pNode->nCount] = pRight->u.pContents[0];
+        pRight->nCount--;
+        memmove(&pRight->uKeys[0], &pRight->uKeys[1], pRight->nCount * sizeof(KEY));
+        memmove(&pRight->u.pContents[0], &pRight->u.pContents[1], pRight->nCount * sizeof(void *));
+        pParent->uKeys[nSlot] = pRight->uKeys[0];
+    }
+    else
+    {
+        pNode->uKeys[pNode->nCount] = pParent->uKeys[nSlot];
+        pNode->u.pChildren[pNode->nCount + 1] = pRight->u.pChildren[0];
+        pParent->uKeys[nSlot] = pRight->uKeys[0];
+        pRight->nCount--;
+        memmove(&pRight->uKeys[0], &pRight->uKeys[1], pRight->nCount * sizeof(KEY));
+        memmove(&pRight->u.pChildren[0], &pRight->u.pChildren[1], (pRight->nCount + 1) * sizeof(BTREENODE));
+    }
+    pNode->nCount++;
+}
+
+/*
+ * Merge child nSlot + 1 into child nSlot, dropping the separator
+ * between them from the parent and freeing the emptied node.
+ */
+void BTreeMerge(BTREENODE pParent, int nSlot, TREE pTree)
+{
+    BTREENODE pLeft = pParent->u.pChildren[nSlot], pRight = pParent->u.pChildren[nSlot + 1];
+
+    if (pLeft->ucLeaf)
+    {
+        memcpy(&pLeft->uKeys[pLeft->nCount], pRight->uKeys, pRight->nCount * sizeof(KEY));
+        memcpy(&pLeft->u.pContents[pLeft->nCount], pRight->u.pContents, pRight->nCount * sizeof(void *));
+        pLeft->nCount += pRight->nCount;
+
+        pLeft->pNext = pRight->pNext;
+        if (pRight->pNext != NULL)
+        {
+            pRight->pNext->pPrevious = pLeft;
+        }
+        else
+        {
+            BTREE_DATA(pTree)->pLastLeaf = pLeft;
+        }
+    }
+    else
+    {
+        pLeft->uKeys[pLeft->nCount] = pParent->uKeys[nSlot];
+        memcpy(&pLeft->uKeys[pLeft->nCount + 1], pRight->uKeys, pRight->nCount * sizeof(KEY));
+        memcpy(&pLeft->u.pChildren[pLeft->nCount + 1], pRight->u.pChildren, (pRight->nCount + 1) * sizeof(BTREENODE));
+        pLeft->nCount += pRight->nCount + 1;
+    }
+
+    pParent->nCount--;
+    memmove(&pParent->uKeys[nSlot], &pParent->uKeys[nSlot + 1], (pParent->nCount - nSlot) * sizeof(KEY));
+    memmove(&pParent->u.pChildren[nSlot + 1], &pParent->u.pChildren[nSlot + 2], (pParent->nCount - nSlot) * sizeof(BTREENODE));
+
+    BTreeFreeNode(pRight, pTree);
+}
+
+/*
+ * Position an iterator at the first or last entry of the tree.
+ */
+void BTreeSeekEnd(ITERATOR pIter, unsigned char ucDirection)
+{
+    BTREE pBTree = BTREE_DATA(pIter->pTree);
+
+    if (ucDirection == FORWARD)
+    {
+        pIter->pCursor = pBTree->pFirstLeaf;
+        pIter->nSlot = 0;
+    }
+    else
+    {
+        pIter->pCursor = pBTree->pLastLeaf;
+        pIter->nSlot = (pBTree->pLastLeaf != NULL ? pBTree->pLastLeaf->nCount - 1 : 0);
+    }
+}
+
+/*
+ * Position an iterator at the first entry not less than (or if
+ * ucStrict, greater than) a key, moving to the next leaf if the
+ * key falls past the end of its own.
+ */
+void BTreeSeek(ITERATOR pIter, KEY uKey, unsigned char ucStrict)
+{
+    BTREENODE pLeaf = BTreeFindLeaf(uKey, pIter->pTree);
+    int nSlot = 0;
+
+    if (pLeaf != NULL)
+    {
+        nSlot = BTreeFindSlot(pLeaf, uKey, pIter->pTree, ucStrict);
+        if (nSlot == pLeaf->nCount)
+        {
+            pLeaf = pLeaf->pNext;
+            nSlot = 0;
+        }
+    }
+
+    pIter->pCursor = pLeaf;
+    pIter->nSlot = nSlot;
+}
+
+/*
+ * Move an iterator one entry in the given direction, following
+ * the leaf links across leaf boundaries.
+ */
+void BTreeStep(ITERATOR pIter, unsigned char ucDirection)
+{
+    BTREENODE pLeaf = (BTREENODE)pIter->pCursor;
+
+    if (ucDirection == FORWARD)
+    {
+        if (++pIter->nSlot >= pLeaf->nCount)
+        {
+            pIter->pCursor = pLeaf->pNext;
+            pIter->nSlot = 0;
+        }
+    }
+    else
+    {
+        if (--pIter->nSlot < 0)
+        {
+            pLeaf = pLeaf->pPrevious;
+            pIter->pCursor = pLeaf;
+            pIter->nSlot = (pLeaf != NULL ? pLeaf->nCount - 1 : 0);
+        }
+    }
+}
+
+/*
+ * Return the key and contents at an iterator's position.
+ */
+void BTreeCurrent(ITERATOR pIter, KEY *pKey, void **ppContent)
+{
+    BTREENODE pLeaf = (BTREENODE)pIter->pCursor;
+
+    if (pKey != NULL)
+    {
+        *pKey = pLeaf->uKeys[pIter->nSlot];
+    }
+    if (ppContent != NULL)
+    {
+        *ppContent = pLeaf->u.pContents[pIter->nSlot];
+    }
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+/*
+ * Implementation of a B+ tree storage engine behind the BinarySearchTree
+ * API. Keys are packed into wide nodes so a search touches a handful of
+ * cache lines per level instead of one node per comparison.
+ *
+ * Adam Doyle
+ */
+
+#ifndef __BTREE_H__
+#define __BTREE_H__
+
+#include "BinarySearchTree.h"
+
+
+/* Bytes in a cache line */
+#define BTREE_CACHE_LINE 64
+
+/* Maximum keys per node, sized so a node's keys span four cache lines */
+#define BTREE_MAX_KEYS (4 * BTREE_CACHE_LINE / (int)sizeof(KEY))
+
+/* Minimum keys per node other than the root */
+#define BTREE_MIN_KEYS (BTREE_MAX_KEYS / 2)
+
+
+/*
+ * Represents a single B+ tree node. Leaves hold every key along with its
+ * contents and are linked in key order; inner nodes hold separators only,
+ * child i + 1 holding the keys not less than separator i.
+ */
+typedef struct BTreeNode
+{
+    int nCount; /* Number of keys in use */
+    unsigned char ucLeaf;
+    struct BTreeNode *pNext; /* Next leaf, leaves only */
+    struct BTreeNode *pPrevious; /* Previous leaf, leaves only */
+    KEY uKeys[BTREE_MAX_KEYS];
+    union
+    {
+        void *pContents[BTREE_MAX_KEYS]; /* Leaves */
+        struct BTreeNode *pChildren[BTREE_MAX_KEYS + 1]; /* Inner nodes */
+    } u;
+} *BTREENODE;
+
+/* Represents the B+ tree data of a tree, stored as the tree's auxiliary object */
+typedef struct BTree
+{
+    BTREENODE pRoot;
+    BTREENODE pFirstLeaf;
+    BTREENODE pLastLeaf;
+} *BTREE;
+
+/* Access the B+ tree data of a Tree */
+#define BTREE_DATA(pTree) ((BTREE)(pTree)->pAuxiliary)
+
+
+/* Allocate B+ tree, TREE_THREADED and TREE_ORDER_STATS are ignored */
+TREE BTreeAllocTree(int nFlags);
+
+#endif /* __BTREE_H__ */
\ No newline at end of file
@@ -1,23 +1,84 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "BinarySearchTree.h"
+#include "Trace.h"
+
+/* Represents one key of a batch, remembering its position in the caller's arrays */
+typedef struct BatchEntry
+{
+    KEY uKey;
+    int nIndex;
+} *BATCHENTRY;
+
+/*
+ * Descend from pNode towards a key, leaving pNode at the matching node or
+ * NULL, pLast at the last node visited and nCompare at the last comparison.
+ * Expanded once per key type so the comparison is inlined in each loop.
+ */
+#define LOCATE_LOOP(COMPARE) \
+    while (pNode != NULL) \
+    { \
+        TREE_STAT(pTree, nNodesVisited, 1); \
+        TREE_STAT(pTree, nComparisons, 1); \
+        pLast = pNode; \
+        nCompare = COMPARE; \
+        if (nCompare < 0) \
+        { \
+            pNode = pNode->pLeftChild; \
+        } \
+        else if (nCompare > 0) \
+        { \
+            pNode = pNode->pRightChild; \
+        } \
+        else \
+        { \
+            break; \
+        } \
+    }
 
 /* Method predeclarations */
 /* Memory management */
-NODE AllocNode(TREE pTree);
-void FreeNode(NODE pNode);
+void FreeNodes(TREE pTree);
+
+/* Statistics */
+int TreeHeight(TREE pTree);
+void CountDescent(TREE pTree, long nVisited);
 
 /* Small pieces of useful functionality */
 void DebugTree(TREE pTree);
 void DebugNode(NODE pNode);
+void DebugKey(const char *szLabel, NODE pNode);
 void AttachNodes(NODE pParent, NODE pChild);
 void DetachNodes(NODE pParent, NODE pChild);
+void ReplaceChild(NODE pOld, NODE pNew);
+void ThreadNode(NODE pNode, NODE pPrevious, NODE pNext);
+void UnthreadNode(NODE pNode);
+int GetCount(NODE pNode);
+void SetCount(NODE pNode);
+void AddCount(NODE pNode, int nDelta);
 
 /* Internal functionality for basic tree operations */
-NODE SearchNode(int nKey, TREE pTree);
-unsigned char InsertNode(NODE pNode, TREE pTree);
+NODE LocateNode(KEY uKey, TREE pTree, int *pnCompare);
+NODE LocateFrom(NODE pNode, KEY uKey, TREE pTree, int *pnCompare);
+NODE LocateEnds(KEY uKey, TREE pTree, int *pnCompare);
+NODE LocateHint(NODE pHint, KEY uKey, TREE pTree, int *pnCompare);
+NODE SearchNode(KEY uKey, TREE pTree);
+NODE LowerBoundNode(KEY uKey, TREE pTree);
+NODE UpperBoundNode(KEY uKey, TREE pTree);
+NODE PlaceNode(KEY uKey, void *pContent, TREE pTree, unsigned char *pucInserted);
+void LinkNode(NODE pNode, NODE pParent, int nCompare, TREE pTree);
 unsigned char RemoveNode(NODE pNode, TREE pTree, unsigned char ucOriginal);
+void BuildTree(NODE *ppNodes, int nCount, TREE pTree);
+NODE BuildNodes(NODE *ppNodes, int nCount, NODE pParent, int nDepth, TREE pTree);
+BATCHENTRY SortBatch(KEY *pKeys, int nCount, unsigned char *pResults, TREE pTree);
+unsigned char RebuildForBatch(int nCount, TREE pTree);
+NODE *CollectNodes(TREE pTree);
+
+/* Engine iteration */
+void EngineStart(ITERATOR pIter, TREE pTree);
+void EngineLimit(ITERATOR pIter);
 
 /* Used for traversal */
 NODE GetFirst(TREE pTree);
@@ -27,22 +88,44 @@ NODE GetPrevious(NODE pNode);
 
 /*
  * Allocate a tree structure and initialize all of its
- * internal members.
+ * internal members. nFlags is a combination of the TREE_*
+ * creation flags.
  */
-TREE AllocTree(AllocTreeCallback cbAllocTree)
+TREE AllocTree(AllocTreeCallback cbAllocTree, int nFlags)
 {
     TREE pTree;
 
     pTree = (TREE)malloc(sizeof(*pTree));
     pTree->pRoot = NULL;
     pTree->pFirst = NULL;
+    pTree->pLast = NULL;
     pTree->nSize = 0;
     pTree->nIterators = 0;
+    pTree->nFlags = nFlags;
+    pTree->nKeyType = KEY_INT;
+    pTree->cbCompare = NULL;
+
+    pTree->nNodeMetaSize = 0;
+    pTree->nLinksOffset = 0;
+    pTree->nCountOffset = 0;
+    pTree->nNodeSize = 0;
+    pTree->pNodePool = NULL;
+    ResetAllocCounters(&pTree->sCounters);
+    ResetTreeStats(pTree);
+#ifdef TREE_TRACE
+    pTree->pTrace = NULL;
+#endif
+    pTree->pEngine = NULL;
 
     pTree->cbAllocNode = NULL;
+    pTree->cbFreeNode = NULL;
+    pTree->cbFreeTree = NULL;
     pTree->cbInsert = NULL;
     pTree->cbRemove = NULL;
+    pTree->cbSearch = NULL;
+    pTree->cbUnlink = NULL;
     pTree->cbRotation = NULL;
+    pTree->cbBuild = NULL;
     pTree->cbDebugTree = NULL;
     pTree->cbDebugNode = NULL;
 
@@ -55,6 +138,29 @@ TREE AllocTree(AllocTreeCallback cbAllocTree)
         pTree->pAuxiliary = NULL;
     }
 
+    /* Optional fields go after the variant's metadata, rounded up to keep them aligned.
+     * Engines set their own node size from cbAllocTree instead. */
+    if (pTree->pEngine == NULL)
+    {
+        pTree->nNodeSize = sizeof(struct Node) + pTree->nNodeMetaSize;
+        pTree->nLinksOffset = (pTree->nNodeSize + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+        pTree->nCountOffset = pTree->nLinksOffset;
+        if (nFlags & TREE_THREADED)
+        {
+            pTree->nCountOffset += sizeof(struct ThreadLinks);
+            pTree->nNodeSize = pTree->nCountOffset;
+        }
+        if (nFlags & TREE_ORDER_STATS)
+        {
+            pTree->nNodeSize = pTree->nCountOffset + sizeof(int);
+        }
+    }
+
+    if (nFlags & TREE_POOLED)
+    {
+        pTree->pNodePool = AllocPool(pTree->nNodeSize, &pTree->sCounters);
+    }
+
     return pTree;
 }
 
@@ -69,29 +175,205 @@ unsigned char FreeTree(TREE pTree)
         return FALSE;
     }
 
-    while(pTree->nSize > 0)
+#ifdef TREE_TRACE
+    StopTrace(pTree);
+#endif
+    if (pTree->pEngine != NULL)
+    {
+        pTree->pEngine->cbFree(pTree);
+    }
+
+    if (pTree->pNodePool != NULL)
+    {
+        FreePool(pTree->pNodePool);
+    }
+    else
+    {
+        FreeNodes(pTree);
+    }
+
+    if (pTree->cbFreeTree != NULL)
     {
-        RemoveNode(pTree->pFirst, pTree, TRUE);
+        pTree->cbFreeTree(pTree);
     }
 
     free(pTree);
     return TRUE;
 }
 
+/*
+ * Free every node of a tree without rebalancing, walking the
+ * tree bottom up through the parent links.
+ */
+void FreeNodes(TREE pTree)
+{
+    NODE pNode = pTree->pRoot, pParent;
+
+    while (pNode != NULL)
+    {
+        if (pNode->pLeftChild != NULL)
+        {
+            pNode = pNode->pLeftChild;
+        }
+        else if (pNode->pRightChild != NULL)
+        {
+            pNode = pNode->pRightChild;
+        }
+        else
+        {
+            pParent = pNode->pParent;
+            if (pParent != NULL)
+            {
+                if (pParent->pLeftChild == pNode)
+                {
+                    pParent->pLeftChild = NULL;
+                }
+                else
+                {
+                    pParent->pRightChild = NULL;
+                }
+            }
+            FreeNode(pNode);
+            pNode = pParent;
+        }
+    }
+
+    pTree->pRoot = NULL;
+    pTree->pFirst = NULL;
+    pTree->pLast = NULL;
+    pTree->nSize = 0;
+}
+
+/*
+ * Copy the tree's node memory counters into pCounters.
+ */
+void GetAllocCounters(TREE pTree, ALLOCCOUNTERS pCounters)
+{
+    *pCounters = pTree->sCounters;
+}
+
+/*
+ * Copy the tree's statistics into pStats, along with its current height
+ * and node memory. Finding the height walks the whole tree. Returns FALSE
+ * if statistics weren't compiled in (see TREE_STAT), leaving the counters
+ * at zero.
+ */
+unsigned char GetTreeStats(TREE pTree, TREESTATS pStats)
+{
+#ifdef TREE_STATS
+    *pStats = pTree->sStats;
+#else
+    memset(pStats, 0, sizeof(*pStats));
+#endif
+    pStats->nHeight = TreeHeight(pTree);
+    pStats->nBytes = pTree->sCounters.nBytes;
+
+#ifdef TREE_STATS
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+/*
+ * Zero the tree's statistics counters.
+ */
+void ResetTreeStats(TREE pTree)
+{
+#ifdef TREE_STATS
+    memset(&pTree->sStats, 0, sizeof(pTree->sStats));
+#endif
+}
+
+/*
+ * Return the height of a tree of binary nodes (a lone root has height 0),
+ * -1 if it is empty or has an engine. Walks every node through the parent
+ * links, so degenerate trees don't exhaust the stack.
+ */
+int TreeHeight(TREE pTree)
+{
+    NODE pNode = pTree->pRoot, pFrom = NULL, pTo;
+    int nDepth = 0, nHeight = -1;
+
+    if (pTree->pEngine != NULL)
+    {
+        return -1;
+    }
+
+    while (pNode != NULL)
+    {
+        if (pFrom == pNode->pParent)
+        {
+            /* Arrived from above */
+            if (nDepth > nHeight)
+            {
+                nHeight = nDepth;
+            }
+            pTo = pNode->pLeftChild != NULL ? pNode->pLeftChild :
+                pNode->pRightChild != NULL ? pNode->pRightChild : pNode->pParent;
+        }
+        else if (pFrom == pNode->pLeftChild && pNode->pRightChild != NULL)
+        {
+            pTo = pNode->pRightChild;
+        }
+        else
+        {
+            pTo = pNode->pParent;
+        }
+
+        nDepth += (pTo == pNode->pParent ? -1 : 1);
+        pFrom = pNode;
+        pNode = pTo;
+    }
+
+    return nHeight;
+}
+
+/*
+ * Record a descent that visited nVisited nodes.
+ */
+void CountDescent(TREE pTree, long nVisited)
+{
+    TREE_STAT(pTree, nDescents, 1);
+#ifdef TREE_STATS
+    if (nVisited > pTree->sStats.nMaxDescent)
+    {
+        pTree->sStats.nMaxDescent = nVisited;
+    }
+#endif
+}
+
 /* 
  * Allocate a node structure and all of its internal
- * members.
+ * members, from the tree's pool if it has one.
  */
 NODE AllocNode(TREE pTree)
 {
     NODE pNode;
 
-    pNode = (NODE)malloc(sizeof(*pNode));
+    if (pTree->pNodePool != NULL)
+    {
+        pNode = (NODE)PoolAlloc(pTree->pNodePool);
+    }
+    else
+    {
+        pNode = (NODE)CountedMalloc(pTree->nNodeSize, &pTree->sCounters);
+    }
+    TREE_STAT(pTree, nAllocations, 1);
+    if (pTree->nNodeMetaSize > 0)
+    {
+        memset(NODE_META(pNode), 0, pTree->nNodeMetaSize);
+    }
+    pNode->pTree = pTree;
     pNode->pLeftChild = NULL;
     pNode->pRightChild = NULL;
     pNode->pParent = NULL;
-    pNode->nKey = 0;
+    pNode->uKey.llInt = 0;
     pNode->pContent = NULL;
+    if (pTree->nFlags & TREE_ORDER_STATS)
+    {
+        NODE_COUNT(pNode) = 1;
+    }
 
     if (pTree->cbAllocNode != NULL)
     {
@@ -106,11 +388,27 @@ NODE AllocNode(TREE pTree)
 }
 
 /*
- * Free a node's memory.
+ * Free a node's memory, returning it to the tree's pool if
+ * it has one.
  */
 void FreeNode(NODE pNode)
 {
-    free(pNode);
+    TREE pTree = pNode->pTree;
+
+    TREE_STAT(pTree, nFrees, 1);
+    if (pTree->cbFreeNode != NULL)
+    {
+        pTree->cbFreeNode(pNode);
+    }
+
+    if (pTree->pNodePool != NULL)
+    {
+        PoolFree(pTree->pNodePool, pNode);
+    }
+    else
+    {
+        CountedFree(pNode, pTree->nNodeSize, &pTree->sCounters);
+    }
 }
 
 /*
@@ -124,7 +422,13 @@ ITERATOR AllocIterator()
     pIter = (ITERATOR)malloc(sizeof(*pIter));
     pIter->pTree = NULL;
     pIter->pNode = NULL;
+    pIter->pEnd = NULL;
     pIter->ucDirection = FORWARD;
+    pIter->pCursor = NULL;
+    pIter->nSlot = 0;
+    pIter->pState = NULL;
+    pIter->uEnd.llInt = 0;
+    pIter->ucBounded = FALSE;
 
     return pIter;
 }
@@ -143,8 +447,8 @@ void FreeIterator(ITERATOR pIter)
 void DebugTree(TREE pTree)
 {
     printf("---- DEBUG TREE ----\n");
-    printf("Root key: %d\n", pTree->pRoot);
-    printf("First key: %d\n", pTree->pFirst);
+    DebugKey("Root key", pTree->pRoot);
+    DebugKey("First key", pTree->pFirst);
     printf("Size: %d\n", pTree->nSize);
     printf("Iterator count: %d\n", pTree->nIterators);
 
@@ -162,10 +466,10 @@ void DebugTree(TREE pTree)
 void DebugNode(NODE pNode)
 {
     printf("---- DEBUG NODE ----\n");
-    printf("Key: %d\n", pNode->nKey);
-    printf("Left child key: %d\n", pNode->pLeftChild == NULL ? 0 : pNode->pLeftChild->nKey);
-    printf("Right child key: %d\n", pNode->pRightChild == NULL ? 0 : pNode->pRightChild->nKey);
-    printf("Parent key: %d\n", pNode->pParent == NULL ? 0 : pNode->pParent->nKey);
+    DebugKey("Key", pNode);
+    DebugKey("Left child key", pNode->pLeftChild);
+    DebugKey("Right child key", pNode->pRightChild);
+    DebugKey("Parent key", pNode->pParent);
 
     if (pNode->pTree->cbDebugNode != NULL)
     {
@@ -175,6 +479,110 @@ void DebugNode(NODE pNode)
     printf("\n");
 }
 
+/*
+ * Print out a node's key according to its tree's key type.
+ */
+void DebugKey(const char *szLabel, NODE pNode)
+{
+    if (pNode == NULL)
+    {
+        printf("%s: none\n", szLabel);
+        return;
+    }
+
+    switch (pNode->pTree->nKeyType)
+    {
+    case KEY_INT:
+        printf("%s: %d\n", szLabel, pNode->uKey.nInt);
+        break;
+    case KEY_INT64:
+        printf("%s: %lld\n", szLabel, pNode->uKey.llInt);
+        break;
+    case KEY_STRING:
+        printf("%s: %s\n", szLabel, pNode->uKey.szString);
+        break;
+    default:
+        printf("%s: %p\n", szLabel, pNode->uKey.pData);
+        break;
+    }
+}
+
+/*
+ * Set the type of the tree's keys, and for KEY_CUSTOM the comparison
+ * to order them with. Only possible while the tree is empty.
+ */
+unsigned char SetKeyType(TREE pTree, int nKeyType, CompareCallback cbCompare)
+{
+    if (pTree->nSize > 0 || (nKeyType == KEY_CUSTOM && cbCompare == NULL))
+    {
+        return FALSE;
+    }
+
+    pTree->nKeyType = nKeyType;
+    pTree->cbCompare = cbCompare;
+    return TRUE;
+}
+
+/*
+ * Three way comparison of two keys of a tree, returning <0, 0 or >0.
+ * COMPARE_KEYS should be preferred as it inlines integer comparisons.
+ */
+int CompareKeys(KEY uLeft, KEY uRight, TREE pTree)
+{
+    switch (pTree->nKeyType)
+    {
+    case KEY_INT:
+        return COMPARE_VALUES(uLeft.nInt, uRight.nInt);
+    case KEY_INT64:
+        return COMPARE_VALUES(uLeft.llInt, uRight.llInt);
+    case KEY_STRING:
+        return strcmp(uLeft.szString, uRight.szString);
+    default:
+        return pTree->cbCompare(uLeft, uRight);
+    }
+}
+
+/*
+ * Build a KEY_INT key.
+ */
+KEY IntKey(int nKey)
+{
+    KEY uKey;
+    uKey.llInt = 0;
+    uKey.nInt = nKey;
+    return uKey;
+}
+
+/*
+ * Build a KEY_INT64 key.
+ */
+KEY Int64Key(long long llKey)
+{
+    KEY uKey;
+    uKey.llInt = llKey;
+    return uKey;
+}
+
+/*
+ * Build a KEY_STRING key, referencing the given string.
+ */
+KEY StringKey(const char *szKey)
+{
+    KEY uKey;
+    uKey.szString = szKey;
+    return uKey;
+}
+
+/*
+ * Build a KEY_CUSTOM key, referencing the given data.
+ */
+KEY DataKey(const void *pKey)
+{
+    KEY uKey;
+    uKey.pData = pKey;
+    return uKey;
+}
+
 /*
  * Return the grandparent of a node, if it exists.
  * Returns NULL otherwise.
@@ -196,7 +604,7 @@ NODE Sibling(NODE pNode)
 {
     if (pNode != NULL && pNode->pParent != NULL)
     {
-        return pNode->nKey < pNode->pParent->nKey ? pNode->pParent->pRightChild : pNode->pParent->pLeftChild;
+        return pNode == pNode->pParent->pLeftChild ? pNode->pParent->pRightChild : pNode->pParent->pLeftChild;
     }
     return NULL;
 }
@@ -239,7 +647,7 @@ void AttachNodes(NODE pParent, NODE pChild)
         return;
     }
 
-    if (pChild->nKey < pParent->nKey)
+    if (COMPARE_KEYS(pChild->pTree, pChild->uKey, pParent->uKey) < 0)
     {
         pParent->pLeftChild = pChild;
         if (pParent->pTree->pFirst == pParent)
@@ -254,12 +662,11 @@ void AttachNodes(NODE pParent, NODE pChild)
 }
 
 /*
- * Removes the links between two nodes based on
- * key relativity.
+ * Removes the links between two nodes.
  */
 void DetachNodes(NODE pParent, NODE pChild)
 {
-    if (pChild->nKey < pParent->nKey)
+    if (pParent->pLeftChild == pChild)
     {
         pParent->pLeftChild = NULL;
     }
@@ -272,210 +679,1437 @@ void DetachNodes(NODE pParent, NODE pChild)
 }
 
 /*
- * Performs a left rotation on the given node.
+ * Splice a node into the in-order links of a threaded tree
+ * between its two neighbours, either of which may be NULL.
  */
-NODE LeftRotation(NODE pNode)
+void ThreadNode(NODE pNode, NODE pPrevious, NODE pNext)
 {
-    NODE pChildNode = pNode->pRightChild;
-    pNode->pRightChild = NULL;
-    AttachNodes(pNode, pChildNode->pLeftChild);
-    AttachNodes(pNode->pParent, pChildNode);
-    AttachNodes(pChildNode, pNode);
-
-    if (pNode->pTree->cbRotation != NULL)
+    NODE_LINKS(pNode)->pPrevious = pPrevious;
+    NODE_LINKS(pNode)->pNext = pNext;
+    if (pPrevious != NULL)
     {
-        pNode->pTree->cbRotation(pNode);
+        NODE_LINKS(pPrevious)->pNext = pNode;
+    }
+    if (pNext != NULL)
+    {
+        NODE_LINKS(pNext)->pPrevious = pNode;
     }
-
-    return pChildNode;
 }
 
 /*
- * Performs a right rotation on the given node.
+ * Remove a node from the in-order links of a threaded tree.
  */
-NODE RightRotation(NODE pNode)
+void UnthreadNode(NODE pNode)
 {
-    NODE pChildNode = pNode->pLeftChild;
-    pNode->pLeftChild = NULL;
-    AttachNodes(pNode, pChildNode->pRightChild);
-    AttachNodes(pNode->pParent, pChildNode);
-    AttachNodes(pChildNode, pNode);
+    NODE pPrevious = NODE_LINKS(pNode)->pPrevious, pNext = NODE_LINKS(pNode)->pNext;
 
-    if (pNode->pTree->cbRotation != NULL)
+    if (pPrevious != NULL)
     {
-        pNode->pTree->cbRotation(pNode);
+        NODE_LINKS(pPrevious)->pNext = pNext;
+    }
+    if (pNext != NULL)
+    {
+        NODE_LINKS(pNext)->pPrevious = pPrevious;
     }
-
-    return pChildNode;
 }
 
 /*
- * Search for the appropriate node and return its contents.
+ * Return the size of a node's subtree in an order statistics
+ * tree, 0 if the node is NULL.
  */
-void *Search(int nKey, TREE pTree)
+int GetCount(NODE pNode)
 {
-    void *pContent = NULL;
-    NODE pNode = SearchNode(nKey, pTree);
-    if (pNode != NULL)
-    {
-        pContent = pNode->pContent;
-    }
-    return pContent;
+    return pNode != NULL ? NODE_COUNT(pNode) : 0;
 }
 
 /*
- * Search for the appropriate node and return it.
+ * Recompute the size of a node's subtree in an order statistics
+ * tree from its children's sizes.
  */
-NODE SearchNode(int nKey, TREE pTree)
+void SetCount(NODE pNode)
 {
-    NODE pNode = pTree->pRoot;
+    NODE_COUNT(pNode) = GetCount(pNode->pLeftChild) + GetCount(pNode->pRightChild) + 1;
+}
 
+/*
+ * Adjust the subtree size of a node and all of its ancestors in
+ * an order statistics tree.
+ */
+void AddCount(NODE pNode, int nDelta)
+{
     while (pNode != NULL)
     {
-        if (nKey < pNode->nKey)
-        {
-            pNode = pNode->pLeftChild;
-        }
-        else if (nKey > pNode->nKey)
-        {
-            pNode = pNode->pRightChild;
-        }
-        else
-        {
-            return pNode;
-        }
+        NODE_COUNT(pNode) += nDelta;
+        pNode = pNode->pParent;
     }
-
-    return NULL;
 }
 
 /*
- * Insert a new node at the appropriate location in the tree.
- * Insertion fails if the key already exists.
+ * Put pNew in pOld's place under pOld's parent, or at the root.
  */
-unsigned char Insert(int nKey, void *pContent, TREE pTree)
+void ReplaceChild(NODE pOld, NODE pNew)
 {
-    NODE pNode;
-    unsigned char ucResponse;
-    pNode = AllocNode(pTree);
-    pNode->nKey = nKey;
-    pNode->pContent = pContent;
-    pNode->pTree = pTree;
+    NODE pParent = pOld->pParent;
 
-    ucResponse = InsertNode(pNode, pTree);
-    if (ucResponse == FALSE)
+    pNew->pParent = pParent;
+    if (pParent == NULL)
     {
-        FreeNode(pNode);
+        pOld->pTree->pRoot = pNew;
+    }
+    else if (pParent->pLeftChild == pOld)
+    {
+        pParent->pLeftChild = pNew;
+    }
+    else
+    {
+        pParent->pRightChild = pNew;
     }
-    return ucResponse;
 }
 
 /*
- * Insert a new node at the appropriate location in the tree.
- * Insertion fails if the key already exists.
+ * Performs a left rotation on the given node. Rotations
+ * preserve key order, so in-order links and the first and
+ * last nodes need no update, and every link's side is known
+ * without comparing keys.
  */
-unsigned char InsertNode(NODE pNode, TREE pTree)
+NODE LeftRotation(NODE pNode)
 {
-    NODE pCurrNode = pTree->pRoot, pPrevNode = NULL;
-
-    while (pCurrNode != NULL)
+    NODE pChildNode = pNode->pRightChild;
+    pNode->pRightChild = pChildNode->pLeftChild;
+    if (pNode->pRightChild != NULL)
     {
-        pPrevNode = pCurrNode;
-        if (pNode->nKey < pCurrNode->nKey)
-        {
-            pCurrNode = pCurrNode->pLeftChild;
-        }
-        else if (pNode->nKey > pCurrNode->nKey)
-        {
-            pCurrNode = pCurrNode->pRightChild;
-        }
-        else
-        {
-            return FALSE;
-        }
+        pNode->pRightChild->pParent = pNode;
     }
+    ReplaceChild(pNode, pChildNode);
+    pChildNode->pLeftChild = pNode;
+    pNode->pParent = pChildNode;
 
-    AttachNodes(pPrevNode, pNode);
-    pTree->nSize++;
+    if (pNode->pTree->nFlags & TREE_ORDER_STATS)
+    {
+        SetCount(pNode);
+        SetCount(pChildNode);
+    }
 
-    if (pTree->cbInsert != NULL)
+    TREE_STAT(pNode->pTree, nRotations, 1);
+    if (pNode->pTree->cbRotation != NULL)
     {
-        pTree->cbInsert(pNode);
+        pNode->pTree->cbRotation(pNode);
     }
 
-    return TRUE;
+    return pChildNode;
 }
 
 /*
- * Remove a node from the tree.
+ * Performs a right rotation on the given node.
  */
-unsigned char Remove(int nKey, TREE pTree)
+NODE RightRotation(NODE pNode)
 {
-    NODE pNode = SearchNode(nKey, pTree);
-    unsigned char ucResponse = RemoveNode(pNode, pTree, TRUE);
-
-    if (ucResponse == TRUE)
+    NODE pChildNode = pNode->pLeftChild;
+    pNode->pLeftChild = pChildNode->pRightChild;
+    if (pNode->pLeftChild != NULL)
     {
-        pTree->nSize--;
+        pNode->pLeftChild->pParent = pNode;
+    }
+    ReplaceChild(pNode, pChildNode);
+    pChildNode->pRightChild = pNode;
+    pNode->pParent = pChildNode;
+
+    if (pNode->pTree->nFlags & TREE_ORDER_STATS)
+    {
+        SetCount(pNode);
+        SetCount(pChildNode);
+    }
+
+    TREE_STAT(pNode->pTree, nRotations, 1);
+    if (pNode->pTree->cbRotation != NULL)
+    {
+        pNode->pTree->cbRotation(pNode);
+    }
+
+    return pChildNode;
+}
+
+/*
+ * Search for the appropriate node and return its contents.
+ */
+void *Search(KEY uKey, TREE pTree)
+{
+    void *pContent = NULL;
+    NODE pNode;
+
+    TREE_STAT(pTree, nSearches, 1);
+    TREE_TRACE_EVENT(pTree, TRACE_SEARCH, NULL, uKey, uKey);
+    if (pTree->pEngine != NULL)
+    {
+        return pTree->pEngine->cbSearch(uKey, pTree);
+    }
+
+    pNode = SearchNode(uKey, pTree);
+    if (pNode != NULL)
+    {
+        pContent = pNode->pContent;
+        if (pTree->cbSearch != NULL)
+        {
+            pTree->cbSearch(pNode);
+        }
+    }
+    return pContent;
+}
+
+/*
+ * Search for many keys at once, storing each key's contents (NULL if
+ * missing) in ppResults and returning the number of non-NULL results. Descents
+ * advance in lockstep groups, each step prefetching every descent's next
+ * node before any of them is compared, so the cache misses of a group
+ * overlap instead of stalling one after another. Found nodes are passed
+ * to the tree's search callback once their whole group has finished, as
+ * it may restructure the tree under the other descents.
+ */
+int SearchBatch(KEY *pKeys, int nCount, void **ppResults, TREE pTree)
+{
+    NODE pNodes[SEARCH_BATCH_GROUP], pFound[SEARCH_BATCH_GROUP], pNode;
+    int nStart, nGroup, nActive, nCompare, nFound = 0, i;
+
+    TREE_STAT(pTree, nSearches, nCount);
+    TREE_TRACE_KEYS(pTree, TRACE_SEARCH, pKeys, nCount);
+    if (pTree->pEngine != NULL)
+    {
+        for (i = 0; i < nCount; i++)
+        {
+            ppResults[i] = pTree->pEngine->cbSearch(pKeys[i], pTree);
+            if (ppResults[i] != NULL)
+            {
+                nFound++;
+            }
+        }
+        return nFound;
+    }
+
+    for (nStart = 0; nStart < nCount; nStart += SEARCH_BATCH_GROUP)
+    {
+        nGroup = nCount - nStart;
+        if (nGroup > SEARCH_BATCH_GROUP)
+        {
+            nGroup = SEARCH_BATCH_GROUP;
+        }
+        for (i = 0; i < nGroup; i++)
+        {
+            pNodes[i] = pTree->pRoot;
+            pFound[i] = NULL;
+            ppResults[nStart + i] = NULL;
+        }
+
+        nActive = (pTree->pRoot != NULL ? nGroup : 0);
+        TREE_STAT(pTree, nDescents, nActive);
+        while (nActive > 0)
+        {
+            nActive = 0;
+            for (i = 0; i < nGroup; i++)
+            {
+                pNode = pNodes[i];
+                if (pNode == NULL)
+                {
+                    continue;
+                }
+
+                TREE_STAT(pTree, nNodesVisited, 1);
+                nCompare = COMPARE_KEYS(pTree, pKeys[nStart + i], pNode->uKey);
+                if (nCompare < 0)
+                {
+                    pNode = pNode->pLeftChild;
+                }
+                else if (nCompare > 0)
+                {
+                    pNode = pNode->pRightChild;
+                }
+                else
+                {
+                    ppResults[nStart + i] = pNode->pContent;
+                    if (pNode->pContent != NULL)
+                    {
+                        nFound++;
+                    }
+                    pFound[i] = pNode;
+                    pNode = NULL;
+                }
+
+                if (pNode != NULL)
+                {
+                    PREFETCH(pNode);
+                    nActive++;
+                }
+                pNodes[i] = pNode;
+            }
+        }
+
+        if (pTree->cbSearch != NULL)
+        {
+            for (i = 0; i < nGroup; i++)
+            {
+                if (pFound[i] != NULL)
+                {
+                    pTree->cbSearch(pFound[i]);
+                }
+            }
+        }
+    }
+
+    return nFound;
+}
+
+/*
+ * Descend from the root towards a key and return the node the descent
+ * stopped at, NULL if the tree is empty. *pnCompare is set to the key's
+ * comparison against that node: 0 if the key was found, otherwise the
+ * side of the node the key belongs on.
+ */
+NODE LocateNode(KEY uKey, TREE pTree, int *pnCompare)
+{
+    return LocateFrom(pTree->pRoot, uKey, pTree, pnCompare);
+}
+
+/*
+ * Descend from pNode towards a key, as LocateNode does from the root.
+ * pNode's subtree must be where the key belongs.
+ */
+NODE LocateFrom(NODE pNode, KEY uKey, TREE pTree, int *pnCompare)
+{
+    NODE pLast = NULL;
+    int nCompare = 0;
+#ifdef TREE_STATS
+    long nVisited = pTree->sStats.nNodesVisited;
+#endif
+
+    switch (pTree->nKeyType)
+    {
+    case KEY_INT:
+        LOCATE_LOOP(COMPARE_VALUES(uKey.nInt, pNode->uKey.nInt));
+        break;
+    case KEY_INT64:
+        LOCATE_LOOP(COMPARE_VALUES(uKey.llInt, pNode->uKey.llInt));
+        break;
+    case KEY_STRING:
+        LOCATE_LOOP(strcmp(uKey.szString, pNode->uKey.szString));
+        break;
+    default:
+        LOCATE_LOOP(pTree->cbCompare(uKey, pNode->uKey));
+        break;
+    }
+
+#ifdef TREE_STATS
+    CountDescent(pTree, pTree->sStats.nNodesVisited - nVisited);
+#endif
+    *pnCompare = nCompare;
+    return pLast;
+}
+
+/*
+ * Search for the appropriate node and return it.
+ */
+NODE SearchNode(KEY uKey, TREE pTree)
+{
+    int nCompare;
+    NODE pNode = LocateNode(uKey, pTree, &nCompare);
+
+    return nCompare == 0 ? pNode : NULL;
+}
+
+/*
+ * Return the first node whose key is not less than the given key,
+ * NULL if there is none.
+ */
+NODE LowerBoundNode(KEY uKey, TREE pTree)
+{
+    int nCompare;
+    NODE pNode = LocateNode(uKey, pTree, &nCompare);
+
+    if (pNode != NULL && nCompare > 0)
+    {
+        pNode = GetNext(pNode);
+    }
+    return pNode;
+}
+
+/*
+ * Return the first node whose key is greater than the given key,
+ * NULL if there is none.
+ */
+NODE UpperBoundNode(KEY uKey, TREE pTree)
+{
+    int nCompare;
+    NODE pNode = LocateNode(uKey, pTree, &nCompare);
+
+    if (pNode != NULL && nCompare >= 0)
+    {
+        pNode = GetNext(pNode);
+    }
+    return pNode;
+}
+
+/*
+ * Find the first entry whose key is not less than the given key. Returns
+ * FALSE if there is none, otherwise TRUE, setting *pFoundKey and *ppContent
+ * to the entry's key and contents if they are not NULL.
+ */
+unsigned char LowerBound(KEY uKey, TREE pTree, KEY *pFoundKey, void **ppContent)
+{
+    NODE pNode;
+    struct Iterator sIter;
+    unsigned char ucFound;
+
+    if (pTree->pEngine != NULL)
+    {
+        EngineStart(&sIter, pTree);
+        pTree->pEngine->cbSeek(&sIter, uKey, FALSE);
+        ucFound = sIter.pCursor != NULL;
+        if (ucFound == TRUE)
+        {
+            pTree->pEngine->cbCurrent(&sIter, pFoundKey, ppContent);
+        }
+        Detach(&sIter);
+        return ucFound;
+    }
+
+    pNode = LowerBoundNode(uKey, pTree);
+
+    if (pNode == NULL)
+    {
+        return FALSE;
+    }
+    if (pFoundKey != NULL)
+    {
+        *pFoundKey = pNode->uKey;
+    }
+    if (ppContent != NULL)
+    {
+        *ppContent = pNode->pContent;
+    }
+    if (pTree->cbSearch != NULL)
+    {
+        pTree->cbSearch(pNode);
+    }
+    return TRUE;
+}
+
+/*
+ * Find the first entry whose key is greater than the given key. Returns
+ * FALSE if there is none, otherwise TRUE, setting *pFoundKey and *ppContent
+ * to the entry's key and contents if they are not NULL.
+ */
+unsigned char UpperBound(KEY uKey, TREE pTree, KEY *pFoundKey, void **ppContent)
+{
+    NODE pNode;
+    struct Iterator sIter;
+    unsigned char ucFound;
+
+    if (pTree->pEngine != NULL)
+    {
+        EngineStart(&sIter, pTree);
+        pTree->pEngine->cbSeek(&sIter, uKey, TRUE);
+        ucFound = sIter.pCursor != NULL;
+        if (ucFound == TRUE)
+        {
+            pTree->pEngine->cbCurrent(&sIter, pFoundKey, ppContent);
+        }
+        Detach(&sIter);
+        return ucFound;
+    }
+
+    pNode = UpperBoundNode(uKey, pTree);
+
+    if (pNode == NULL)
+    {
+        return FALSE;
+    }
+    if (pFoundKey != NULL)
+    {
+        *pFoundKey = pNode->uKey;
+    }
+    if (ppContent != NULL)
+    {
+        *ppContent = pNode->pContent;
+    }
+    if (pTree->cbSearch != NULL)
+    {
+        pTree->cbSearch(pNode);
+    }
+    return TRUE;
+}
+
+/*
+ * Count the entries with keys in [uLow, uHigh). Order statistics trees
+ * answer in logarithmic time, other trees walk the entries in the range.
+ */
+int CountRange(KEY uLow, KEY uHigh, TREE pTree)
+{
+    NODE pNode, pEnd;
+    int nCount = 0;
+    struct Iterator sIter;
+
+    if (COMPARE_KEYS(pTree, uLow, uHigh) >= 0)
+    {
+        return 0;
+    }
+
+    if (pTree->pEngine != NULL)
+    {
+        sIter.ucDirection = FORWARD;
+        AttachRange(&sIter, pTree, uLow, uHigh);
+        while (sIter.pCursor != NULL)
+        {
+            nCount++;
+            Next(&sIter);
+        }
+        Detach(&sIter);
+        return nCount;
+    }
+
+    if (pTree->nFlags & TREE_ORDER_STATS)
+    {
+        return Rank(uHigh, pTree) - Rank(uLow, pTree);
+    }
+
+    pEnd = LowerBoundNode(uHigh, pTree);
+    for (pNode = LowerBoundNode(uLow, pTree); pNode != pEnd; pNode = GetNext(pNode))
+    {
+        nCount++;
+    }
+    return nCount;
+}
+
+/*
+ * Return the number of entries with keys less than the given key. Order
+ * statistics trees answer in logarithmic time, other trees walk the
+ * entries below the key.
+ */
+int Rank(KEY uKey, TREE pTree)
+{
+    NODE pNode;
+    int nRank = 0;
+    KEY uCurrent;
+    struct Iterator sIter;
+
+    if (pTree->pEngine != NULL)
+    {
+        EngineStart(&sIter, pTree);
+        pTree->pEngine->cbSeekEnd(&sIter, FORWARD);
+        while (sIter.pCursor != NULL)
+        {
+            pTree->pEngine->cbCurrent(&sIter, &uCurrent, NULL);
+            if (COMPARE_KEYS(pTree, uCurrent, uKey) >= 0)
+            {
+                break;
+            }
+            nRank++;
+            pTree->pEngine->cbStep(&sIter, FORWARD);
+        }
+        Detach(&sIter);
+        return nRank;
+    }
+
+    if (pTree->nFlags & TREE_ORDER_STATS)
+    {
+        pNode = pTree->pRoot;
+        while (pNode != NULL)
+        {
+            if (COMPARE_KEYS(pTree, uKey, pNode->uKey) <= 0)
+            {
+                pNode = pNode->pLeftChild;
+            }
+            else
+            {
+                nRank += GetCount(pNode->pLeftChild) + 1;
+                pNode = pNode->pRightChild;
+            }
+        }
+        return nRank;
+    }
+
+    for (pNode = GetFirst(pTree); pNode != NULL && COMPARE_KEYS(pTree, pNode->uKey, uKey) < 0; pNode = GetNext(pNode))
+    {
+        nRank++;
+    }
+    return nRank;
+}
+
+/*
+ * Find the entry with the given 0 based rank in key order. Returns FALSE
+ * if the rank is out of range, otherwise TRUE, setting *pFoundKey and
+ * *ppContent to the entry's key and contents if they are not NULL. Order
+ * statistics trees answer in logarithmic time, other trees walk the
+ * entries below the rank.
+ */
+unsigned char Select(int nRank, TREE pTree, KEY *pFoundKey, void **ppContent)
+{
+    NODE pNode;
+    int nLeftCount;
+    struct Iterator sIter;
+
+    if (nRank < 0 || nRank >= pTree->nSize)
+    {
+        return FALSE;
+    }
+
+    if (pTree->pEngine != NULL)
+    {
+        EngineStart(&sIter, pTree);
+        pTree->pEngine->cbSeekEnd(&sIter, FORWARD);
+        for (; nRank > 0; nRank--)
+        {
+            pTree->pEngine->cbStep(&sIter, FORWARD);
+        }
+        pTree->pEngine->cbCurrent(&sIter, pFoundKey, ppContent);
+        Detach(&sIter);
+        return TRUE;
+    }
+
+    if (pTree->nFlags & TREE_ORDER_STATS)
+    {
+        pNode = pTree->pRoot;
+        while ((nLeftCount = GetCount(pNode->pLeftChild)) != nRank)
+        {
+            if (nRank < nLeftCount)
+            {
+                pNode = pNode->pLeftChild;
+            }
+            else
+            {
+                nRank -= nLeftCount + 1;
+                pNode = pNode->pRightChild;
+            }
+        }
+    }
+    else
+    {
+        for (pNode = GetFirst(pTree); nRank > 0; nRank--)
+        {
+            pNode = GetNext(pNode);
+        }
+    }
+
+    if (pFoundKey != NULL)
+    {
+        *pFoundKey = pNode->uKey;
+    }
+    if (ppContent != NULL)
+    {
+        *ppContent = pNode->pContent;
+    }
+    return TRUE;
+}
+
+/*
+ * Insert a new node at the appropriate location in the tree.
+ * Insertion fails if the key already exists.
+ */
+unsigned char Insert(KEY uKey, void *pContent, TREE pTree)
+{
+    unsigned char ucInserted;
+
+    TREE_STAT(pTree, nInserts, 1);
+    TREE_TRACE_EVENT(pTree, TRACE_INSERT, NULL, uKey, uKey);
+    if (pTree->pEngine != NULL)
+    {
+        ucInserted = pTree->pEngine->cbInsert(uKey, pContent, pTree);
+        if (ucInserted == TRUE)
+        {
+            pTree->nSize++;
+        }
+        return ucInserted;
+    }
+
+    PlaceNode(uKey, pContent, pTree, &ucInserted);
+    return ucInserted;
+}
+
+/*
+ * Insert a key, or replace its contents if it already exists, in a single
+ * descent. Returns TRUE if the key was inserted, FALSE if it was updated.
+ * Engines that can neither assign nor update in place (concurrent trees)
+ * have the entry removed and inserted again instead.
+ */
+unsigned char InsertOrAssign(KEY uKey, void *pContent, TREE pTree)
+{
+    TREEENGINE pEngine = pTree->pEngine;
+    unsigned char ucInserted;
+    void **ppSlot;
+    NODE pNode;
+
+    TREE_STAT(pTree, nInserts, 1);
+    TREE_TRACE_EVENT(pTree, TRACE_INSERT, NULL, uKey, uKey);
+    if (pEngine != NULL)
+    {
+        if (pEngine->cbAssign != NULL)
+        {
+            ucInserted = pEngine->cbAssign(uKey, pContent, pTree);
+            if (ucInserted == TRUE)
+            {
+                pTree->nSize++;
+            }
+            return ucInserted;
+        }
+        ppSlot = pEngine->cbSlot != NULL ? pEngine->cbSlot(uKey, pTree) : NULL;
+        if (ppSlot != NULL)
+        {
+            *ppSlot = pContent;
+            return FALSE;
+        }
+        if (pEngine->cbInsert(uKey, pContent, pTree) == TRUE)
+        {
+            pTree->nSize++;
+            return TRUE;
+        }
+        pEngine->cbRemove(uKey, pTree, NULL);
+        pEngine->cbInsert(uKey, pContent, pTree);
+        return FALSE;
+    }
+
+    pNode = PlaceNode(uKey, pContent, pTree, &ucInserted);
+    pNode->pContent = pContent;
+    return ucInserted;
+}
+
+/*
+ * Find a key, inserting it with NULL contents if it doesn't exist, in a
+ * single descent. Returns the address of the key's contents so they can
+ * be read and updated in place, valid until the key is removed (for an
+ * engine tree, until the tree next changes).
+ * *pucInserted, if not NULL, is set to whether the key was inserted.
+ * Returns NULL for an engine tree whose entries can't be updated in place.
+ */
+void **FindOrInsert(KEY uKey, TREE pTree, unsigned char *pucInserted)
+{
+    TREEENGINE pEngine = pTree->pEngine;
+    unsigned char ucInserted = FALSE;
+    void **ppSlot = NULL;
+
+    TREE_STAT(pTree, nInserts, 1);
+    TREE_TRACE_EVENT(pTree, TRACE_INSERT, NULL, uKey, uKey);
+    if (pEngine == NULL)
+    {
+        ppSlot = &PlaceNode(uKey, NULL, pTree, &ucInserted)->pContent;
+    }
+    else if (pEngine->cbSlot != NULL)
+    {
+        ppSlot = pEngine->cbSlot(uKey, pTree);
+        if (ppSlot == NULL && pEngine->cbInsert(uKey, NULL, pTree) == TRUE)
+        {
+            pTree->nSize++;
+            ucInserted = TRUE;
+            ppSlot = pEngine->cbSlot(uKey, pTree);
+        }
+    }
+
+    if (pucInserted != NULL)
+    {
+        *pucInserted = ucInserted;
+    }
+    return ppSlot;
+}
+
+/*
+ * Return the node holding a key, linking in a new one with the given
+ * contents if there is none. *pucInserted is set to whether it was new.
+ * A node is only allocated once the key is known to be missing.
+ */
+NODE PlaceNode(KEY uKey, void *pContent, TREE pTree, unsigned char *pucInserted)
+{
+    int nCompare;
+    NODE pNode, pParent = LocateEnds(uKey, pTree, &nCompare);
+
+    if (pParent == NULL)
+    {
+        pParent = LocateNode(uKey, pTree, &nCompare);
+    }
+    if (pParent != NULL && nCompare == 0)
+    {
+        *pucInserted = FALSE;
+        return pParent;
+    }
+
+    pNode = AllocNode(pTree);
+    pNode->uKey = uKey;
+    pNode->pContent = pContent;
+    LinkNode(pNode, pParent, nCompare, pTree);
+    *pucInserted = TRUE;
+    return pNode;
+}
+
+/*
+ * Insert a new node using an iterator's position as a hint of where it
+ * belongs. A key that falls next to the hint is linked in with one or two
+ * comparisons; otherwise the search climbs from the hint only as far as
+ * needed, so streams of nearby keys avoid full descents from the root.
+ * Without a usable hint, or for an engine tree, this is Insert.
+ * Insertion fails if the key already exists.
+ */
+unsigned char InsertHint(ITERATOR pHint, KEY uKey, void *pContent, TREE pTree)
+{
+    NODE pNode, pParent;
+    int nCompare;
+
+    if (pTree->pEngine != NULL || pHint == NULL || pHint->pTree != pTree || pHint->pNode == NULL)
+    {
+        return Insert(uKey, pContent, pTree);
+    }
+
+    TREE_STAT(pTree, nInserts, 1);
+    TREE_TRACE_EVENT(pTree, TRACE_INSERT, NULL, uKey, uKey);
+    pParent = LocateHint(pHint->pNode, uKey, pTree, &nCompare);
+    if (nCompare == 0)
+    {
+        return FALSE;
+    }
+
+    pNode = AllocNode(pTree);
+    pNode->uKey = uKey;
+    pNode->pContent = pContent;
+    LinkNode(pNode, pParent, nCompare, pTree);
+    return TRUE;
+}
+
+/*
+ * Return the tree's first or last node if a key is beyond, or equal to,
+ * that end of the tree, setting *pnCompare as LocateNode does. Keys
+ * arriving in ascending or descending order are then placed without a
+ * descent. Returns NULL if the key falls between the ends.
+ */
+NODE LocateEnds(KEY uKey, TREE pTree, int *pnCompare)
+{
+    if (pTree->pLast == NULL)
+    {
+        return NULL;
+    }
+
+    *pnCompare = COMPARE_KEYS(pTree, uKey, pTree->pLast->uKey);
+    if (*pnCompare >= 0)
+    {
+        return pTree->pLast;
+    }
+    *pnCompare = COMPARE_KEYS(pTree, uKey, pTree->pFirst->uKey);
+    if (*pnCompare <= 0)
+    {
+        return pTree->pFirst;
+    }
+    return NULL;
+}
+
+/*
+ * Find where a key belongs starting from a hint node rather than the
+ * root, setting *pnCompare as LocateNode does.
+ */
+NODE LocateHint(NODE pHint, KEY uKey, TREE pTree, int *pnCompare)
+{
+    NODE pNode, pNeighbour;
+    int nCompare, nSide;
+
+    nSide = COMPARE_KEYS(pTree, uKey, pHint->uKey);
+    if (nSide == 0)
+    {
+        *pnCompare = 0;
+        return pHint;
+    }
+
+    /* Between the hint and its in-order neighbour, one of the two has a free child on the key's side */
+    pNeighbour = nSide > 0 ? GetNext(pHint) : GetPrevious(pHint);
+    nCompare = pNeighbour != NULL ? COMPARE_KEYS(pTree, uKey, pNeighbour->uKey) : -nSide;
+    if (nCompare == 0)
+    {
+        *pnCompare = 0;
+        return pNeighbour;
+    }
+    if ((nCompare > 0) != (nSide > 0))
+    {
+        *pnCompare = nSide;
+        if ((nSide > 0 ? pHint->pRightChild : pHint->pLeftChild) == NULL)
+        {
+            return pHint;
+        }
+        *pnCompare = -nSide;
+        return pNeighbour;
+    }
+
+    /* Climb to the lowest ancestor whose subtree spans the key, then descend from there */
+    pNode = pHint;
+    while (pNode->pParent != NULL)
+    {
+        if ((nSide > 0) != (pNode == pNode->pParent->pRightChild))
+        {
+            nCompare = COMPARE_KEYS(pTree, uKey, pNode->pParent->uKey);
+            if (nCompare == 0)
+            {
+                *pnCompare = 0;
+                return pNode->pParent;
+            }
+            if ((nCompare > 0) != (nSide > 0))
+            {
+                break;
+            }
+        }
+        pNode = pNode->pParent;
+    }
+    return LocateFrom(pNode, uKey, pTree, pnCompare);
+}
+
+/*
+ * Link a new node in as the given side's child of pParent, which must be
+ * free (the root if pParent is NULL), and rebalance.
+ */
+void LinkNode(NODE pNode, NODE pParent, int nCompare, TREE pTree)
+{
+    /* The caller already knows the side, so link directly rather than through AttachNodes */
+    pNode->pParent = pParent;
+    if (pParent == NULL)
+    {
+        pTree->pRoot = pNode;
+        pTree->pFirst = pNode;
+        pTree->pLast = pNode;
+        if (pTree->nFlags & TREE_THREADED)
+        {
+            ThreadNode(pNode, NULL, NULL);
+        }
+    }
+    else if (nCompare < 0)
+    {
+        pParent->pLeftChild = pNode;
+        if (pTree->pFirst == pParent)
+        {
+            pTree->pFirst = pNode;
+        }
+        if (pTree->nFlags & TREE_THREADED)
+        {
+            ThreadNode(pNode, NODE_LINKS(pParent)->pPrevious, pParent);
+        }
+    }
+    else
+    {
+        pParent->pRightChild = pNode;
+        if (pTree->pLast == pParent)
+        {
+            pTree->pLast = pNode;
+        }
+        if (pTree->nFlags & TREE_THREADED)
+        {
+            ThreadNode(pNode, pParent, NODE_LINKS(pParent)->pNext);
+        }
+    }
+    pTree->nSize++;
+
+    if (pTree->nFlags & TREE_ORDER_STATS)
+    {
+        AddCount(pParent, 1);
+    }
+
+    if (pTree->cbInsert != NULL)
+    {
+        TREE_STAT(pTree, nRetraces, 1);
+        pTree->cbInsert(pNode);
+    }
+}
+
+/*
+ * Remove a node from the tree.
+ */
+unsigned char Remove(KEY uKey, TREE pTree)
+{
+    return RemoveAndGet(uKey, pTree, NULL);
+}
+
+/*
+ * Remove a key in a single descent, storing the contents it had in
+ * *ppContent if ppContent isn't NULL. Returns FALSE, leaving *ppContent
+ * alone, if the key doesn't exist.
+ */
+unsigned char RemoveAndGet(KEY uKey, TREE pTree, void **ppContent)
+{
+    NODE pNode;
+    void *pContent;
+    unsigned char ucResponse;
+
+    TREE_STAT(pTree, nRemoves, 1);
+    TREE_TRACE_EVENT(pTree, TRACE_REMOVE, NULL, uKey, uKey);
+    if (pTree->pEngine != NULL)
+    {
+        pContent = NULL;
+        ucResponse = pTree->pEngine->cbRemove(uKey, pTree, &pContent);
+    }
+    else
+    {
+        pNode = SearchNode(uKey, pTree);
+        pContent = pNode != NULL ? pNode->pContent : NULL;
+        ucResponse = RemoveNode(pNode, pTree, TRUE);
+    }
+
+    if (ucResponse == TRUE)
+    {
+        pTree->nSize--;
+        if (ppContent != NULL)
+        {
+            *ppContent = pContent;
+        }
     }
 
     return ucResponse;
 }
 
 /*
- * Remove a node from the tree. ucOriginal designates whether this is the
- * original call to the method, or whether it is a subsequent internally
- * called removal (for cases when a removed node has two child nodes).
+ * Remove a node from the tree. ucOriginal designates whether this is the
+ * original call to the method, or whether it is a subsequent internally
+ * called removal (for cases when a removed node has two child nodes).
+ */
+unsigned char RemoveNode(NODE pNode, TREE pTree, unsigned char ucOriginal)
+{
+    NODE pOtherNode = NULL, pChildNode;
+    if (pNode == NULL)
+    {
+        return FALSE;
+    }
+
+    if (pTree->cbUnlink != NULL && (pNode->pLeftChild == NULL || pNode->pRightChild == NULL))
+    {
+        pTree->cbUnlink(pNode);
+    }
+
+    if (pTree->pFirst == pNode)
+    {
+        pTree->pFirst = GetNext(pNode);
+    }
+    if (pTree->pLast == pNode)
+    {
+        pTree->pLast = GetPrevious(pNode);
+    }
+
+    if (pNode->pLeftChild == NULL || pNode->pRightChild == NULL)
+    {
+        pChildNode = pNode->pLeftChild == NULL ? pNode->pRightChild : pNode->pLeftChild;
+        if (pNode->pParent == NULL)
+        {
+            pTree->pRoot = pChildNode;
+            if (pChildNode != NULL)
+            {
+                pChildNode->pParent = NULL;
+                pOtherNode = pChildNode;
+            }
+        }
+        else
+        {
+            pOtherNode = pNode->pParent;
+            DetachNodes(pOtherNode, pNode);
+            AttachNodes(pOtherNode, pChildNode);
+            if (pTree->nFlags & TREE_ORDER_STATS)
+            {
+                AddCount(pOtherNode, -1);
+            }
+        }
+    }
+    else
+    {
+        pOtherNode = GetPrevious(pNode);
+        RemoveNode(pOtherNode, pTree, FALSE);
+        AttachNodes(pNode->pParent, pOtherNode);
+        AttachNodes(pOtherNode, pNode->pLeftChild);
+        AttachNodes(pOtherNode, pNode->pRightChild);
+        if (pTree->pFirst == pNode)
+        {
+            pTree->pFirst = pOtherNode;
+        }
+
+        /* The replacement takes over the removed node's position, and with it its metadata */
+        if (pTree->nNodeMetaSize > 0)
+        {
+            memcpy(NODE_META(pOtherNode), NODE_META(pNode), pTree->nNodeMetaSize);
+        }
+        if (pTree->nFlags & TREE_ORDER_STATS)
+        {
+            NODE_COUNT(pOtherNode) = NODE_COUNT(pNode);
+        }
+    }
+
+    /* A subsequent removal only unlinks the node, as it is reattached by the caller */
+    if (ucOriginal == TRUE)
+    {
+        if (pTree->nFlags & TREE_THREADED)
+        {
+            UnthreadNode(pNode);
+        }
+        FreeNode(pNode);
+    }
+
+    if (pTree->cbRemove != NULL)
+    {
+        TREE_STAT(pTree, nRetraces, 1);
+        pTree->cbRemove(pOtherNode, ucOriginal);
+    }
+
+    return TRUE;
+}
+
+/*
+ * Build a perfectly balanced tree out of nCount keys given in strictly
+ * ascending order, in linear time. Engines build their own structure,
+ * and those without a bulk build insert the keys one by one instead, in
+ * O(n log n). ppContents may be NULL, in which case every node's content
+ * is NULL. Fails if the tree isn't empty or the keys aren't strictly
+ * ascending.
+ */
+unsigned char BuildFromSorted(KEY *pKeys, void **ppContents, int nCount, TREE pTree)
+{
+    NODE *ppNodes;
+    int i;
+
+    if (pTree->nSize > 0)
+    {
+        return FALSE;
+    }
+
+    for (i = 1; i < nCount; i++)
+    {
+        if (COMPARE_KEYS(pTree, pKeys[i - 1], pKeys[i]) >= 0)
+        {
+            return FALSE;
+        }
+    }
+
+    if (nCount <= 0)
+    {
+        return TRUE;
+    }
+
+    if (pTree->pEngine != NULL && pTree->pEngine->cbBuild != NULL)
+    {
+        if (!pTree->pEngine->cbBuild(pKeys, ppContents, nCount, pTree))
+        {
+            return FALSE;
+        }
+        pTree->nSize = nCount;
+        return TRUE;
+    }
+
+    if (pTree->pEngine != NULL)
+    {
+        for (i = 0; i < nCount; i++)
+        {
+            Insert(pKeys[i], ppContents != NULL ? ppContents[i] : NULL, pTree);
+        }
+        return TRUE;
+    }
+
+    ppNodes = (NODE *)malloc(nCount * sizeof(*ppNodes));
+    for (i = 0; i < nCount; i++)
+    {
+        ppNodes[i] = AllocNode(pTree);
+        ppNodes[i]->uKey = pKeys[i];
+        ppNodes[i]->pContent = ppContents != NULL ? ppContents[i] : NULL;
+    }
+
+    pTree->nSize = nCount;
+    BuildTree(ppNodes, nCount, pTree);
+
+    free(ppNodes);
+    return TRUE;
+}
+
+/*
+ * Insert nCount keys given in any order, with their matching contents
+ * (ppContents may be NULL). The keys are sorted and merged into the tree in
+ * key order, rebuilding the whole tree when the batch is large compared to
+ * it. If pResults isn't NULL, pResults[i] is set to whether pKeys[i] was
+ * inserted, exactly as if Insert had been called for each key in turn.
+ * Returns the number of keys inserted.
  */
-unsigned char RemoveNode(NODE pNode, TREE pTree, unsigned char ucOriginal)
+int InsertBatch(KEY *pKeys, void **ppContents, int nCount, unsigned char *pResults, TREE pTree)
 {
-    NODE pOtherNode = NULL, pChildNode;
-    if (pNode == NULL)
+    BATCHENTRY pEntries;
+    NODE *ppNodes, *ppMerged, pNode;
+    int i, j, nCompare, nMerged = 0, nInserted = 0;
+
+    if (nCount <= 0)
     {
-        return FALSE;
+        return 0;
     }
 
-    if (pTree->pFirst == pNode)
+    pEntries = SortBatch(pKeys, nCount, pResults, pTree);
+
+    if (RebuildForBatch(nCount, pTree) == FALSE)
     {
-        pTree->pFirst = GetNext(pNode);
+        /* Insert in key order so consecutive descents share their path */
+        for (i = 0; i < nCount; i++)
+        {
+            if (i > 0 && COMPARE_KEYS(pTree, pEntries[i].uKey, pEntries[i - 1].uKey) == 0)
+            {
+                continue;
+            }
+            if (Insert(pEntries[i].uKey, ppContents != NULL ? ppContents[pEntries[i].nIndex] : NULL, pTree) == TRUE)
+            {
+                nInserted++;
+                if (pResults != NULL)
+                {
+                    pResults[pEntries[i].nIndex] = TRUE;
+                }
+            }
+        }
+        free(pEntries);
+        return nInserted;
     }
 
-    if (pNode->pLeftChild == NULL || pNode->pRightChild == NULL)
+    /* The per key path above counts and records each Insert itself */
+    TREE_STAT(pTree, nInserts, nCount);
+    TREE_TRACE_KEYS(pTree, TRACE_INSERT, pKeys, nCount);
+
+    /* Merge the tree's nodes with the batch and rebuild from the result */
+    ppNodes = CollectNodes(pTree);
+    ppMerged = (NODE *)malloc((pTree->nSize + nCount) * sizeof(*ppMerged));
+    for (i = 0, j = 0; i < nCount; i++)
     {
-        pChildNode = pNode->pLeftChild == NULL ? pNode->pRightChild : pNode->pLeftChild;
-        if (pNode->pParent == NULL)
+        if (i > 0 && COMPARE_KEYS(pTree, pEntries[i].uKey, pEntries[i - 1].uKey) == 0)
         {
-            pTree->pRoot = pChildNode;
-            if (pChildNode != NULL)
+            continue;
+        }
+        nCompare = 1;
+        while (j < pTree->nSize && (nCompare = COMPARE_KEYS(pTree, ppNodes[j]->uKey, pEntries[i].uKey)) < 0)
+        {
+            ppMerged[nMerged++] = ppNodes[j++];
+        }
+        if (j < pTree->nSize && nCompare == 0)
+        {
+            continue;
+        }
+
+        pNode = AllocNode(pTree);
+        pNode->uKey = pEntries[i].uKey;
+        pNode->pContent = ppContents != NULL ? ppContents[pEntries[i].nIndex] : NULL;
+        ppMerged[nMerged++] = pNode;
+        nInserted++;
+        if (pResults != NULL)
+        {
+            pResults[pEntries[i].nIndex] = TRUE;
+        }
+    }
+    while (j < pTree->nSize)
+    {
+        ppMerged[nMerged++] = ppNodes[j++];
+    }
+
+    pTree->nSize = nMerged;
+    BuildTree(ppMerged, nMerged, pTree);
+
+    free(ppMerged);
+    free(ppNodes);
+    free(pEntries);
+    return nInserted;
+}
+
+/*
+ * Remove nCount keys given in any order. The keys are sorted and removed in
+ * key order, rebuilding the whole tree from the remaining nodes when the
+ * batch is large compared to it. If pResults isn't NULL, pResults[i] is set
+ * to whether pKeys[i] was removed, exactly as if Remove had been called for
+ * each key in turn. Returns the number of keys removed.
+ */
+int RemoveBatch(KEY *pKeys, int nCount, unsigned char *pResults, TREE pTree)
+{
+    BATCHENTRY pEntries;
+    NODE *ppNodes;
+    int i, j, nCompare, nKept = 0, nRemoved = 0;
+
+    if (nCount <= 0)
+    {
+        return 0;
+    }
+
+    pEntries = SortBatch(pKeys, nCount, pResults, pTree);
+
+    if (RebuildForBatch(nCount, pTree) == FALSE)
+    {
+        for (i = 0; i < nCount; i++)
+        {
+            if (i > 0 && COMPARE_KEYS(pTree, pEntries[i].uKey, pEntries[i - 1].uKey) == 0)
             {
-                pChildNode->pParent = NULL;
-                pOtherNode = pChildNode;
+                continue;
+            }
+            if (Remove(pEntries[i].uKey, pTree) == TRUE)
+            {
+                nRemoved++;
+                if (pResults != NULL)
+                {
+                    pResults[pEntries[i].nIndex] = TRUE;
+                }
+            }
+        }
+        free(pEntries);
+        return nRemoved;
+    }
+
+    /* The per key path above counts and records each Remove itself */
+    TREE_STAT(pTree, nRemoves, nCount);
+    TREE_TRACE_KEYS(pTree, TRACE_REMOVE, pKeys, nCount);
+
+    /* Compact the tree's nodes in place, freeing the ones matching the batch */
+    ppNodes = CollectNodes(pTree);
+    for (i = 0, j = 0; j < pTree->nSize; j++)
+    {
+        nCompare = 1;
+        while (i < nCount && (nCompare = COMPARE_KEYS(pTree, pEntries[i].uKey, ppNodes[j]->uKey)) < 0)
+        {
+            i++;
+        }
+        if (i < nCount && nCompare == 0)
+        {
+            FreeNode(ppNodes[j]);
+            nRemoved++;
+            if (pResults != NULL)
+            {
+                pResults[pEntries[i].nIndex] = TRUE;
             }
+            i++;
         }
         else
         {
-            pOtherNode = pNode->pParent;
-            DetachNodes(pOtherNode, pNode);
-            AttachNodes(pOtherNode, pChildNode);
+            ppNodes[nKept++] = ppNodes[j];
         }
     }
-    else
+
+    pTree->nSize = nKept;
+    BuildTree(ppNodes, nKept, pTree);
+
+    free(ppNodes);
+    free(pEntries);
+    return nRemoved;
+}
+
+/*
+ * Return a sorted copy of a batch's keys, and reset its results. The sort
+ * is a stable merge sort, so within a run of equal keys the earliest one
+ * in the batch comes first.
+ */
+BATCHENTRY SortBatch(KEY *pKeys, int nCount, unsigned char *pResults, TREE pTree)
+{
+    BATCHENTRY pEntries, pBuffer, pSwap;
+    int i, nWidth, nLeft, nMiddle, nRight, l, r;
+
+    pEntries = (BATCHENTRY)malloc(nCount * sizeof(*pEntries));
+    pBuffer = (BATCHENTRY)malloc(nCount * sizeof(*pBuffer));
+    for (i = 0; i < nCount; i++)
     {
-        pOtherNode = GetPrevious(pNode);
-        RemoveNode(pOtherNode, pTree, FALSE);
-        AttachNodes(pNode->pParent, pOtherNode);
-        AttachNodes(pOtherNode, pNode->pLeftChild);
-        AttachNodes(pOtherNode, pNode->pRightChild);
+        pEntries[i].uKey = pKeys[i];
+        pEntries[i].nIndex = i;
+        if (pResults != NULL)
+        {
+            pResults[i] = FALSE;
+        }
+    }
+
+    for (nWidth = 1; nWidth < nCount; nWidth *= 2)
+    {
+        for (nLeft = 0; nLeft < nCount; nLeft += 2 * nWidth)
+        {
+            nMiddle = nLeft + nWidth < nCount ? nLeft + nWidth : nCount;
+            nRight = nMiddle + nWidth < nCount ? nMiddle + nWidth : nCount;
+            for (i = nLeft, l = nLeft, r = nMiddle; i < nRight; i++)
+            {
+                if (l < nMiddle && (r >= nRight || COMPARE_KEYS(pTree, pEntries[l].uKey, pEntries[r].uKey) <= 0))
+                {
+                    pBuffer[i] = pEntries[l++];
+                }
+                else
+                {
+                    pBuffer[i] = pEntries[r++];
+                }
+            }
+        }
+        pSwap = pEntries;
+        pEntries = pBuffer;
+        pBuffer = pSwap;
     }
 
-    FreeNode(pNode);
+    free(pBuffer);
+    return pEntries;
+}
 
-    if (pTree->cbRemove != NULL)
+/*
+ * Return whether a batch of nCount keys should be merged by rebuilding the
+ * tree. Only possible for binary node trees whose variant can restore its
+ * node metadata after a bulk build.
+ */
+unsigned char RebuildForBatch(int nCount, TREE pTree)
+{
+    if (pTree->pEngine != NULL || (pTree->cbInsert != NULL && pTree->cbBuild == NULL))
     {
-        pTree->cbRemove(pOtherNode, ucOriginal);
+        return FALSE;
     }
+    return nCount >= pTree->nSize / BATCH_REBUILD_RATIO;
+}
 
-    return TRUE;
+/*
+ * Return a newly allocated array of the tree's nodes in key order.
+ */
+NODE *CollectNodes(TREE pTree)
+{
+    NODE *ppNodes, pNode;
+    int i = 0;
+
+    ppNodes = (NODE *)malloc((pTree->nSize + 1) * sizeof(*ppNodes));
+    for (pNode = GetFirst(pTree); pNode != NULL; pNode = GetNext(pNode))
+    {
+        ppNodes[i++] = pNode;
+    }
+
+    return ppNodes;
+}
+
+/*
+ * Make the given nodes, in key order, the entire contents of the tree,
+ * linking them into a perfectly balanced tree.
+ */
+void BuildTree(NODE *ppNodes, int nCount, TREE pTree)
+{
+    int i;
+
+    pTree->pRoot = BuildNodes(ppNodes, nCount, NULL, 0, pTree);
+    pTree->pFirst = nCount > 0 ? ppNodes[0] : NULL;
+    pTree->pLast = nCount > 0 ? ppNodes[nCount - 1] : NULL;
+
+    if (pTree->nFlags & TREE_THREADED)
+    {
+        for (i = 0; i < nCount; i++)
+        {
+            NODE_LINKS(ppNodes[i])->pPrevious = i > 0 ? ppNodes[i - 1] : NULL;
+            NODE_LINKS(ppNodes[i])->pNext = i < nCount - 1 ? ppNodes[i + 1] : NULL;
+        }
+    }
+}
+
+/*
+ * Link the given nodes, in key order, into a perfectly balanced subtree
+ * below pParent and return the subtree's root. The tree's build callback
+ * is called on every node once both of its subtrees are complete.
+ */
+NODE BuildNodes(NODE *ppNodes, int nCount, NODE pParent, int nDepth, TREE pTree)
+{
+    NODE pNode;
+    int nMiddle;
+
+    if (nCount <= 0)
+    {
+        return NULL;
+    }
+
+    nMiddle = nCount / 2;
+    pNode = ppNodes[nMiddle];
+    pNode->pParent = pParent;
+    pNode->pLeftChild = BuildNodes(ppNodes, nMiddle, pNode, nDepth + 1, pTree);
+    pNode->pRightChild = BuildNodes(ppNodes + nMiddle + 1, nCount - nMiddle - 1, pNode, nDepth + 1, pTree);
+    if (pTree->nFlags & TREE_ORDER_STATS)
+    {
+        NODE_COUNT(pNode) = nCount;
+    }
+
+    if (pTree->cbBuild != NULL)
+    {
+        pTree->cbBuild(pNode, nDepth);
+    }
+
+    return pNode;
 }
 
 /*
@@ -491,12 +2125,7 @@ NODE GetFirst(TREE pTree)
  */
 NODE GetLast(TREE pTree)
 {
-    NODE pNode = pTree->pRoot;
-    while (pNode != NULL && pNode->pRightChild != NULL)
-    {
-        pNode = pNode->pRightChild;
-    }
-    return pNode;
+    return pTree->pLast;
 }
 
 /*
@@ -504,8 +2133,12 @@ NODE GetLast(TREE pTree)
  */
 NODE GetNext(NODE pNode)
 {
-    int nPrevKey = pNode->nKey;
-    if (pNode->pRightChild != NULL)
+    NODE pPrevNode;
+    if (pNode->pTree->nFlags & TREE_THREADED)
+    {
+        return NODE_LINKS(pNode)->pNext;
+    }
+    else if (pNode->pRightChild != NULL)
     {
         pNode = pNode->pRightChild;
         while (pNode->pLeftChild != NULL)
@@ -516,10 +2149,11 @@ NODE GetNext(NODE pNode)
     }
     else
     {
+        pPrevNode = pNode;
         pNode = pNode->pParent;
-        while (pNode != NULL && pNode->nKey < nPrevKey)
+        while (pNode != NULL && pNode->pRightChild == pPrevNode)
         {
-            nPrevKey = pNode->nKey;
+            pPrevNode = pNode;
             pNode = pNode->pParent;
         }
         return pNode;
@@ -531,8 +2165,12 @@ NODE GetNext(NODE pNode)
  */
 NODE GetPrevious(NODE pNode)
 {
-    int nPrevKey = pNode->nKey;
-    if (pNode->pLeftChild != NULL)
+    NODE pPrevNode;
+    if (pNode->pTree->nFlags & TREE_THREADED)
+    {
+        return NODE_LINKS(pNode)->pPrevious;
+    }
+    else if (pNode->pLeftChild != NULL)
     {
         pNode = pNode->pLeftChild;
         while (pNode->pRightChild != NULL)
@@ -543,10 +2181,11 @@ NODE GetPrevious(NODE pNode)
     }
     else
     {
+        pPrevNode = pNode;
         pNode = pNode->pParent;
-        while (pNode != NULL && pNode->nKey > nPrevKey)
+        while (pNode != NULL && pNode->pLeftChild == pPrevNode)
         {
-            nPrevKey = pNode->nKey;
+            pPrevNode = pNode;
             pNode = pNode->pParent;
         }
         return pNode;
@@ -559,7 +2198,16 @@ NODE GetPrevious(NODE pNode)
  */
 void Attach(ITERATOR pIter, TREE pTree)
 {
+    TREE_TRACE_EVENT(pTree, TRACE_ATTACH, pIter, IntKey(0), IntKey(0));
+    if (pTree->pEngine != NULL)
+    {
+        EngineStart(pIter, pTree);
+        pTree->pEngine->cbSeekEnd(pIter, pIter->ucDirection);
+        return;
+    }
+
     pIter->pTree = pTree;
+    pIter->pEnd = NULL;
     if (pIter->ucDirection == FORWARD)
     {
         pIter->pNode = GetFirst(pTree);
@@ -580,6 +2228,120 @@ void AttachEnd(ITERATOR pIter, TREE pTree)
     Attach(pIter, pTree);
 }
 
+/*
+ * Attach an iterator at a key, running to the end of the tree in the
+ * iterator's direction. Forward iterators start at the first key not less
+ * than uKey, backward iterators at the last key not greater than uKey.
+ */
+void AttachAt(ITERATOR pIter, TREE pTree, KEY uKey)
+{
+    NODE pNode;
+
+    TREE_TRACE_EVENT(pTree, TRACE_ATTACH_AT, pIter, uKey, uKey);
+    if (pTree->pEngine != NULL)
+    {
+        EngineStart(pIter, pTree);
+        if (pIter->ucDirection == FORWARD)
+        {
+            pTree->pEngine->cbSeek(pIter, uKey, FALSE);
+        }
+        else
+        {
+            pTree->pEngine->cbSeek(pIter, uKey, TRUE);
+            if (pIter->pCursor != NULL)
+            {
+                pTree->pEngine->cbStep(pIter, BACKWARD);
+            }
+            else
+            {
+                pTree->pEngine->cbSeekEnd(pIter, BACKWARD);
+            }
+        }
+        return;
+    }
+
+    pIter->pTree = pTree;
+    pIter->pEnd = NULL;
+    if (pIter->ucDirection == FORWARD)
+    {
+        pIter->pNode = LowerBoundNode(uKey, pTree);
+    }
+    else
+    {
+        pNode = UpperBoundNode(uKey, pTree);
+        pIter->pNode = pNode != NULL ? GetPrevious(pNode) : GetLast(pTree);
+    }
+    pTree->nIterators++;
+}
+
+/*
+ * Attach an iterator to the keys in [uLow, uHigh), visited in the
+ * iterator's direction.
+ */
+void AttachRange(ITERATOR pIter, TREE pTree, KEY uLow, KEY uHigh)
+{
+    NODE pLow, pHigh;
+
+    TREE_TRACE_EVENT(pTree, TRACE_ATTACH_RANGE, pIter, uLow, uHigh);
+    if (pTree->pEngine != NULL)
+    {
+        EngineStart(pIter, pTree);
+        if (COMPARE_KEYS(pTree, uLow, uHigh) >= 0)
+        {
+            return;
+        }
+
+        pIter->ucBounded = TRUE;
+        if (pIter->ucDirection == FORWARD)
+        {
+            pIter->uEnd = uHigh;
+            pTree->pEngine->cbSeek(pIter, uLow, FALSE);
+        }
+        else
+        {
+            pIter->uEnd = uLow;
+            pTree->pEngine->cbSeek(pIter, uHigh, FALSE);
+            if (pIter->pCursor != NULL)
+            {
+                pTree->pEngine->cbStep(pIter, BACKWARD);
+            }
+            else
+            {
+                pTree->pEngine->cbSeekEnd(pIter, BACKWARD);
+            }
+        }
+        EngineLimit(pIter);
+        return;
+    }
+
+    pIter->pTree = pTree;
+    pTree->nIterators++;
+    if (COMPARE_KEYS(pTree, uLow, uHigh) >= 0)
+    {
+        pIter->pNode = NULL;
+        pIter->pEnd = NULL;
+        return;
+    }
+
+    pLow = LowerBoundNode(uLow, pTree);
+    pHigh = LowerBoundNode(uHigh, pTree);
+    if (pIter->ucDirection == FORWARD)
+    {
+        pIter->pNode = pLow;
+        pIter->pEnd = pHigh;
+    }
+    else
+    {
+        pIter->pNode = pHigh != NULL ? GetPrevious(pHigh) : GetLast(pTree);
+        pIter->pEnd = pLow != NULL ? GetPrevious(pLow) : GetLast(pTree);
+    }
+
+    if (pIter->pNode == pIter->pEnd)
+    {
+        pIter->pNode = NULL;
+    }
+}
+
 /*
  * Return the contents of the current location of the
  * iterator.
@@ -587,14 +2349,37 @@ void AttachEnd(ITERATOR pIter, TREE pTree)
 void *Current(ITERATOR pIter)
 {
     void *pContent = NULL;
-    if (pIter->pNode != NULL)
+    if (pIter->pCursor != NULL)
+    {
+        pIter->pTree->pEngine->cbCurrent(pIter, NULL, &pContent);
+    }
+    else if (pIter->pNode != NULL)
     {
-        DebugNode(pIter->pNode);
         pContent = pIter->pNode->pContent;
     }
     return pContent;
 }
 
+/*
+ * Return the key of the current location of the iterator.
+ * The key is zeroed if the iterator is past its end.
+ */
+KEY CurrentKey(ITERATOR pIter)
+{
+    KEY uKey;
+    if (pIter->pCursor != NULL)
+    {
+        pIter->pTree->pEngine->cbCurrent(pIter, &uKey, NULL);
+        return uKey;
+    }
+    if (pIter->pNode != NULL)
+    {
+        return pIter->pNode->uKey;
+    }
+    uKey.llInt = 0;
+    return uKey;
+}
+
 /*
  * Return the contents of the current location of the
  * iterator and advance the iterator to the next node
@@ -604,7 +2389,13 @@ void *Next(ITERATOR pIter)
 {
     void *pContent = Current(pIter);
 
-    if (pIter->pNode != NULL)
+    TREE_TRACE_EVENT(pIter->pTree, TRACE_NEXT, pIter, IntKey(0), IntKey(0));
+    if (pIter->pCursor != NULL)
+    {
+        pIter->pTree->pEngine->cbStep(pIter, pIter->ucDirection);
+        EngineLimit(pIter);
+    }
+    else if (pIter->pNode != NULL)
     {
         if (pIter->ucDirection == FORWARD)
         {
@@ -614,8 +2405,12 @@ void *Next(ITERATOR pIter)
         {
             pIter->pNode = GetPrevious(pIter->pNode);
         }
+        if (pIter->pNode == pIter->pEnd)
+        {
+            pIter->pNode = NULL;
+        }
     }
-    
+
     return pContent;
 }
 
@@ -626,7 +2421,50 @@ void Detach(ITERATOR pIter)
 {
     if (pIter->pTree != NULL)
     {
+        TREE_TRACE_EVENT(pIter->pTree, TRACE_DETACH, pIter, IntKey(0), IntKey(0));
+        if (pIter->pTree->pEngine != NULL && pIter->pTree->pEngine->cbDetach != NULL)
+        {
+            pIter->pTree->pEngine->cbDetach(pIter);
+        }
+        pIter->pCursor = NULL;
+        pIter->pState = NULL;
         pIter->pTree->nIterators--;
         pIter->pTree = NULL;
     }
+}
+
+/*
+ * Attach an iterator to an engine tree without positioning it.
+ */
+void EngineStart(ITERATOR pIter, TREE pTree)
+{
+    pIter->pTree = pTree;
+    pIter->pNode = NULL;
+    pIter->pEnd = NULL;
+    pIter->pCursor = NULL;
+    pIter->nSlot = 0;
+    pIter->pState = NULL;
+    pIter->ucBounded = FALSE;
+    pTree->nIterators++;
+}
+
+/*
+ * Move an engine iterator past its end if it has left its range.
+ */
+void EngineLimit(ITERATOR pIter)
+{
+    KEY uKey;
+    int nCompare;
+
+    if (pIter->ucBounded == FALSE || pIter->pCursor == NULL)
+    {
+        return;
+    }
+
+    pIter->pTree->pEngine->cbCurrent(pIter, &uKey, NULL);
+    nCompare = COMPARE_KEYS(pIter->pTree, uKey, pIter->uEnd);
+    if ((pIter->ucDirection == FORWARD && nCompare >= 0) || (pIter->ucDirection == BACKWARD && nCompare < 0))
+    {
+        pIter->pCursor = NULL;
+    }
 }
\ No newline at end of file
@@ -8,6 +8,8 @@
 #ifndef __BINARYSEARCHTREE_H__
 #define __BINARYSEARCHTREE_H__
 
+#include "NodePool.h"
+
 
 /* Boolean */
 #define TRUE 1
@@ -17,29 +19,158 @@
 #define FORWARD 0
 #define BACKWARD 1
 
+/* Key types */
+#define KEY_INT 0 /* int keys, the default */
+#define KEY_INT64 1 /* long long keys */
+#define KEY_STRING 2 /* Null terminated strings, compared with strcmp */
+#define KEY_CUSTOM 3 /* Arbitrary keys compared with the tree's cbCompare */
+
+/* Tree creation flags */
+#define TREE_POOLED 0x01 /* Allocate nodes from a per-tree slab pool */
+#define TREE_THREADED 0x02 /* Keep in-order next/previous links in every node */
+#define TREE_ORDER_STATS 0x04 /* Keep subtree sizes in every node for Rank/Select */
+
+/* Batches at least 1/BATCH_REBUILD_RATIO of the tree's size are merged by rebuilding the tree */
+#define BATCH_REBUILD_RATIO 8
+
+/* Number of descents SearchBatch keeps in flight at once */
+#define SEARCH_BATCH_GROUP 16
+
+
+/* Hint that memory will be read soon, where the compiler supports it */
+#if defined(__GNUC__)
+#define PREFETCH(pAddress) __builtin_prefetch((pAddress), 0, 1)
+#else
+#define PREFETCH(pAddress) ((void)0)
+#endif
+
+
+/*
+ * Count an event in a tree's statistics. Statistics are compiled in only
+ * when TREE_STATS is defined (e.g. -DTREE_STATS), in which case every
+ * source file must be built with it; otherwise counting costs nothing.
+ */
+#ifdef TREE_STATS
+#define TREE_STAT(pTree, nCounter, nDelta) ((pTree)->sStats.nCounter += (nDelta))
+#else
+#define TREE_STAT(pTree, nCounter, nDelta) ((void)0)
+#endif
+
+
+/* Three way comparison of two values of a built-in type */
+#define COMPARE_VALUES(a, b) (((a) > (b)) - ((a) < (b)))
+
+/*
+ * Three way comparison of two keys of a tree. Integer keys are compared
+ * inline; only string and custom keys go through CompareKeys.
+ */
+#define COMPARE_KEYS(pTree, uLeft, uRight) \
+    (TREE_STAT((pTree), nComparisons, 1), \
+     (pTree)->nKeyType == KEY_INT ? COMPARE_VALUES((uLeft).nInt, (uRight).nInt) : \
+     (pTree)->nKeyType == KEY_INT64 ? COMPARE_VALUES((uLeft).llInt, (uRight).llInt) : \
+     CompareKeys((uLeft), (uRight), (pTree)))
+
+/* Inline per-node metadata requested by a tree variant, stored directly after the node */
+#define NODE_META(pNode) ((void *)((pNode) + 1))
+
+
+/* In-order links of a node in a TREE_THREADED tree, stored after its inline metadata */
+#define NODE_LINKS(pNode) ((THREADLINKS)((char *)(pNode) + (pNode)->pTree->nLinksOffset))
+
+/* Number of nodes in a node's subtree in a TREE_ORDER_STATS tree, stored after its links */
+#define NODE_COUNT(pNode) (*(int *)((char *)(pNode) + (pNode)->pTree->nCountOffset))
+
 
 /* Predeclarations */
 struct Tree;
 struct Node;
+struct Iterator;
+struct TraceWriter;
+
+
+/*
+ * Represents a key. Which member is used depends on the tree's key type.
+ * Strings and custom key data are referenced, not copied, so they must
+ * outlive their node just like the content payload.
+ */
+typedef union Key
+{
+    int nInt; /* KEY_INT */
+    long long llInt; /* KEY_INT64 */
+    const char *szString; /* KEY_STRING */
+    const void *pData; /* KEY_CUSTOM */
+} KEY;
 
 
 /* Definitions for callbacks that can be defined for the tree */
-/* Called after tree allocation, accepts the new tree and must return the tree's auxiliary object */
+/* Compares two KEY_CUSTOM keys, returning <0, 0 or >0 like strcmp */
+typedef int (*CompareCallback)(KEY uLeft, KEY uRight);
+/* Called after tree allocation, accepts the new tree and must return the tree's auxiliary object.
+ * It may also set the tree's nNodeMetaSize, or its pEngine and nNodeSize, before any node is allocated. */
 typedef void *(*AllocTreeCallback)(struct Tree *pTree);
 /* Called after node allocation, accepts the new node and must return the node's auxiliary object */
 typedef void *(*AllocNodeCallback)(struct Node *pNode);
+/* Called before a node's memory is released, to release the node's auxiliary object */
+typedef void (*FreeNodeCallback)(struct Node *pNode);
+/* Called before a tree's memory is released, to release the tree's auxiliary object */
+typedef void (*FreeTreeCallback)(struct Tree *pTree);
 /* Called after a successful insertion of the given node */
 typedef void (*InsertCallback)(struct Node *pNode);
+/* Called after a search, batch search or bound lookup finds the given node, which the callback may move with rotations */
+typedef void (*SearchCallback)(struct Node *pNode);
 /* Called after a successful removal of the given node, passing in the replacement node */
 typedef void (*RemoveCallback)(struct Node *pNode, unsigned char ucOriginal);
+/* Called before a node with at most one child is spliced out of the tree, while still linked */
+typedef void (*UnlinkCallback)(struct Node *pNode);
 /* Called after rotating on the given node */
 typedef void (*RotationCallback)(struct Node *pNode);
+/* Called on each node after its subtrees have been linked by a bulk build, passing the node's depth */
+typedef void (*BuildCallback)(struct Node *pNode, int nDepth);
 /* Called after debug printing a tree */
 typedef void (*DebugTreeCallback)(struct Tree *pTree);
 /* Called after debug printing a node */
 typedef void (*DebugNodeCallback)(struct Node *pNode);
 
 
+/*
+ * Represents an alternative storage engine replacing the tree's binary
+ * nodes. The basic, range and iterator operations of a tree with an engine
+ * are forwarded to it; the node callbacks above are never used. Iterators
+ * of an engine tree keep their position in pCursor/nSlot, with pCursor
+ * NULL once past the end.
+ */
+typedef struct TreeEngine
+{
+    /* Release everything the engine allocated for the tree */
+    void (*cbFree)(struct Tree *pTree);
+    /* Return the contents stored for a key, NULL if missing */
+    void *(*cbSearch)(KEY uKey, struct Tree *pTree);
+    /* Insert a key, returning FALSE if it already exists */
+    unsigned char (*cbInsert)(KEY uKey, void *pContent, struct Tree *pTree);
+    /* Remove a key, returning FALSE if it doesn't exist. Stores the contents it had
+     * in *ppContent if ppContent isn't NULL */
+    unsigned char (*cbRemove)(KEY uKey, struct Tree *pTree, void **ppContent);
+    /* Position an iterator at the first or last entry */
+    void (*cbSeekEnd)(struct Iterator *pIter, unsigned char ucDirection);
+    /* Position an iterator at the first entry not less than (or if ucStrict, greater than) a key */
+    void (*cbSeek)(struct Iterator *pIter, KEY uKey, unsigned char ucStrict);
+    /* Move an iterator to the next entry in the given direction */
+    void (*cbStep)(struct Iterator *pIter, unsigned char ucDirection);
+    /* Return the key and contents at an iterator's position */
+    void (*cbCurrent)(struct Iterator *pIter, KEY *pKey, void **ppContent);
+    /* Release any state held by an iterator in pState, may be NULL */
+    void (*cbDetach)(struct Iterator *pIter);
+    /* Return the address of a key's contents for updating in place, NULL if missing.
+     * May be NULL if the engine can't update entries in place */
+    void **(*cbSlot)(KEY uKey, struct Tree *pTree);
+    /* Fill an empty tree from nCount strictly ascending keys in linear time, returning FALSE on failure.
+     * May be NULL, the keys are then inserted one by one */
+    unsigned char (*cbBuild)(KEY *pKeys, void **ppContents, int nCount, struct Tree *pTree);
+    /* Insert a key, or replace its contents if it already exists, returning TRUE if it was inserted.
+     * May be NULL, cbSlot is then used instead */
+    unsigned char (*cbAssign)(KEY uKey, void *pContent, struct Tree *pTree);
+} *TREEENGINE;
+
 /* Represents a single, basic node of the tree */
 typedef struct Node
 {
@@ -47,24 +178,78 @@ typedef struct Node
     struct Node *pLeftChild;
     struct Node *pRightChild;
     struct Node *pParent;
-    int nKey;
+    KEY uKey;
     void *pContent; /* Content payload */
     void *pAuxiliary; /* Optional auxiliary data for the node */
+    /* Followed by pTree->nNodeMetaSize bytes of inline metadata, see NODE_META,
+     * then by the node's in-order links if the tree is threaded, see NODE_LINKS,
+     * and then by its subtree size if the tree keeps order statistics, see NODE_COUNT */
 } *NODE;
 
+/*
+ * Represents the statistics of a tree, see GetTreeStats. The counters are
+ * plain integers, so counts made by concurrent readers may be lost.
+ */
+typedef struct TreeStats
+{
+    long nSearches; /* Keys searched for */
+    long nInserts; /* Keys inserted, or attempted to be */
+    long nRemoves; /* Keys removed, or attempted to be */
+    long nComparisons; /* Key comparisons made */
+    long nDescents; /* Descents from the root towards a key */
+    long nNodesVisited; /* Nodes visited by those descents */
+    long nMaxDescent; /* Most nodes visited by a single descent */
+    long nRotations; /* Single rotations performed */
+    long nRetraces; /* Rebalancing callbacks run after inserts and removes */
+    long nRetraceSteps; /* Nodes visited by AVL rebalancing walks up the tree */
+    long nAllocations; /* Nodes allocated */
+    long nFrees; /* Nodes freed */
+    int nHeight; /* Current height, -1 if empty or unknown for an engine */
+    long nBytes; /* Bytes currently obtained for nodes */
+} *TREESTATS;
+
+/* Represents the in-order links of a node in a threaded tree */
+typedef struct ThreadLinks
+{
+    struct Node *pNext;
+    struct Node *pPrevious;
+} *THREADLINKS;
+
 /* Represents a single, basic tree */
 typedef struct Tree
 {
     NODE pRoot;
     NODE pFirst;
+    NODE pLast;
     int nSize;
     int nIterators; /* Number of current iterators attached */
+    int nFlags; /* Flags the tree was created with */
+    int nKeyType; /* One of the KEY_* types */
+    CompareCallback cbCompare; /* Comparison for KEY_CUSTOM keys */
     void *pAuxiliary; /* Optional auxiliary data for the tree */
+    size_t nNodeMetaSize; /* Bytes of inline metadata per node, may be set by cbAllocTree */
+    size_t nLinksOffset; /* Offset of the in-order links in each node, if threaded */
+    size_t nCountOffset; /* Offset of the subtree size in each node, if keeping order statistics */
+    size_t nNodeSize; /* Total bytes allocated per node, set by cbAllocTree for engine trees */
+    NODEPOOL pNodePool; /* Node pool, only used if TREE_POOLED */
+    struct AllocCounters sCounters; /* Node memory counters */
+    TREEENGINE pEngine; /* Alternative storage engine, NULL for binary nodes */
+#ifdef TREE_STATS
+    struct TreeStats sStats; /* Operation counters, see TREE_STAT */
+#endif
+#ifdef TREE_TRACE
+    struct TraceWriter *pTrace; /* Trace being recorded, see StartTrace */
+#endif
 
     AllocNodeCallback cbAllocNode;
+    FreeNodeCallback cbFreeNode;
+    FreeTreeCallback cbFreeTree;
     InsertCallback cbInsert;
     RemoveCallback cbRemove;
+    SearchCallback cbSearch;
+    UnlinkCallback cbUnlink;
     RotationCallback cbRotation;
+    BuildCallback cbBuild;
     DebugTreeCallback cbDebugTree;
     DebugNodeCallback cbDebugNode;
 } *TREE;
@@ -74,16 +259,37 @@ typedef struct Iterator
 {
     TREE pTree;
     NODE pNode;
+    NODE pEnd; /* Node at which iteration stops (exclusive), NULL for the end of the tree */
     unsigned char ucDirection;
+    void *pCursor; /* Engine position */
+    int nSlot; /* Engine position within pCursor */
+    void *pState; /* Engine state owned by the iterator, released by cbDetach */
+    KEY uEnd; /* Engine key at which iteration stops (exclusive), if ucBounded */
+    unsigned char ucBounded;
 } *ITERATOR;
 
 
 /* Memory management */
-TREE AllocTree(AllocTreeCallback cbAllocTree);
+TREE AllocTree(AllocTreeCallback cbAllocTree, int nFlags);
 unsigned char FreeTree(TREE pTree);
+void GetAllocCounters(TREE pTree, ALLOCCOUNTERS pCounters);
+unsigned char GetTreeStats(TREE pTree, TREESTATS pStats);
+void ResetTreeStats(TREE pTree);
 ITERATOR AllocIterator(void);
 void FreeIterator(ITERATOR pIter);
 
+/* Node memory management, for tree variants building nodes themselves */
+NODE AllocNode(TREE pTree);
+void FreeNode(NODE pNode);
+
+/* Keys */
+unsigned char SetKeyType(TREE pTree, int nKeyType, CompareCallback cbCompare);
+int CompareKeys(KEY uLeft, KEY uRight, TREE pTree);
+KEY IntKey(int nKey);
+KEY Int64Key(long long llKey);
+KEY StringKey(const char *szKey);
+KEY DataKey(const void *pKey);
+
 /* Small pieces of useful functionality */
 NODE Grandparent(NODE pNode);
 NODE Sibling(NODE pNode);
@@ -92,14 +298,34 @@ NODE RightRotation(NODE pNode);
 NODE LeftRotation(NODE pNode);
 
 /* Basic tree operations */
-void *Search(int nKey, TREE pTree);
-unsigned char Insert(int nKey, void *pContent, TREE pTree);
-unsigned char Remove(int nKey, TREE pTree);
+void *Search(KEY uKey, TREE pTree);
+unsigned char Insert(KEY uKey, void *pContent, TREE pTree);
+unsigned char InsertHint(ITERATOR pHint, KEY uKey, void *pContent, TREE pTree);
+unsigned char InsertOrAssign(KEY uKey, void *pContent, TREE pTree);
+void **FindOrInsert(KEY uKey, TREE pTree, unsigned char *pucInserted);
+unsigned char Remove(KEY uKey, TREE pTree);
+unsigned char RemoveAndGet(KEY uKey, TREE pTree, void **ppContent);
+int SearchBatch(KEY *pKeys, int nCount, void **ppResults, TREE pTree);
+
+/* Range operations */
+unsigned char LowerBound(KEY uKey, TREE pTree, KEY *pFoundKey, void **ppContent);
+unsigned char UpperBound(KEY uKey, TREE pTree, KEY *pFoundKey, void **ppContent);
+int CountRange(KEY uLow, KEY uHigh, TREE pTree);
+int Rank(KEY uKey, TREE pTree);
+unsigned char Select(int nRank, TREE pTree, KEY *pFoundKey, void **ppContent);
+
+/* Bulk operations */
+unsigned char BuildFromSorted(KEY *pKeys, void **ppContents, int nCount, TREE pTree);
+int InsertBatch(KEY *pKeys, void **ppContents, int nCount, unsigned char *pResults, TREE pTree);
+int RemoveBatch(KEY *pKeys, int nCount, unsigned char *pResults, TREE pTree);
 
 /* Iterator operations */
 void Attach(ITERATOR pIter, TREE pTree);
 void AttachEnd(ITERATOR pIter, TREE pTree);
+void AttachAt(ITERATOR pIter, TREE pTree, KEY uKey);
+void AttachRange(ITERATOR pIter, TREE pTree, KEY uLow, KEY uHigh);
 void *Current(ITERATOR pIter);
+KEY CurrentKey(ITERATOR pIter);
 void *Next(ITERATOR pIter);
 void Detach(ITERATOR pIter);
 
@@ -0,0 +1,652 @@
+#include <stdlib.h>
+
+#include "BinarySearchTree.h"
+#include "Compact.h"
+
+/* Child index and balance of a node */
+#define COMPACT_LEFT(pNode) ((pNode)->nLeft & COMPACT_INDEX_MASK)
+#define COMPACT_RIGHT(pNode) ((pNode)->nRight)
+#define COMPACT_BALANCE(pNode) ((int)((pNode)->nLeft >> COMPACT_BALANCE_SHIFT) - 1)
+
+/* Method predeclarations */
+/* Memory management */
+void *CompactAllocTreeAux(TREE pTree);
+void CompactFree(TREE pTree);
+unsigned int CompactAllocNode(TREE pTree);
+void CompactFreeNode(TREE pTree, unsigned int nNode);
+
+/* Links and balancing */
+void CompactSetLeft(COMPACTNODE pNode, unsigned int nChild);
+void CompactSetBalance(COMPACTNODE pNode, int nBalance);
+unsigned int CompactChild(COMPACTNODE pNode, int nSide);
+void CompactSetChild(COMPACTNODE pNode, int nSide, unsigned int nChild);
+void CompactReplace(TREE pTree, unsigned int *pnPath, int *pnSides, int nDepth, unsigned int nChild);
+unsigned int CompactRotate(COMPACTNODE pNodes, unsigned int nNode, int nSide, unsigned char *pucShorter);
+
+/* Basic tree operations */
+void *CompactSearch(KEY uKey, TREE pTree);
+void **CompactSlot(KEY uKey, TREE pTree);
+unsigned char CompactInsert(KEY uKey, void *pContent, TREE pTree);
+unsigned char CompactRemove(KEY uKey, TREE pTree, void **ppContent);
+unsigned char CompactBuild(KEY *pKeys, void **ppContents, int nCount, TREE pTree);
+unsigned int CompactBuildNodes(COMPACTNODE pNodes, unsigned int nFirst, int nCount, int *pnHeight);
+
+/* Iteration */
+COMPACTPATH CompactPathOf(ITERATOR pIter);
+void CompactDescend(ITERATOR pIter, unsigned int nNode, unsigned char ucDirection);
+void CompactSeekEnd(ITERATOR pIter, unsigned char ucDirection);
+void CompactSeek(ITERATOR pIter, KEY uKey, unsigned char ucStrict);
+void CompactStep(ITERATOR pIter, unsigned char ucDirection);
+void CompactCurrent(ITERATOR pIter, KEY *pKey, void **ppContent);
+void CompactDetach(ITERATOR pIter);
+
+/* Operations forwarded to by the core tree */
+static struct TreeEngine sCompactEngine =
+{
+    CompactFree,
+    CompactSearch,
+    CompactInsert,
+    CompactRemove,
+    CompactSeekEnd,
+    CompactSeek,
+    CompactStep,
+    CompactCurrent,
+    CompactDetach,
+    CompactSlot,
+    CompactBuild,
+    NULL
+};
+
+/*
+ * Allocate a tree whose nodes are stored in a single array. The array
+ * already pools its nodes, so none of the node flags apply.
+ */
+TREE CompactAllocTree(int nFlags)
+{
+    return AllocTree(CompactAllocTreeAux, nFlags & ~(TREE_POOLED | TREE_THREADED | TREE_ORDER_STATS));
+}
+
+/*
+ * Prepare a new compact tree, installing the engine. The node array is
+ * allocated by the first insertion.
+ */
+void *CompactAllocTreeAux(TREE pTree)
+{
+    COMPACTTREE pCompact;
+
+    pCompact = (COMPACTTREE)malloc(sizeof(*pCompact));
+    pCompact->pNodes = NULL;
+    pCompact->nCapacity = 0;
+    pCompact->nUsed = 1;
+    pCompact->nFree = 0;
+    pCompact->nRoot = 0;
+
+    pTree->pEngine = &sCompactEngine;
+    pTree->nNodeSize = sizeof(struct CompactNode);
+
+    return pCompact;
+}
+
+/*
+ * Free the node array along with the compact tree data.
+ */
+void CompactFree(TREE pTree)
+{
+    COMPACTTREE pCompact = COMPACT_DATA(pTree);
+
+    if (pCompact->pNodes != NULL)
+    {
+        CountedFree(pCompact->pNodes, pCompact->nCapacity * sizeof(struct CompactNode), &pTree->sCounters);
+    }
+    pTree->sCounters.nObjects = 0;
+
+    free(pCompact);
+    pTree->pAuxiliary = NULL;
+}
+
+/*
+ * Take a node from the free list, or the array, growing the array by
+ * half when it is full. Returns 0 if the tree can hold no more nodes.
+ * The array may move, so node pointers taken before must be refreshed.
+ */
+unsigned int CompactAllocNode(TREE pTree)
+{
+    COMPACTTREE pCompact = COMPACT_DATA(pTree);
+    COMPACTNODE pNodes;
+    unsigned int nNode, nCapacity;
+
+    if (pCompact->nFree != 0)
+    {
+        nNode = pCompact->nFree;
+        pCompact->nFree = pCompact->pNodes[nNode].nRight;
+    }
+    else
+    {
+        if (pCompact->nUsed >= pCompact->nCapacity)
+        {
+            if (pCompact->nCapacity > COMPACT_MAX_NODES)
+            {
+                return 0;
+            }
+            nCapacity = pCompact->nCapacity == 0 ? COMPACT_INITIAL_NODES : pCompact->nCapacity + pCompact->nCapacity / 2;
+            if (nCapacity > COMPACT_MAX_NODES + 1)
+            {
+                nCapacity = COMPACT_MAX_NODES + 1;
+            }
+            pNodes = (COMPACTNODE)CountedRealloc(pCompact->pNodes, pCompact->nCapacity * sizeof(struct CompactNode),
+                nCapacity * sizeof(struct CompactNode), &pTree->sCounters);
+            if (pNodes == NULL)
+            {
+                return 0;
+            }
+            pCompact->pNodes = pNodes;
+            pCompact->nCapacity = nCapacity;
+        }
+        nNode = pCompact->nUsed++;
+    }
+
+    TREE_STAT(pTree, nAllocations, 1);
+    pTree->sCounters.nObjects++;
+    if (pTree->sCounters.nObjects > pTree->sCounters.nPeakObjects)
+    {
+        pTree->sCounters.nPeakObjects = pTree->sCounters.nObjects;
+    }
+
+    pCompact->pNodes[nNode].nLeft = 1u << COMPACT_BALANCE_SHIFT;
+    pCompact->pNodes[nNode].nRight = 0;
+    return nNode;
+}
+
+/*
+ * Put a node on the free list. The array never shrinks.
+ */
+void CompactFreeNode(TREE pTree, unsigned int nNode)
+{
+    COMPACTTREE pCompact = COMPACT_DATA(pTree);
+
+    TREE_STAT(pTree, nFrees, 1);
+    pTree->sCounters.nObjects--;
+    pCompact->pNodes[nNode].nRight = pCompact->nFree;
+    pCompact->nFree = nNode;
+}
+
+/*
+ * Set a node's left child, keeping its balance.
+ */
+void CompactSetLeft(COMPACTNODE pNode, unsigned int nChild)
+{
+    pNode->nLeft = (pNode->nLeft & ~COMPACT_INDEX_MASK) | nChild;
+}
+
+/*
+ * Set a node's balance, -1, 0 or 1, keeping its left child.
+ */
+void CompactSetBalance(COMPACTNODE pNode, int nBalance)
+{
+    pNode->nLeft = COMPACT_LEFT(pNode) | ((unsigned int)(nBalance + 1) << COMPACT_BALANCE_SHIFT);
+}
+
+/*
+ * Return a node's left (nSide < 0) or right (nSide > 0) child.
+ */
+unsigned int CompactChild(COMPACTNODE pNode, int nSide)
+{
+    return nSide < 0 ? COMPACT_LEFT(pNode) : COMPACT_RIGHT(pNode);
+}
+
+/*
+ * Set a node's left (nSide < 0) or right (nSide > 0) child.
+ */
+void CompactSetChild(COMPACTNODE pNode, int nSide, unsigned int nChild)
+{
+    if (nSide < 0)
+    {
+        CompactSetLeft(pNode, nChild);
+    }
+    else
+    {
+        pNode->nRight = nChild;
+    }
+}
+
+/*
+ * Link a subtree in place of the node at pnPath[nDepth], under the node
+ * above it on the path, or as the root.
+ */
+void CompactReplace(TREE pTree, unsigned int *pnPath, int *pnSides, int nDepth, unsigned int nChild)
+{
+    COMPACTTREE pCompact = COMPACT_DATA(pTree);
+
+    if (nDepth == 0)
+    {
+        pCompact->nRoot = nChild;
+    }
+    else
+    {
+        CompactSetChild(&pCompact->pNodes[pnPath[nDepth - 1]], pnSides[nDepth - 1], nChild);
+    }
+}
+
+/*
+ * Rebalance a node whose nSide subtree is two levels higher than the
+ * other, returning the subtree's new root. *pucShorter is set to whether
+ * the subtree ended up lower than before the rotation.
+ */
+unsigned int CompactRotate(COMPACTNODE pNodes, unsigned int nNode, int nSide, unsigned char *pucShorter)
+{
+    COMPACTNODE pNode = &pNodes[nNode], pChild, pGrandchild;
+    unsigned int nChild = CompactChild(pNode, nSide), nGrandchild;
+    int nChildBalance, nGrandBalance;
+
+    pChild = &pNodes[nChild];
+    nChildBalance = COMPACT_BALANCE(pChild) * nSide;
+
+    if (nChildBalance >= 0) /* single rotation */
+    {
+        CompactSetChild(pNode, nSide, CompactChild(pChild, -nSide));
+        CompactSetChild(pChild, -nSide, nNode);
+        if (nChildBalance == 0) /* only after a removal */
+        {
+            CompactSetBalance(pNode, nSide);
+            CompactSetBalance(pChild, -nSide);
+            *pucShorter = FALSE;
+        }
+        else
+        {
+            CompactSetBalance(pNode, 0);
+            CompactSetBalance(pChild, 0);
+            *pucShorter = TRUE;
+        }
+        return nChild;
+    }
+
+    /* double rotation, the grandchild becoming the root */
+    nGrandchild = CompactChild(pChild, -nSide);
+    pGrandchild = &pNodes[nGrandchild];
+    nGrandBalance = COMPACT_BALANCE(pGrandchild) * nSide;
+    CompactSetChild(pChild, -nSide, CompactChild(pGrandchild, nSide));
+    CompactSetChild(pNode, nSide, CompactChild(pGrandchild, -nSide));
+    CompactSetChild(pGrandchild, nSide, nChild);
+    CompactSetChild(pGrandchild, -nSide, nNode);
+    CompactSetBalance(pNode, nGrandBalance > 0 ? -nSide : 0);
+    CompactSetBalance(pChild, nGrandBalance < 0 ? nSide : 0);
+    CompactSetBalance(pGrandchild, 0);
+    *pucShorter = TRUE;
+    return nGrandchild;
+}
+
+/*
+ * Return the contents stored for a key, NULL if missing.
+ */
+void *CompactSearch(KEY uKey, TREE pTree)
+{
+    void **ppSlot = CompactSlot(uKey, pTree);
+
+    return ppSlot != NULL ? *ppSlot : NULL;
+}
+
+/*
+ * Return the address of the contents stored for a key, NULL if missing.
+ */
+void **CompactSlot(KEY uKey, TREE pTree)
+{
+    COMPACTTREE pCompact = COMPACT_DATA(pTree);
+    COMPACTNODE pNode;
+    unsigned int nNode = pCompact->nRoot;
+    int nCompare;
+
+    while (nNode != 0)
+    {
+        pNode = &pCompact->pNodes[nNode];
+        nCompare = COMPARE_KEYS(pTree, uKey, pNode->uKey);
+        if (nCompare == 0)
+        {
+            return &pNode->pContent;
+        }
+        nNode = nCompare < 0 ? COMPACT_LEFT(pNode) : COMPACT_RIGHT(pNode);
+    }
+
+    return NULL;
+}
+
+/*
+ * Insert a key, then walk back up the recorded path updating balances
+ * until a subtree's height is unchanged or one rotation restores it.
+ * Returns FALSE if the key already exists, or the tree is full.
+ */
+unsigned char CompactInsert(KEY uKey, void *pContent, TREE pTree)
+{
+    COMPACTTREE pCompact = COMPACT_DATA(pTree);
+    COMPACTNODE pNode;
+    unsigned int nPath[COMPACT_MAX_DEPTH], nNode = pCompact->nRoot, nNew;
+    int nSides[COMPACT_MAX_DEPTH], nDepth = 0, nCompare, nBalance;
+    unsigned char ucShorter;
+
+    while (nNode != 0)
+    {
+        pNode = &pCompact->pNodes[nNode];
+        nCompare = COMPARE_KEYS(pTree, uKey, pNode->uKey);
+        if (nCompare == 0)
+        {
+            return FALSE;
+        }
+        nPath[nDepth] = nNode;
+        nSides[nDepth++] = nCompare < 0 ? -1 : 1;
+        nNode = CompactChild(pNode, nCompare);
+    }
+
+    nNew = CompactAllocNode(pTree);
+    if (nNew == 0)
+    {
+        return FALSE;
+    }
+    pCompact->pNodes[nNew].uKey = uKey;
+    pCompact->pNodes[nNew].pContent = pContent;
+    CompactReplace(pTree, nPath, nSides, nDepth, nNew);
+
+    while (nDepth-- > 0)
+    {
+        TREE_STAT(pTree, nRetraceSteps, 1);
+        pNode = &pCompact->pNodes[nPath[nDepth]];
+        nBalance = COMPACT_BALANCE(pNode) + nSides[nDepth];
+        if (nBalance == 0)
+        {
+            CompactSetBalance(pNode, 0);
+            break;
+        }
+        if (nBalance == 1 || nBalance == -1)
+        {
+            CompactSetBalance(pNode, nBalance);
+            continue;
+        }
+        TREE_STAT(pTree, nRotations, 1);
+        CompactReplace(pTree, nPath, nSides, nDepth,
+            CompactRotate(pCompact->pNodes, nPath[nDepth], nSides[nDepth], &ucShorter));
+        break;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Remove a key. A node with two children swaps entries with its
+ * successor, which is unlinked instead. Balances are then updated back
+ * up the recorded path until a subtree's height is unchanged.
+ * Returns FALSE if the key doesn't exist, otherwise stores the contents
+ * it had in *ppContent if ppContent isn't NULL.
+ */
+unsigned char CompactRemove(KEY uKey, TREE pTree, void **ppContent)
+{
+    COMPACTTREE pCompact = COMPACT_DATA(pTree);
+    COMPACTNODE pNode, pFound;
+    unsigned int nPath[COMPACT_MAX_DEPTH], nNode = pCompact->nRoot;
+    int nSides[COMPACT_MAX_DEPTH], nDepth = 0, nCompare = 1, nBalance;
+    unsigned char ucShorter;
+
+    while (nNode != 0)
+    {
+        pNode = &pCompact->pNodes[nNode];
+        nCompare = COMPARE_KEYS(pTree, uKey, pNode->uKey);
+        nPath[nDepth] = nNode;
+        if (nCompare == 0)
+        {
+            break;
+        }
+        nSides[nDepth++] = nCompare < 0 ? -1 : 1;
+        nNode = CompactChild(pNode, nCompare);
+    }
+    if (nNode == 0)
+    {
+        return FALSE;
+    }
+
+    pFound = &pCompact->pNodes[nNode];
+    if (ppContent != NULL)
+    {
+        *ppContent = pFound->pContent;
+    }
+    if (COMPACT_LEFT(pFound) != 0 && COMPACT_RIGHT(pFound) != 0)
+    {
+        nSides[nDepth++] = 1;
+        nNode = COMPACT_RIGHT(pFound);
+        while (COMPACT_LEFT(&pCompact->pNodes[nNode]) != 0)
+        {
+            nPath[nDepth] = nNode;
+            nSides[nDepth++] = -1;
+            nNode = COMPACT_LEFT(&pCompact->pNodes[nNode]);
+        }
+        nPath[nDepth] = nNode;
+        pFound->uKey = pCompact->pNodes[nNode].uKey;
+        pFound->pContent = pCompact->pNodes[nNode].pContent;
+    }
+
+    pNode = &pCompact->pNodes[nNode];
+    CompactReplace(pTree, nPath, nSides, nDepth, COMPACT_LEFT(pNode) != 0 ? COMPACT_LEFT(pNode) : COMPACT_RIGHT(pNode));
+    CompactFreeNode(pTree, nNode);
+
+    while (nDepth-- > 0)
+    {
+        TREE_STAT(pTree, nRetraceSteps, 1);
+        pNode = &pCompact->pNodes[nPath[nDepth]];
+        nBalance = COMPACT_BALANCE(pNode) - nSides[nDepth];
+        if (nBalance == 1 || nBalance == -1)
+        {
+            CompactSetBalance(pNode, nBalance);
+            break;
+        }
+        if (nBalance == 0)
+        {
+            CompactSetBalance(pNode, 0);
+            continue;
+        }
+        TREE_STAT(pTree, nRotations, 1);
+        CompactReplace(pTree, nPath, nSides, nDepth,
+            CompactRotate(pCompact->pNodes, nPath[nDepth], -nSides[nDepth], &ucShorter));
+        if (ucShorter == FALSE)
+        {
+            break;
+        }
+    }
+
+    return TRUE;
+}
+
+/*
+ * Fill an empty tree from ascending keys. The array is sized to hold
+ * exactly the keys, which take its slots in key order, and linked into
+ * a perfectly balanced tree. Returns FALSE if the keys don't fit.
+ */
+unsigned char CompactBuild(KEY *pKeys, void **ppContents, int nCount, TREE pTree)
+{
+    COMPACTTREE pCompact = COMPACT_DATA(pTree);
+    COMPACTNODE pNodes;
+    int i, nHeight;
+
+    if ((unsigned int)nCount > COMPACT_MAX_NODES)
+    {
+        return FALSE;
+    }
+    if (pCompact->nCapacity < (unsigned int)nCount + 1)
+    {
+        pNodes = (COMPACTNODE)CountedRealloc(pCompact->pNodes, pCompact->nCapacity * sizeof(struct CompactNode),
+            (nCount + 1) * sizeof(struct CompactNode), &pTree->sCounters);
+        if (pNodes == NULL)
+        {
+            return FALSE;
+        }
+        pCompact->pNodes = pNodes;
+        pCompact->nCapacity = nCount + 1;
+    }
+
+    /* The tree is empty, so every slot in use is on the free list and can be dropped */
+    pCompact->nFree = 0;
+    pCompact->nUsed = nCount + 1;
+    for (i = 0; i < nCount; i++)
+    {
+        pCompact->pNodes[i + 1].uKey = pKeys[i];
+        pCompact->pNodes[i + 1].pContent = (ppContents != NULL ? ppContents[i] : NULL);
+    }
+    pCompact->nRoot = CompactBuildNodes(pCompact->pNodes, 1, nCount, &nHeight);
+
+    TREE_STAT(pTree, nAllocations, nCount);
+    pTree->sCounters.nObjects = nCount;
+    if (pTree->sCounters.nObjects > pTree->sCounters.nPeakObjects)
+    {
+        pTree->sCounters.nPeakObjects = pTree->sCounters.nObjects;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Link the nCount nodes from index nFirst on, in key order, into a
+ * perfectly balanced subtree, returning its root and setting *pnHeight
+ * to its height.
+ */
+unsigned int CompactBuildNodes(COMPACTNODE pNodes, unsigned int nFirst, int nCount, int *pnHeight)
+{
+    unsigned int nNode;
+    int nMiddle = nCount / 2, nLeft, nRight;
+
+    if (nCount <= 0)
+    {
+        *pnHeight = 0;
+        return 0;
+    }
+
+    nNode = nFirst + nMiddle;
+    pNodes[nNode].nLeft = CompactBuildNodes(pNodes, nFirst, nMiddle, &nLeft);
+    pNodes[nNode].nRight = CompactBuildNodes(pNodes, nNode + 1, nCount - nMiddle - 1, &nRight);
+    CompactSetBalance(&pNodes[nNode], nRight - nLeft);
+    *pnHeight = (nLeft > nRight ? nLeft : nRight) + 1;
+
+    return nNode;
+}
+
+/*
+ * Return an iterator's path, allocating it on first use.
+ */
+COMPACTPATH CompactPathOf(ITERATOR pIter)
+{
+    if (pIter->pState == NULL)
+    {
+        pIter->pState = malloc(sizeof(struct CompactPath));
+    }
+    return (COMPACTPATH)pIter->pState;
+}
+
+/*
+ * Extend an iterator's path from a node down to the first (FORWARD) or
+ * last entry of its subtree, and position the iterator there.
+ */
+void CompactDescend(ITERATOR pIter, unsigned int nNode, unsigned char ucDirection)
+{
+    COMPACTTREE pCompact = COMPACT_DATA(pIter->pTree);
+    COMPACTPATH pPath = CompactPathOf(pIter);
+
+    while (nNode != 0)
+    {
+        pPath->nNodes[pPath->nDepth++] = nNode;
+        nNode = CompactChild(&pCompact->pNodes[nNode], ucDirection == FORWARD ? -1 : 1);
+    }
+    pIter->pCursor = pPath->nDepth > 0 ? &pCompact->pNodes[pPath->nNodes[pPath->nDepth - 1]] : NULL;
+}
+
+/*
+ * Position an iterator at the first or last entry.
+ */
+void CompactSeekEnd(ITERATOR pIter, unsigned char ucDirection)
+{
+    CompactPathOf(pIter)->nDepth = 0;
+    CompactDescend(pIter, COMPACT_DATA(pIter->pTree)->nRoot, ucDirection);
+}
+
+/*
+ * Position an iterator at the first entry not less than (or if
+ * ucStrict, greater than) a key, keeping the path down to it.
+ */
+void CompactSeek(ITERATOR pIter, KEY uKey, unsigned char ucStrict)
+{
+    COMPACTTREE pCompact = COMPACT_DATA(pIter->pTree);
+    COMPACTPATH pPath = CompactPathOf(pIter);
+    COMPACTNODE pNode;
+    unsigned int nNode = pCompact->nRoot;
+    int nCompare, nFound = 0;
+
+    pPath->nDepth = 0;
+    while (nNode != 0)
+    {
+        pNode = &pCompact->pNodes[nNode];
+        pPath->nNodes[pPath->nDepth++] = nNode;
+        nCompare = COMPARE_KEYS(pIter->pTree, pNode->uKey, uKey);
+        if (nCompare > 0 || (nCompare == 0 && !ucStrict))
+        {
+            nFound = pPath->nDepth;
+            nNode = COMPACT_LEFT(pNode);
+        }
+        else
+        {
+            nNode = COMPACT_RIGHT(pNode);
+        }
+    }
+
+    pPath->nDepth = nFound;
+    pIter->pCursor = nFound > 0 ? &pCompact->pNodes[pPath->nNodes[nFound - 1]] : NULL;
+}
+
+/*
+ * Move an iterator one entry in the given direction: down into the
+ * subtree on that side if there is one, otherwise back up the path to
+ * the first ancestor reached from the other side.
+ */
+void CompactStep(ITERATOR pIter, unsigned char ucDirection)
+{
+    COMPACTTREE pCompact = COMPACT_DATA(pIter->pTree);
+    COMPACTPATH pPath = CompactPathOf(pIter);
+    int nSide = ucDirection == FORWARD ? 1 : -1;
+    unsigned int nNode = pPath->nNodes[pPath->nDepth - 1], nChild;
+
+    nChild = CompactChild(&pCompact->pNodes[nNode], nSide);
+    if (nChild != 0)
+    {
+        CompactDescend(pIter, nChild, ucDirection);
+        return;
+    }
+
+    while (--pPath->nDepth > 0)
+    {
+        nChild = nNode;
+        nNode = pPath->nNodes[pPath->nDepth - 1];
+        if (CompactChild(&pCompact->pNodes[nNode], nSide) != nChild)
+        {
+            pIter->pCursor = &pCompact->pNodes[nNode];
+            return;
+        }
+    }
+    pIter->pCursor = NULL;
+}
+
+/*
+ * Return the key and contents at an iterator's position.
+ */
+void CompactCurrent(ITERATOR pIter, KEY *pKey, void **ppContent)
+{
+    COMPACTNODE pNode = (COMPACTNODE)pIter->pCursor;
+
+    if (pKey != NULL)
+    {
+        *pKey = pNode->uKey;
+    }
+    if (ppContent != NULL)
+    {
+        *ppContent = pNode->pContent;
+    }
+}
+
+/*
+ * Free an iterator's path.
+ */
+void CompactDetach(ITERATOR pIter)
+{
+    free(pIter->pState);
+}
\ No newline at end of file
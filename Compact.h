@@ -0,0 +1,66 @@
+/*
+ * Implementation of a compact AVL tree engine. Nodes live in one
+ * growable array and link to each other by 32-bit index, with no parent
+ * links or per-node tree pointer, so a node takes 24 bytes on 64-bit
+ * systems instead of the 56 of a basic tree node. Updates retrace along
+ * the path recorded on the way down, and iterators keep their own path.
+ * Any update may move the array, so iterators must not be stepped
+ * across updates.
+ *
+ * Adam Doyle
+ */
+
+#ifndef __COMPACT_H__
+#define __COMPACT_H__
+
+#include "BinarySearchTree.h"
+
+
+/* Indices use the low 30 bits of a link, the left link's top two bits hold the node's balance */
+#define COMPACT_INDEX_MASK 0x3fffffffu
+#define COMPACT_BALANCE_SHIFT 30
+
+/* Most nodes a compact tree can hold, index 0 meaning no node */
+#define COMPACT_MAX_NODES COMPACT_INDEX_MASK
+
+/* Longest root to leaf path, above the 1.44 log2(n) bound of an AVL tree */
+#define COMPACT_MAX_DEPTH 48
+
+/* Number of nodes the array starts with */
+#define COMPACT_INITIAL_NODES 64
+
+
+/* Represents a node, addressed by its index in the tree's array */
+typedef struct CompactNode
+{
+    KEY uKey;
+    void *pContent;
+    unsigned int nLeft; /* Left child index, and the balance (right minus left height) plus one in the top bits */
+    unsigned int nRight; /* Right child index, or the next free node's index once freed */
+} *COMPACTNODE;
+
+/* Represents the node array of a compact tree, stored as the tree's auxiliary object */
+typedef struct CompactTree
+{
+    COMPACTNODE pNodes; /* Node array, slot 0 is never used */
+    unsigned int nCapacity; /* Slots in the array */
+    unsigned int nUsed; /* Slots handed out so far, including freed ones */
+    unsigned int nFree; /* First freed slot, 0 if none */
+    unsigned int nRoot;
+} *COMPACTTREE;
+
+/* Represents the path from the root to an iterator's position, kept in its pState */
+typedef struct CompactPath
+{
+    int nDepth;
+    unsigned int nNodes[COMPACT_MAX_DEPTH];
+} *COMPACTPATH;
+
+/* Access the node array of a compact tree */
+#define COMPACT_DATA(pTree) ((COMPACTTREE)(pTree)->pAuxiliary)
+
+
+/* Allocate compact tree, TREE_POOLED, TREE_THREADED and TREE_ORDER_STATS are ignored */
+TREE CompactAllocTree(int nFlags);
+
+#endif /* __COMPACT_H__ */
\ No newline at end of file
@@ -0,0 +1,791 @@
+#include <stdlib.h>
+
+#include "BinarySearchTree.h"
+#include "Concurrent.h"
+
+/* Kinds of node a reader's descent can look for */
+#define FIND_EQUAL 0 /* The node holding the key */
+#define FIND_FIRST 1 /* The first node */
+#define FIND_LAST 2 /* The last node */
+#define FIND_CEILING 3 /* The first node not less than the key */
+#define FIND_ABOVE 4 /* The first node greater than the key */
+#define FIND_BELOW 5 /* The last node less than the key */
+
+/* Loads and stores of fields shared between the writer and lock-free readers */
+#define ATOMIC_LOAD(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define ATOMIC_STORE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+
+/* Method predeclarations */
+/* Memory management */
+void *ConcurrentAllocTreeAux(TREE pTree);
+void ConcurrentFree(TREE pTree);
+void ConcurrentFreeNodes(CONCURRENTNODE pNode, TREE pTree);
+CONCURRENTNODE ConcurrentAllocNode(KEY uKey, void *pContent, TREE pTree);
+void ConcurrentFreeNode(CONCURRENTNODE pNode, TREE pTree);
+void ConcurrentRetire(CONCURRENTNODE pNode, TREE pTree);
+void ConcurrentReclaim(TREE pTree);
+
+/* Readers */
+READERSLOT ConcurrentEnter(TREE pTree);
+void ConcurrentLeave(READERSLOT pSlot);
+unsigned long ConcurrentStable(CONCURRENTNODE pNode);
+unsigned char ConcurrentTryFind(KEY uKey, int nMode, TREE pTree, CONCURRENTNODE *ppFound);
+CONCURRENTNODE ConcurrentFind(KEY uKey, int nMode, TREE pTree);
+
+/* Writers */
+void ConcurrentBegin(CONCURRENTNODE pNode);
+void ConcurrentEnd(CONCURRENTNODE pNode);
+CONCURRENTNODE *ConcurrentLink(CONCURRENTNODE pParent, CONCURRENTNODE pNode);
+short int ConcurrentHeight(CONCURRENTNODE pNode);
+void ConcurrentSetHeight(CONCURRENTNODE pNode);
+CONCURRENTNODE ConcurrentRotateLeft(CONCURRENTNODE pParent, CONCURRENTNODE pNode);
+CONCURRENTNODE ConcurrentRotateRight(CONCURRENTNODE pParent, CONCURRENTNODE pNode);
+void ConcurrentRebalance(CONCURRENTNODE pParent, CONCURRENTNODE pNode);
+void ConcurrentRetrace(CONCURRENTNODE *ppPath, int nDepth);
+
+/* Engine operations */
+void *ConcurrentSearch(KEY uKey, TREE pTree);
+unsigned char ConcurrentInsertNode(KEY uKey, void *pContent, TREE pTree);
+unsigned char ConcurrentRemoveNode(KEY uKey, TREE pTree, void **ppContent);
+void ConcurrentSeekEnd(ITERATOR pIter, unsigned char ucDirection);
+void ConcurrentSeek(ITERATOR pIter, KEY uKey, unsigned char ucStrict);
+void ConcurrentStep(ITERATOR pIter, unsigned char ucDirection);
+void ConcurrentCurrent(ITERATOR pIter, KEY *pKey, void **ppContent);
+void ConcurrentDetachEngine(ITERATOR pIter);
+
+/* Operations forwarded to by the core tree */
+static struct TreeEngine sConcurrentEngine =
+{
+    ConcurrentFree,
+    ConcurrentSearch,
+    ConcurrentInsertNode,
+    ConcurrentRemoveNode,
+    ConcurrentSeekEnd,
+    ConcurrentSeek,
+    ConcurrentStep,
+    ConcurrentCurrent,
+    ConcurrentDetachEngine,
+    NULL,
+    NULL,
+    NULL
+};
+
+/*
+ * Allocate a tree that lock-free readers can search and
+ * iterate while a writer updates it.
+ */
+TREE ConcurrentAllocTree(int nFlags)
+{
+    return AllocTree(ConcurrentAllocTreeAux, nFlags & ~(TREE_THREADED | TREE_ORDER_STATS));
+}
+
+/*
+ * Prepare a new concurrent tree, installing the engine and
+ * sizing the tree's pool for concurrent nodes.
+ */
+void *ConcurrentAllocTreeAux(TREE pTree)
+{
+    CONCURRENTTREE pData;
+    int i;
+
+    pData = (CONCURRENTTREE)malloc(sizeof(*pData));
+    for (i = 0; i < CONCURRENT_READER_SLOTS; i++)
+    {
+        pData->sSlots[i].nEpoch = 0;
+    }
+    pData->sHolder.pLeftChild = NULL;
+    pData->sHolder.pRightChild = NULL;
+    pData->sHolder.nVersion = 0;
+    pData->sHolder.nHeight = 0;
+    pData->nEpoch = 1;
+    pData->pRetired = NULL;
+    pData->nRetired = 0;
+    pthread_mutex_init(&pData->sWriteLock, NULL);
+    pthread_mutex_init(&pData->sAttachLock, NULL);
+
+    pTree->pEngine = &sConcurrentEngine;
+    pTree->nNodeSize = sizeof(struct ConcurrentNode);
+
+    return pData;
+}
+
+/*
+ * Free every node, including those waiting for readers to leave,
+ * unless the tree's pool releases them in bulk.
+ */
+void ConcurrentFree(TREE pTree)
+{
+    CONCURRENTTREE pData = CONCURRENT_DATA(pTree);
+    CONCURRENTNODE pNode;
+
+    if (pTree->pNodePool == NULL)
+    {
+        ConcurrentFreeNodes(pData->sHolder.pRightChild, pTree);
+        while (pData->pRetired != NULL)
+        {
+            pNode = pData->pRetired;
+            pData->pRetired = pNode->pRetired;
+            ConcurrentFreeNode(pNode, pTree);
+        }
+    }
+
+    pthread_mutex_destroy(&pData->sWriteLock);
+    pthread_mutex_destroy(&pData->sAttachLock);
+    free(pData);
+    pTree->pAuxiliary = NULL;
+}
+
+/*
+ * Free a node and everything below it.
+ */
+void ConcurrentFreeNodes(CONCURRENTNODE pNode, TREE pTree)
+{
+    if (pNode != NULL)
+    {
+        ConcurrentFreeNodes(pNode->pLeftChild, pTree);
+        ConcurrentFreeNodes(pNode->pRightChild, pTree);
+        ConcurrentFreeNode(pNode, pTree);
+    }
+}
+
+/*
+ * Allocate a leaf node from the tree's pool if it has one.
+ */
+CONCURRENTNODE ConcurrentAllocNode(KEY uKey, void *pContent, TREE pTree)
+{
+    CONCURRENTNODE pNode;
+
+    if (pTree->pNodePool != NULL)
+    {
+        pNode = (CONCURRENTNODE)PoolAlloc(pTree->pNodePool);
+    }
+    else
+    {
+        pNode = (CONCURRENTNODE)CountedMalloc(pTree->nNodeSize, &pTree->sCounters);
+    }
+    pNode->pLeftChild = NULL;
+    pNode->pRightChild = NULL;
+    pNode->uKey = uKey;
+    pNode->pContent = pContent;
+    pNode->nVersion = 0;
+    pNode->nHeight = 1;
+    pNode->pRetired = NULL;
+    pNode->nRetiredEpoch = 0;
+
+    return pNode;
+}
+
+/*
+ * Free a node's memory, returning it to the tree's pool if
+ * it has one.
+ */
+void ConcurrentFreeNode(CONCURRENTNODE pNode, TREE pTree)
+{
+    if (pTree->pNodePool != NULL)
+    {
+        PoolFree(pTree->pNodePool, pNode);
+    }
+    else
+    {
+        CountedFree(pNode, pTree->nNodeSize, &pTree->sCounters);
+    }
+}
+
+/*
+ * Queue an unlinked node to be freed once every reader that
+ * might have reached it has left.
+ */
+void ConcurrentRetire(CONCURRENTNODE pNode, TREE pTree)
+{
+    CONCURRENTTREE pData = CONCURRENT_DATA(pTree);
+
+    pNode->nRetiredEpoch = ATOMIC_LOAD(pData->nEpoch);
+    pNode->pRetired = pData->pRetired;
+    pData->pRetired = pNode;
+    if (++pData->nRetired >= CONCURRENT_RECLAIM_BATCH)
+    {
+        ConcurrentReclaim(pTree);
+    }
+}
+
+/*
+ * Start a new epoch and free every queued node retired before the
+ * oldest epoch a reader is still in. Readers entering from now on
+ * can't reach those nodes, they were unlinked before the epoch moved.
+ */
+void ConcurrentReclaim(TREE pTree)
+{
+    CONCURRENTTREE pData = CONCURRENT_DATA(pTree);
+    CONCURRENTNODE pNode, *ppLink;
+    unsigned long nOldest, nEpoch;
+    int i;
+
+    nOldest = __atomic_add_fetch(&pData->nEpoch, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    for (i = 0; i < CONCURRENT_READER_SLOTS; i++)
+    {
+        nEpoch = __atomic_load_n(&pData->sSlots[i].nEpoch, __ATOMIC_SEQ_CST);
+        if (nEpoch != 0 && nEpoch < nOldest)
+        {
+            nOldest = nEpoch;
+        }
+    }
+
+    ppLink = &pData->pRetired;
+    while (*ppLink != NULL)
+    {
+        pNode = *ppLink;
+        if (pNode->nRetiredEpoch < nOldest)
+        {
+            *ppLink = pNode->pRetired;
+            ConcurrentFreeNode(pNode, pTree);
+            pData->nRetired--;
+        }
+        else
+        {
+            ppLink = &pNode->pRetired;
+        }
+    }
+}
+
+/*
+ * Claim a reader slot, announcing the epoch the reader entered in.
+ * Threads run on separate stacks, so a local's address spreads
+ * them over different slots to start from.
+ */
+READERSLOT ConcurrentEnter(TREE pTree)
+{
+    CONCURRENTTREE pData = CONCURRENT_DATA(pTree);
+    unsigned long nFree, nEpoch;
+    int nSlot;
+
+    nSlot = (int)(((size_t)&nSlot >> 12) % CONCURRENT_READER_SLOTS);
+    while (TRUE)
+    {
+        nFree = 0;
+        nEpoch = __atomic_load_n(&pData->nEpoch, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&pData->sSlots[nSlot].nEpoch, __ATOMIC_RELAXED) == 0 &&
+            __atomic_compare_exchange_n(&pData->sSlots[nSlot].nEpoch, &nFree, nEpoch, FALSE, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        {
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            return &pData->sSlots[nSlot];
+        }
+        nSlot = (nSlot + 1) % CONCURRENT_READER_SLOTS;
+    }
+}
+
+/*
+ * Release a reader slot once the reader holds no more nodes.
+ */
+void ConcurrentLeave(READERSLOT pSlot)
+{
+    __atomic_store_n(&pSlot->nEpoch, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Return a node's version once no writer is changing it.
+ */
+unsigned long ConcurrentStable(CONCURRENTNODE pNode)
+{
+    unsigned long nVersion;
+
+    while ((nVersion = ATOMIC_LOAD(pNode->nVersion)) & 1)
+    {
+        /* A writer is mid-change, it only holds nodes odd for a few stores */
+    }
+
+    return nVersion;
+}
+
+/*
+ * Descend once looking for the kind of node nMode describes. Before
+ * stepping into a child, the parent's version is checked again after
+ * reading both the link and the child's version, so the child was still
+ * attached and covering the key when its version was taken. Returns
+ * FALSE if a writer got in the way and the descent must restart.
+ */
+unsigned char ConcurrentTryFind(KEY uKey, int nMode, TREE pTree, CONCURRENTNODE *ppFound)
+{
+    CONCURRENTNODE pNode = &CONCURRENT_DATA(pTree)->sHolder, pChild;
+    unsigned long nVersion = ConcurrentStable(pNode), nChildVersion;
+    unsigned char ucRight = TRUE;
+    int nCompare;
+
+    *ppFound = NULL;
+    while (TRUE)
+    {
+        pChild = (ucRight ? ATOMIC_LOAD(pNode->pRightChild) : ATOMIC_LOAD(pNode->pLeftChild));
+        if (ATOMIC_LOAD(pNode->nVersion) != nVersion)
+        {
+            return FALSE;
+        }
+        if (pChild == NULL)
+        {
+            return TRUE;
+        }
+        nChildVersion = ConcurrentStable(pChild);
+        if (ATOMIC_LOAD(pNode->nVersion) != nVersion)
+        {
+            return FALSE;
+        }
+
+        switch (nMode)
+        {
+        case FIND_FIRST:
+            *ppFound = pChild;
+            ucRight = FALSE;
+            break;
+        case FIND_LAST:
+            *ppFound = pChild;
+            ucRight = TRUE;
+            break;
+        case FIND_EQUAL:
+            nCompare = COMPARE_KEYS(pTree, pChild->uKey, uKey);
+            if (nCompare == 0)
+            {
+                *ppFound = pChild;
+                return TRUE;
+            }
+            ucRight = (nCompare < 0);
+            break;
+        case FIND_BELOW:
+            nCompare = COMPARE_KEYS(pTree, pChild->uKey, uKey);
+            if (nCompare < 0)
+            {
+                *ppFound = pChild;
+            }
+            ucRight = (nCompare < 0);
+            break;
+        default:
+            nCompare = COMPARE_KEYS(pTree, pChild->uKey, uKey);
+            if (nCompare > 0 || (nCompare == 0 && nMode == FIND_CEILING))
+            {
+                *ppFound = pChild;
+                ucRight = FALSE;
+            }
+            else
+            {
+                ucRight = TRUE;
+            }
+            break;
+        }
+
+        pNode = pChild;
+        nVersion = nChildVersion;
+    }
+}
+
+/*
+ * Return the kind of node nMode describes, NULL if there is none,
+ * retrying the descent until it isn't disturbed by a writer. The
+ * caller must hold a reader slot for as long as it uses the node.
+ */
+CONCURRENTNODE ConcurrentFind(KEY uKey, int nMode, TREE pTree)
+{
+    CONCURRENTNODE pFound;
+
+    while (!ConcurrentTryFind(uKey, nMode, pTree, &pFound))
+    {
+    }
+
+    return pFound;
+}
+
+/*
+ * Return the contents stored for a key, NULL if missing,
+ * without taking any lock.
+ */
+void *ConcurrentSearch(KEY uKey, TREE pTree)
+{
+    READERSLOT pSlot = ConcurrentEnter(pTree);
+    CONCURRENTNODE pNode = ConcurrentFind(uKey, FIND_EQUAL, pTree);
+    void *pContent = (pNode != NULL ? pNode->pContent : NULL);
+
+    ConcurrentLeave(pSlot);
+    return pContent;
+}
+
+/*
+ * Mark a node as being changed, readers holding its old version
+ * will retry.
+ */
+void ConcurrentBegin(CONCURRENTNODE pNode)
+{
+    __atomic_store_n(&pNode->nVersion, pNode->nVersion + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/*
+ * Publish the changes made to a node since ConcurrentBegin.
+ */
+void ConcurrentEnd(CONCURRENTNODE pNode)
+{
+    ATOMIC_STORE(pNode->nVersion, pNode->nVersion + 1);
+}
+
+/*
+ * Return the link of a parent pointing at one of its children.
+ */
+CONCURRENTNODE *ConcurrentLink(CONCURRENTNODE pParent, CONCURRENTNODE pNode)
+{
+    return (pParent->pLeftChild == pNode ? &pParent->pLeftChild : &pParent->pRightChild);
+}
+
+/*
+ * Return the height of a node, 0 for NULL.
+ */
+short int ConcurrentHeight(CONCURRENTNODE pNode)
+{
+    return pNode != NULL ? pNode->nHeight : 0;
+}
+
+/*
+ * Recalculate a node's height from its children.
+ */
+void ConcurrentSetHeight(CONCURRENTNODE pNode)
+{
+    short int nLeft = ConcurrentHeight(pNode->pLeftChild), nRight = ConcurrentHeight(pNode->pRightChild);
+
+    pNode->nHeight = (nLeft > nRight ? nLeft : nRight) + 1;
+}
+
+/*
+ * Rotate left on a node, bumping the version of every node whose
+ * links change. Returns the node that took its place.
+ */
+CONCURRENTNODE ConcurrentRotateLeft(CONCURRENTNODE pParent, CONCURRENTNODE pNode)
+{
+    CONCURRENTNODE pRight = pNode->pRightChild, *ppLink = ConcurrentLink(pParent, pNode);
+
+    ConcurrentBegin(pParent);
+    ConcurrentBegin(pNode);
+    ConcurrentBegin(pRight);
+    ATOMIC_STORE(pNode->pRightChild, pRight->pLeftChild);
+    ATOMIC_STORE(pRight->pLeftChild, pNode);
+    ATOMIC_STORE(*ppLink, pRight);
+    ConcurrentSetHeight(pNode);
+    ConcurrentSetHeight(pRight);
+    ConcurrentEnd(pRight);
+    ConcurrentEnd(pNode);
+    ConcurrentEnd(pParent);
+
+    return pRight;
+}
+
+/*
+ * Rotate right on a node, bumping the version of every node whose
+ * links change. Returns the node that took its place.
+ */
+CONCURRENTNODE ConcurrentRotateRight(CONCURRENTNODE pParent, CONCURRENTNODE pNode)
+{
+    CONCURRENTNODE pLeft = pNode->pLeftChild, *ppLink = ConcurrentLink(pParent, pNode);
+
+    ConcurrentBegin(pParent);
+    ConcurrentBegin(pNode);
+    ConcurrentBegin(pLeft);
+    ATOMIC_STORE(pNode->pLeftChild, pLeft->pRightChild);
+    ATOMIC_STORE(pLeft->pRightChild, pNode);
+    ATOMIC_STORE(*ppLink, pLeft);
+    ConcurrentSetHeight(pNode);
+    ConcurrentSetHeight(pLeft);
+    ConcurrentEnd(pLeft);
+    ConcurrentEnd(pNode);
+    ConcurrentEnd(pParent);
+
+    return pLeft;
+}
+
+/*
+ * Update a node's height and rotate it back into AVL balance if
+ * its subtrees' heights differ by two.
+ */
+void ConcurrentRebalance(CONCURRENTNODE pParent, CONCURRENTNODE pNode)
+{
+    int nBalance;
+
+    ConcurrentSetHeight(pNode);
+    nBalance = ConcurrentHeight(pNode->pLeftChild) - ConcurrentHeight(pNode->pRightChild);
+    if (nBalance > 1)
+    {
+        if (ConcurrentHeight(pNode->pLeftChild->pLeftChild) < ConcurrentHeight(pNode->pLeftChild->pRightChild))
+        {
+            ConcurrentRotateLeft(pNode, pNode->pLeftChild);
+        }
+        ConcurrentRotateRight(pParent, pNode);
+    }
+    else if (nBalance < -1)
+    {
+        if (ConcurrentHeight(pNode->pRightChild->pRightChild) < ConcurrentHeight(pNode->pRightChild->pLeftChild))
+        {
+            ConcurrentRotateRight(pNode, pNode->pRightChild);
+        }
+        ConcurrentRotateLeft(pParent, pNode);
+    }
+}
+
+/*
+ * Rebalance every node on a path from the deepest one up to the
+ * root. ppPath[0] is the holder.
+ */
+void ConcurrentRetrace(CONCURRENTNODE *ppPath, int nDepth)
+{
+    int i;
+
+    for (i = nDepth; i >= 1; i--)
+    {
+        ConcurrentRebalance(ppPath[i - 1], ppPath[i]);
+    }
+}
+
+/*
+ * Insert a key, publishing the new leaf with a single link store.
+ * Called with the write lock held. Returns FALSE if the key already
+ * exists.
+ */
+unsigned char ConcurrentInsertNode(KEY uKey, void *pContent, TREE pTree)
+{
+    CONCURRENTNODE ppPath[CONCURRENT_MAX_HEIGHT + 1], pNode, pParent;
+    int nDepth = 0, nCompare = 1;
+
+    ppPath[0] = &CONCURRENT_DATA(pTree)->sHolder;
+    pNode = ppPath[0]->pRightChild;
+    while (pNode != NULL)
+    {
+        ppPath[++nDepth] = pNode;
+        nCompare = COMPARE_KEYS(pTree, uKey, pNode->uKey);
+        if (nCompare == 0)
+        {
+            return FALSE;
+        }
+        pNode = (nCompare < 0 ? pNode->pLeftChild : pNode->pRightChild);
+    }
+
+    pNode = ConcurrentAllocNode(uKey, pContent, pTree);
+    pParent = ppPath[nDepth];
+    ConcurrentBegin(pParent);
+    if (nCompare < 0)
+    {
+        ATOMIC_STORE(pParent->pLeftChild, pNode);
+    }
+    else
+    {
+        ATOMIC_STORE(pParent->pRightChild, pNode);
+    }
+    ConcurrentEnd(pParent);
+
+    ConcurrentRetrace(ppPath, nDepth);
+    return TRUE;
+}
+
+/*
+ * Remove a key, moving its successor into its place if it has two
+ * children, and retire its node. Called with the write lock held.
+ * Returns FALSE if the key doesn't exist, otherwise stores the contents
+ * it had in *ppContent if ppContent isn't NULL.
+ */
+unsigned char ConcurrentRemoveNode(KEY uKey, TREE pTree, void **ppContent)
+{
+    CONCURRENTNODE ppPath[CONCURRENT_MAX_HEIGHT + 1], pNode, pParent, pSuccessor, pSuccessorParent, *ppLink;
+    int nDepth = 0, nRetrace, nCompare, i;
+
+    ppPath[0] = &CONCURRENT_DATA(pTree)->sHolder;
+    pNode = ppPath[0]->pRightChild;
+    while (pNode != NULL)
+    {
+        ppPath[++nDepth] = pNode;
+        nCompare = COMPARE_KEYS(pTree, uKey, pNode->uKey);
+        if (nCompare == 0)
+        {
+            break;
+        }
+        pNode = (nCompare < 0 ? pNode->pLeftChild : pNode->pRightChild);
+    }
+    if (pNode == NULL)
+    {
+        return FALSE;
+    }
+    if (ppContent != NULL)
+    {
+        *ppContent = pNode->pContent;
+    }
+
+    pParent = ppPath[nDepth - 1];
+    ppLink = ConcurrentLink(pParent, pNode);
+    if (pNode->pLeftChild == NULL || pNode->pRightChild == NULL)
+    {
+        ConcurrentBegin(pParent);
+        ConcurrentBegin(pNode);
+        ATOMIC_STORE(*ppLink, (pNode->pLeftChild != NULL ? pNode->pLeftChild : pNode->pRightChild));
+        ConcurrentEnd(pNode);
+        ConcurrentEnd(pParent);
+        nRetrace = nDepth - 1;
+    }
+    else
+    {
+        /* Find the successor, extending the path down to it */
+        nRetrace = nDepth;
+        pSuccessor = pNode->pRightChild;
+        while (pSuccessor->pLeftChild != NULL)
+        {
+            ppPath[++nRetrace] = pSuccessor;
+            pSuccessor = pSuccessor->pLeftChild;
+        }
+        pSuccessorParent = ppPath[nRetrace];
+
+        /*
+         * The successor's key leaves every subtree on the path down to
+         * it, so each node on the path is changed, not only those whose
+         * links move. A reader already past pNode would otherwise carry
+         * on to where the successor was and miss its key.
+         */
+        ConcurrentBegin(pParent);
+        for (i = nDepth; i <= nRetrace; i++)
+        {
+            ConcurrentBegin(ppPath[i]);
+        }
+        ConcurrentBegin(pSuccessor);
+        if (pSuccessorParent != pNode)
+        {
+            ATOMIC_STORE(pSuccessorParent->pLeftChild, pSuccessor->pRightChild);
+            ATOMIC_STORE(pSuccessor->pRightChild, pNode->pRightChild);
+        }
+        ATOMIC_STORE(pSuccessor->pLeftChild, pNode->pLeftChild);
+        ATOMIC_STORE(*ppLink, pSuccessor);
+        ConcurrentEnd(pSuccessor);
+        for (i = nRetrace; i >= nDepth; i--)
+        {
+            ConcurrentEnd(ppPath[i]);
+        }
+        ConcurrentEnd(pParent);
+
+        ppPath[nDepth] = pSuccessor;
+    }
+
+    ConcurrentRetire(pNode, pTree);
+    ConcurrentRetrace(ppPath, nRetrace);
+    return TRUE;
+}
+
+/*
+ * Position an iterator at the first or last entry, entering the
+ * tree as a reader until the iterator is detached.
+ */
+void ConcurrentSeekEnd(ITERATOR pIter, unsigned char ucDirection)
+{
+    KEY uKey;
+
+    if (pIter->pState == NULL)
+    {
+        pIter->pState = ConcurrentEnter(pIter->pTree);
+    }
+    uKey.llInt = 0;
+    pIter->pCursor = ConcurrentFind(uKey, (ucDirection == FORWARD ? FIND_FIRST : FIND_LAST), pIter->pTree);
+}
+
+/*
+ * Position an iterator at the first entry not less than (or if
+ * ucStrict, greater than) a key.
+ */
+void ConcurrentSeek(ITERATOR pIter, KEY uKey, unsigned char ucStrict)
+{
+    if (pIter->pState == NULL)
+    {
+        pIter->pState = ConcurrentEnter(pIter->pTree);
+    }
+    pIter->pCursor = ConcurrentFind(uKey, (ucStrict ? FIND_ABOVE : FIND_CEILING), pIter->pTree);
+}
+
+/*
+ * Move an iterator one entry in the given direction by searching for
+ * the neighbour of its current key, which works even if the current
+ * node has been removed in the meantime.
+ */
+void ConcurrentStep(ITERATOR pIter, unsigned char ucDirection)
+{
+    KEY uKey = ((CONCURRENTNODE)pIter->pCursor)->uKey;
+
+    pIter->pCursor = ConcurrentFind(uKey, (ucDirection == FORWARD ? FIND_ABOVE : FIND_BELOW), pIter->pTree);
+}
+
+/*
+ * Return the key and contents at an iterator's position.
+ */
+void ConcurrentCurrent(ITERATOR pIter, KEY *pKey, void **ppContent)
+{
+    CONCURRENTNODE pNode = (CONCURRENTNODE)pIter->pCursor;
+
+    if (pKey != NULL)
+    {
+        *pKey = pNode->uKey;
+    }
+    if (ppContent != NULL)
+    {
+        *ppContent = pNode->pContent;
+    }
+}
+
+/*
+ * Leave the tree as a reader once an iterator is detached.
+ */
+void ConcurrentDetachEngine(ITERATOR pIter)
+{
+    if (pIter->pState != NULL)
+    {
+        ConcurrentLeave((READERSLOT)pIter->pState);
+    }
+}
+
+/*
+ * Insert a key from any thread, waiting for other writers.
+ */
+unsigned char ConcurrentInsert(KEY uKey, void *pContent, TREE pTree)
+{
+    CONCURRENTTREE pData = CONCURRENT_DATA(pTree);
+    unsigned char ucResponse;
+
+    pthread_mutex_lock(&pData->sWriteLock);
+    ucResponse = Insert(uKey, pContent, pTree);
+    pthread_mutex_unlock(&pData->sWriteLock);
+
+    return ucResponse;
+}
+
+/*
+ * Remove a key from any thread, waiting for other writers.
+ */
+unsigned char ConcurrentRemove(KEY uKey, TREE pTree)
+{
+    CONCURRENTTREE pData = CONCURRENT_DATA(pTree);
+    unsigned char ucResponse;
+
+    pthread_mutex_lock(&pData->sWriteLock);
+    ucResponse = Remove(uKey, pTree);
+    pthread_mutex_unlock(&pData->sWriteLock);
+
+    return ucResponse;
+}
+
+/*
+ * Attach an iterator from any thread. Only the attachment itself is
+ * serialized, walking the tree with Next takes no lock.
+ */
+void ConcurrentAttach(ITERATOR pIter, TREE pTree)
+{
+    CONCURRENTTREE pData = CONCURRENT_DATA(pTree);
+
+    pthread_mutex_lock(&pData->sAttachLock);
+    Attach(pIter, pTree);
+    pthread_mutex_unlock(&pData->sAttachLock);
+}
+
+/*
+ * Detach an iterator attached with ConcurrentAttach.
+ */
+void ConcurrentDetach(ITERATOR pIter)
+{
+    CONCURRENTTREE pData = CONCURRENT_DATA(pIter->pTree);
+
+    pthread_mutex_lock(&pData->sAttachLock);
+    Detach(pIter);
+    pthread_mutex_unlock(&pData->sAttachLock);
+}
\ No newline at end of file
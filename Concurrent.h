@@ -0,0 +1,81 @@
+/*
+ * Implementation of a concurrent AVL tree engine. Readers never lock:
+ * they validate every step of a descent against per-node version numbers
+ * and retry if a writer changed the nodes underneath them. Writers are
+ * serialized and removed nodes are only freed once no reader can still
+ * be looking at them.
+ *
+ * Adam Doyle
+ */
+
+#ifndef __CONCURRENT_H__
+#define __CONCURRENT_H__
+
+#include <pthread.h>
+
+#include "BinarySearchTree.h"
+
+
+/* Bytes in a cache line, reader slots are padded to one each */
+#define CONCURRENT_CACHE_LINE 64
+
+/* Number of readers that can be inside the tree at once, further readers wait for a slot */
+#define CONCURRENT_READER_SLOTS 64
+
+/* Maximum height of the tree, far beyond what an AVL tree fitting in memory reaches */
+#define CONCURRENT_MAX_HEIGHT 64
+
+/* Number of removed nodes collected before the writer tries to free them */
+#define CONCURRENT_RECLAIM_BATCH 64
+
+
+/* Represents a single node of a concurrent tree */
+typedef struct ConcurrentNode
+{
+    struct ConcurrentNode *pLeftChild;
+    struct ConcurrentNode *pRightChild;
+    KEY uKey;
+    void *pContent;
+    unsigned long nVersion; /* Odd while a writer is changing the node, bumped by every change */
+    short int nHeight;
+    struct ConcurrentNode *pRetired; /* Next removed node waiting to be freed */
+    unsigned long nRetiredEpoch; /* Epoch the node was removed in */
+} *CONCURRENTNODE;
+
+/* Represents the epoch a reader entered the tree in, 0 if the slot is free */
+typedef union ReaderSlot
+{
+    unsigned long nEpoch;
+    char cPadding[CONCURRENT_CACHE_LINE];
+} *READERSLOT;
+
+/* Represents the concurrent data of a tree, stored as the tree's auxiliary object */
+typedef struct ConcurrentTree
+{
+    union ReaderSlot sSlots[CONCURRENT_READER_SLOTS];
+    struct ConcurrentNode sHolder; /* Sentinel whose right child is the root */
+    unsigned long nEpoch; /* Current epoch, advanced when the writer frees nodes */
+    CONCURRENTNODE pRetired; /* Removed nodes waiting to be freed */
+    int nRetired;
+    pthread_mutex_t sWriteLock; /* Serializes writers */
+    pthread_mutex_t sAttachLock; /* Serializes iterators attaching to and detaching from the tree */
+} *CONCURRENTTREE;
+
+/* Access the concurrent data of a Tree */
+#define CONCURRENT_DATA(pTree) ((CONCURRENTTREE)(pTree)->pAuxiliary)
+
+
+/* Allocate concurrent tree, TREE_THREADED and TREE_ORDER_STATS are ignored */
+TREE ConcurrentAllocTree(int nFlags);
+
+/*
+ * Operations safe to call from any thread. Search and Next may also be
+ * called directly, and never lock; every other tree operation must not
+ * run concurrently with these.
+ */
+unsigned char ConcurrentInsert(KEY uKey, void *pContent, TREE pTree);
+unsigned char ConcurrentRemove(KEY uKey, TREE pTree);
+void ConcurrentAttach(ITERATOR pIter, TREE pTree);
+void ConcurrentDetach(ITERATOR pIter);
+
+#endif /* __CONCURRENT_H__ */
\ No newline at end of file
@@ -0,0 +1,530 @@
+#include <stdlib.h>
+
+#include "BinarySearchTree.h"
+#include "Lean.h"
+
+/* Method predeclarations */
+/* Memory management */
+void *LeanAllocTreeAux(TREE pTree);
+void LeanFree(TREE pTree);
+LEANNODE LeanAllocNode(TREE pTree, KEY uKey, void *pContent);
+void LeanFreeNode(TREE pTree, LEANNODE pNode);
+void LeanFreeNodes(TREE pTree, LEANNODE pNode);
+
+/* Links and balancing */
+LEANNODE *LeanLink(LEANNODE pNode, int nSide);
+LEANNODE LeanRotate(LEANNODE pNode, int nSide, unsigned char *pucShorter);
+
+/* Basic tree operations */
+void *LeanSearch(KEY uKey, TREE pTree);
+void **LeanSlot(KEY uKey, TREE pTree);
+unsigned char LeanInsert(KEY uKey, void *pContent, TREE pTree);
+unsigned char LeanRemove(KEY uKey, TREE pTree, void **ppContent);
+unsigned char LeanBuild(KEY *pKeys, void **ppContents, int nCount, TREE pTree);
+LEANNODE LeanBuildNodes(KEY *pKeys, void **ppContents, int nCount, TREE pTree, int *pnHeight);
+
+/* Iteration */
+LEANPATH LeanPathOf(ITERATOR pIter);
+void LeanDescend(ITERATOR pIter, LEANNODE pNode, unsigned char ucDirection);
+void LeanSeekEnd(ITERATOR pIter, unsigned char ucDirection);
+void LeanSeek(ITERATOR pIter, KEY uKey, unsigned char ucStrict);
+void LeanStep(ITERATOR pIter, unsigned char ucDirection);
+void LeanCurrent(ITERATOR pIter, KEY *pKey, void **ppContent);
+void LeanDetach(ITERATOR pIter);
+
+/* Operations forwarded to by the core tree */
+static struct TreeEngine sLeanEngine =
+{
+    LeanFree,
+    LeanSearch,
+    LeanInsert,
+    LeanRemove,
+    LeanSeekEnd,
+    LeanSeek,
+    LeanStep,
+    LeanCurrent,
+    LeanDetach,
+    LeanSlot,
+    LeanBuild,
+    NULL
+};
+
+/*
+ * Allocate a tree whose nodes carry no parent link. Nodes can still
+ * come from the tree's pool.
+ */
+TREE LeanAllocTree(int nFlags)
+{
+    return AllocTree(LeanAllocTreeAux, nFlags & ~(TREE_THREADED | TREE_ORDER_STATS));
+}
+
+/*
+ * Prepare a new, empty lean tree, installing the engine.
+ */
+void *LeanAllocTreeAux(TREE pTree)
+{
+    LEANTREE pLean;
+
+    pLean = (LEANTREE)malloc(sizeof(*pLean));
+    pLean->pRoot = NULL;
+
+    pTree->pEngine = &sLeanEngine;
+    pTree->nNodeSize = sizeof(struct LeanNode);
+
+    return pLean;
+}
+
+/*
+ * Free all nodes, unless the pool will release them at once, along
+ * with the lean tree data.
+ */
+void LeanFree(TREE pTree)
+{
+    LEANTREE pLean = LEAN_DATA(pTree);
+
+    if (pTree->pNodePool == NULL)
+    {
+        LeanFreeNodes(pTree, pLean->pRoot);
+    }
+
+    free(pLean);
+    pTree->pAuxiliary = NULL;
+}
+
+/*
+ * Allocate a balanced leaf node, from the tree's pool if it has one.
+ */
+LEANNODE LeanAllocNode(TREE pTree, KEY uKey, void *pContent)
+{
+    LEANNODE pNode;
+
+    if (pTree->pNodePool != NULL)
+    {
+        pNode = (LEANNODE)PoolAlloc(pTree->pNodePool);
+    }
+    else
+    {
+        pNode = (LEANNODE)CountedMalloc(pTree->nNodeSize, &pTree->sCounters);
+    }
+    TREE_STAT(pTree, nAllocations, 1);
+    pNode->pLeftChild = NULL;
+    pNode->pRightChild = NULL;
+    pNode->uKey = uKey;
+    pNode->pContent = pContent;
+    pNode->cBalance = 0;
+
+    return pNode;
+}
+
+/*
+ * Free a node's memory, returning it to the tree's pool if it has one.
+ */
+void LeanFreeNode(TREE pTree, LEANNODE pNode)
+{
+    TREE_STAT(pTree, nFrees, 1);
+    if (pTree->pNodePool != NULL)
+    {
+        PoolFree(pTree->pNodePool, pNode);
+    }
+    else
+    {
+        CountedFree(pNode, pTree->nNodeSize, &pTree->sCounters);
+    }
+}
+
+/*
+ * Free a subtree, recursing to the left and looping to the right so the
+ * recursion stays within the tree's height.
+ */
+void LeanFreeNodes(TREE pTree, LEANNODE pNode)
+{
+    LEANNODE pRight;
+
+    while (pNode != NULL)
+    {
+        LeanFreeNodes(pTree, pNode->pLeftChild);
+        pRight = pNode->pRightChild;
+        LeanFreeNode(pTree, pNode);
+        pNode = pRight;
+    }
+}
+
+/*
+ * Return the address of a node's left (nSide < 0) or right (nSide > 0)
+ * child link.
+ */
+LEANNODE *LeanLink(LEANNODE pNode, int nSide)
+{
+    return nSide < 0 ? &pNode->pLeftChild : &pNode->pRightChild;
+}
+
+/*
+ * Rebalance a node whose nSide subtree is two levels higher than the
+ * other, returning the subtree's new root. *pucShorter is set to whether
+ * the subtree ended up lower than before the rotation.
+ */
+LEANNODE LeanRotate(LEANNODE pNode, int nSide, unsigned char *pucShorter)
+{
+    LEANNODE pChild = *LeanLink(pNode, nSide), pGrandchild;
+    int nChildBalance = pChild->cBalance * nSide, nGrandBalance;
+
+    if (nChildBalance >= 0) /* single rotation */
+    {
+        *LeanLink(pNode, nSide) = *LeanLink(pChild, -nSide);
+        *LeanLink(pChild, -nSide) = pNode;
+        if (nChildBalance == 0) /* only after a removal */
+        {
+            pNode->cBalance = (signed char)nSide;
+            pChild->cBalance = (signed char)-nSide;
+            *pucShorter = FALSE;
+        }
+        else
+        {
+            pNode->cBalance = 0;
+            pChild->cBalance = 0;
+            *pucShorter = TRUE;
+        }
+        return pChild;
+    }
+
+    /* double rotation, the grandchild becoming the root */
+    pGrandchild = *LeanLink(pChild, -nSide);
+    nGrandBalance = pGrandchild->cBalance * nSide;
+    *LeanLink(pChild, -nSide) = *LeanLink(pGrandchild, nSide);
+    *LeanLink(pNode, nSide) = *LeanLink(pGrandchild, -nSide);
+    *LeanLink(pGrandchild, nSide) = pChild;
+    *LeanLink(pGrandchild, -nSide) = pNode;
+    pNode->cBalance = (signed char)(nGrandBalance > 0 ? -nSide : 0);
+    pChild->cBalance = (signed char)(nGrandBalance < 0 ? nSide : 0);
+    pGrandchild->cBalance = 0;
+    *pucShorter = TRUE;
+    return pGrandchild;
+}
+
+/*
+ * Return the contents stored for a key, NULL if missing.
+ */
+void *LeanSearch(KEY uKey, TREE pTree)
+{
+    void **ppSlot = LeanSlot(uKey, pTree);
+
+    return ppSlot != NULL ? *ppSlot : NULL;
+}
+
+/*
+ * Return the address of the contents stored for a key, NULL if missing.
+ * It stays valid until the key itself is removed.
+ */
+void **LeanSlot(KEY uKey, TREE pTree)
+{
+    LEANNODE pNode = LEAN_DATA(pTree)->pRoot;
+    int nCompare;
+
+    while (pNode != NULL)
+    {
+        nCompare = COMPARE_KEYS(pTree, uKey, pNode->uKey);
+        if (nCompare == 0)
+        {
+            return &pNode->pContent;
+        }
+        pNode = *LeanLink(pNode, nCompare);
+    }
+
+    return NULL;
+}
+
+/*
+ * Insert a key, recording the links followed on the way down, then walk
+ * back up them updating balances until a subtree's height is unchanged
+ * or one rotation restores it. Returns FALSE if the key already exists.
+ */
+unsigned char LeanInsert(KEY uKey, void *pContent, TREE pTree)
+{
+    LEANNODE *ppLinks[LEAN_MAX_DEPTH], *ppLink = &LEAN_DATA(pTree)->pRoot, pNode;
+    int nSides[LEAN_MAX_DEPTH], nDepth = 0, nCompare, nBalance;
+    unsigned char ucShorter;
+
+    while (*ppLink != NULL)
+    {
+        pNode = *ppLink;
+        nCompare = COMPARE_KEYS(pTree, uKey, pNode->uKey);
+        if (nCompare == 0)
+        {
+            return FALSE;
+        }
+        ppLinks[nDepth] = ppLink;
+        nSides[nDepth++] = nCompare < 0 ? -1 : 1;
+        ppLink = LeanLink(pNode, nCompare);
+    }
+    *ppLink = LeanAllocNode(pTree, uKey, pContent);
+
+    while (nDepth-- > 0)
+    {
+        TREE_STAT(pTree, nRetraceSteps, 1);
+        pNode = *ppLinks[nDepth];
+        nBalance = pNode->cBalance + nSides[nDepth];
+        if (nBalance == 0)
+        {
+            pNode->cBalance = 0;
+            break;
+        }
+        if (nBalance == 1 || nBalance == -1)
+        {
+            pNode->cBalance = (signed char)nBalance;
+            continue;
+        }
+        TREE_STAT(pTree, nRotations, 1);
+        *ppLinks[nDepth] = LeanRotate(pNode, nSides[nDepth], &ucShorter);
+        break;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Remove a key. A node with two children is replaced by its successor,
+ * which is relinked in its place so that no other node moves. Balances
+ * are then updated back up the recorded links until a subtree's height
+ * is unchanged. Returns FALSE if the key doesn't exist, otherwise stores
+ * the contents it had in *ppContent if ppContent isn't NULL.
+ */
+unsigned char LeanRemove(KEY uKey, TREE pTree, void **ppContent)
+{
+    LEANNODE *ppLinks[LEAN_MAX_DEPTH], *ppLink = &LEAN_DATA(pTree)->pRoot, pNode, pFound, pSuccessor;
+    int nSides[LEAN_MAX_DEPTH], nDepth = 0, nFound, nCompare, nBalance;
+    unsigned char ucShorter;
+
+    while (*ppLink != NULL)
+    {
+        pNode = *ppLink;
+        nCompare = COMPARE_KEYS(pTree, uKey, pNode->uKey);
+        ppLinks[nDepth] = ppLink;
+        if (nCompare == 0)
+        {
+            break;
+        }
+        nSides[nDepth++] = nCompare < 0 ? -1 : 1;
+        ppLink = LeanLink(pNode, nCompare);
+    }
+    if (*ppLink == NULL)
+    {
+        return FALSE;
+    }
+
+    pFound = *ppLink;
+    nFound = nDepth;
+    if (ppContent != NULL)
+    {
+        *ppContent = pFound->pContent;
+    }
+    if (pFound->pLeftChild != NULL && pFound->pRightChild != NULL)
+    {
+        nSides[nDepth++] = 1;
+        ppLink = &pFound->pRightChild;
+        while ((*ppLink)->pLeftChild != NULL)
+        {
+            ppLinks[nDepth] = ppLink;
+            nSides[nDepth++] = -1;
+            ppLink = &(*ppLink)->pLeftChild;
+        }
+        pSuccessor = *ppLink;
+        *ppLink = pSuccessor->pRightChild;
+        pSuccessor->pLeftChild = pFound->pLeftChild;
+        pSuccessor->pRightChild = pFound->pRightChild;
+        pSuccessor->cBalance = pFound->cBalance;
+        *ppLinks[nFound] = pSuccessor;
+        ppLinks[nFound + 1] = &pSuccessor->pRightChild;
+    }
+    else
+    {
+        *ppLink = pFound->pLeftChild != NULL ? pFound->pLeftChild : pFound->pRightChild;
+    }
+    LeanFreeNode(pTree, pFound);
+
+    while (nDepth-- > 0)
+    {
+        TREE_STAT(pTree, nRetraceSteps, 1);
+        pNode = *ppLinks[nDepth];
+        nBalance = pNode->cBalance - nSides[nDepth];
+        if (nBalance == 1 || nBalance == -1)
+        {
+            pNode->cBalance = (signed char)nBalance;
+            break;
+        }
+        if (nBalance == 0)
+        {
+            pNode->cBalance = 0;
+            continue;
+        }
+        TREE_STAT(pTree, nRotations, 1);
+        *ppLinks[nDepth] = LeanRotate(pNode, -nSides[nDepth], &ucShorter);
+        if (ucShorter == FALSE)
+        {
+            break;
+        }
+    }
+
+    return TRUE;
+}
+
+/*
+ * Fill an empty tree from ascending keys, linking them into a perfectly
+ * balanced tree.
+ */
+unsigned char LeanBuild(KEY *pKeys, void **ppContents, int nCount, TREE pTree)
+{
+    int nHeight;
+
+    LEAN_DATA(pTree)->pRoot = LeanBuildNodes(pKeys, ppContents, nCount, pTree, &nHeight);
+    return TRUE;
+}
+
+/*
+ * Allocate nodes for nCount ascending keys in key order, linking them
+ * into a perfectly balanced subtree. Returns its root and sets *pnHeight
+ * to its height.
+ */
+LEANNODE LeanBuildNodes(KEY *pKeys, void **ppContents, int nCount, TREE pTree, int *pnHeight)
+{
+    LEANNODE pNode, pLeft;
+    int nMiddle = nCount / 2, nLeft, nRight;
+
+    if (nCount <= 0)
+    {
+        *pnHeight = 0;
+        return NULL;
+    }
+
+    pLeft = LeanBuildNodes(pKeys, ppContents, nMiddle, pTree, &nLeft);
+    pNode = LeanAllocNode(pTree, pKeys[nMiddle], ppContents != NULL ? ppContents[nMiddle] : NULL);
+    pNode->pLeftChild = pLeft;
+    pNode->pRightChild = LeanBuildNodes(pKeys + nMiddle + 1, ppContents != NULL ? ppContents + nMiddle + 1 : NULL,
+        nCount - nMiddle - 1, pTree, &nRight);
+    pNode->cBalance = (signed char)(nRight - nLeft);
+    *pnHeight = (nLeft > nRight ? nLeft : nRight) + 1;
+
+    return pNode;
+}
+
+/*
+ * Return an iterator's path, allocating it on first use.
+ */
+LEANPATH LeanPathOf(ITERATOR pIter)
+{
+    if (pIter->pState == NULL)
+    {
+        pIter->pState = malloc(sizeof(struct LeanPath));
+    }
+    return (LEANPATH)pIter->pState;
+}
+
+/*
+ * Extend an iterator's path from a node down to the first (FORWARD) or
+ * last entry of its subtree, and position the iterator there.
+ */
+void LeanDescend(ITERATOR pIter, LEANNODE pNode, unsigned char ucDirection)
+{
+    LEANPATH pPath = LeanPathOf(pIter);
+
+    while (pNode != NULL)
+    {
+        pPath->pNodes[pPath->nDepth++] = pNode;
+        pNode = *LeanLink(pNode, ucDirection == FORWARD ? -1 : 1);
+    }
+    pIter->pCursor = pPath->nDepth > 0 ? pPath->pNodes[pPath->nDepth - 1] : NULL;
+}
+
+/*
+ * Position an iterator at the first or last entry.
+ */
+void LeanSeekEnd(ITERATOR pIter, unsigned char ucDirection)
+{
+    LeanPathOf(pIter)->nDepth = 0;
+    LeanDescend(pIter, LEAN_DATA(pIter->pTree)->pRoot, ucDirection);
+}
+
+/*
+ * Position an iterator at the first entry not less than (or if
+ * ucStrict, greater than) a key, keeping the path down to it.
+ */
+void LeanSeek(ITERATOR pIter, KEY uKey, unsigned char ucStrict)
+{
+    LEANPATH pPath = LeanPathOf(pIter);
+    LEANNODE pNode = LEAN_DATA(pIter->pTree)->pRoot;
+    int nCompare, nFound = 0;
+
+    pPath->nDepth = 0;
+    while (pNode != NULL)
+    {
+        pPath->pNodes[pPath->nDepth++] = pNode;
+        nCompare = COMPARE_KEYS(pIter->pTree, pNode->uKey, uKey);
+        if (nCompare > 0 || (nCompare == 0 && !ucStrict))
+        {
+            nFound = pPath->nDepth;
+            pNode = pNode->pLeftChild;
+        }
+        else
+        {
+            pNode = pNode->pRightChild;
+        }
+    }
+
+    pPath->nDepth = nFound;
+    pIter->pCursor = nFound > 0 ? pPath->pNodes[nFound - 1] : NULL;
+}
+
+/*
+ * Move an iterator one entry in the given direction: down into the
+ * subtree on that side if there is one, otherwise back up the path to
+ * the first ancestor reached from the other side.
+ */
+void LeanStep(ITERATOR pIter, unsigned char ucDirection)
+{
+    LEANPATH pPath = LeanPathOf(pIter);
+    int nSide = ucDirection == FORWARD ? 1 : -1;
+    LEANNODE pNode = pPath->pNodes[pPath->nDepth - 1], pChild;
+
+    pChild = *LeanLink(pNode, nSide);
+    if (pChild != NULL)
+    {
+        LeanDescend(pIter, pChild, ucDirection);
+        return;
+    }
+
+    while (--pPath->nDepth > 0)
+    {
+        pChild = pNode;
+        pNode = pPath->pNodes[pPath->nDepth - 1];
+        if (*LeanLink(pNode, nSide) != pChild)
+        {
+            pIter->pCursor = pNode;
+            return;
+        }
+    }
+    pIter->pCursor = NULL;
+}
+
+/*
+ * Return the key and contents at an iterator's position.
+ */
+void LeanCurrent(ITERATOR pIter, KEY *pKey, void **ppContent)
+{
+    LEANNODE pNode = (LEANNODE)pIter->pCursor;
+
+    if (pKey != NULL)
+    {
+        *pKey = pNode->uKey;
+    }
+    if (ppContent != NULL)
+    {
+        *ppContent = pNode->pContent;
+    }
+}
+
+/*
+ * Free an iterator's path.
+ */
+void LeanDetach(ITERATOR pIter)
+{
+    free(pIter->pState);
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+/*
+ * Implementation of an AVL tree engine without parent links. Nodes only
+ * link down to their children, so updates retrace along the path
+ * recorded on the way down and iterators keep their own path, instead
+ * of storing and maintaining a parent pointer in every node. A node
+ * takes 40 bytes on 64-bit systems against the 64 of a basic AVL node.
+ * Nodes never move, but iterators must not be stepped across updates.
+ *
+ * Adam Doyle
+ */
+
+#ifndef __LEAN_H__
+#define __LEAN_H__
+
+#include "BinarySearchTree.h"
+
+
+/* Longest root to leaf path, above the 1.44 log2(n) bound of an AVL tree */
+#define LEAN_MAX_DEPTH 64
+
+
+/* Represents a node with no parent link */
+typedef struct LeanNode
+{
+    struct LeanNode *pLeftChild;
+    struct LeanNode *pRightChild;
+    KEY uKey;
+    void *pContent;
+    signed char cBalance; /* Right subtree height minus left subtree height */
+} *LEANNODE;
+
+/* Represents a lean tree's root, stored as the tree's auxiliary object */
+typedef struct LeanTree
+{
+    LEANNODE pRoot;
+} *LEANTREE;
+
+/* Represents the path from the root to an iterator's position, kept in its pState */
+typedef struct LeanPath
+{
+    int nDepth;
+    LEANNODE pNodes[LEAN_MAX_DEPTH];
+} *LEANPATH;
+
+/* Access the root of a lean tree */
+#define LEAN_DATA(pTree) ((LEANTREE)(pTree)->pAuxiliary)
+
+
+/* Allocate lean tree, TREE_THREADED and TREE_ORDER_STATS are ignored */
+TREE LeanAllocTree(int nFlags);
+
+#endif /* __LEAN_H__ */
\ No newline at end of file
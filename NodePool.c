@@ -0,0 +1,221 @@
+#include <stdlib.h>
+
+#include "NodePool.h"
+
+/* Header placed at the start of every slab, sized to keep objects aligned */
+typedef union SlabHeader
+{
+    union SlabHeader *pNext;
+    long long llAlign;
+    double dAlign;
+    void *pAlign;
+} *SLABHEADER;
+
+/* Method predeclarations */
+void CountAlloc(ALLOCCOUNTERS pCounters, size_t nBytes);
+void CountFree(ALLOCCOUNTERS pCounters, size_t nBytes);
+
+/*
+ * Record a call to malloc in the given counters.
+ */
+void CountAlloc(ALLOCCOUNTERS pCounters, size_t nBytes)
+{
+    if (pCounters == NULL)
+    {
+        return;
+    }
+
+    pCounters->nMallocs++;
+    pCounters->nBytes += (long)nBytes;
+    if (pCounters->nBytes > pCounters->nPeakBytes)
+    {
+        pCounters->nPeakBytes = pCounters->nBytes;
+    }
+}
+
+/*
+ * Record a call to free in the given counters.
+ */
+void CountFree(ALLOCCOUNTERS pCounters, size_t nBytes)
+{
+    if (pCounters == NULL)
+    {
+        return;
+    }
+
+    pCounters->nFrees++;
+    pCounters->nBytes -= (long)nBytes;
+}
+
+/*
+ * Allocate memory through malloc, updating the counters.
+ */
+void *CountedMalloc(size_t nBytes, ALLOCCOUNTERS pCounters)
+{
+    void *pMemory = malloc(nBytes);
+
+    CountAlloc(pCounters, nBytes);
+    if (pCounters != NULL)
+    {
+        pCounters->nObjects++;
+        if (pCounters->nObjects > pCounters->nPeakObjects)
+        {
+            pCounters->nPeakObjects = pCounters->nObjects;
+        }
+    }
+
+    return pMemory;
+}
+
+/*
+ * Free memory obtained through CountedMalloc, updating the counters.
+ */
+void CountedFree(void *pMemory, size_t nBytes, ALLOCCOUNTERS pCounters)
+{
+    free(pMemory);
+
+    CountFree(pCounters, nBytes);
+    if (pCounters != NULL)
+    {
+        pCounters->nObjects--;
+    }
+}
+
+/*
+ * Resize memory obtained through CountedMalloc (or allocate it, if
+ * pMemory is NULL), updating the counters. The object count is left
+ * alone.
+ */
+void *CountedRealloc(void *pMemory, size_t nOldBytes, size_t nBytes, ALLOCCOUNTERS pCounters)
+{
+    void *pResized = realloc(pMemory, nBytes);
+
+    if (pResized == NULL)
+    {
+        return NULL;
+    }
+    if (pMemory != NULL)
+    {
+        CountFree(pCounters, nOldBytes);
+    }
+    CountAlloc(pCounters, nBytes);
+
+    return pResized;
+}
+
+/*
+ * Zero out every counter.
+ */
+void ResetAllocCounters(ALLOCCOUNTERS pCounters)
+{
+    pCounters->nMallocs = 0;
+    pCounters->nFrees = 0;
+    pCounters->nObjects = 0;
+    pCounters->nPeakObjects = 0;
+    pCounters->nBytes = 0;
+    pCounters->nPeakBytes = 0;
+}
+
+/*
+ * Allocate a pool handing out objects of the given size. Object sizes are
+ * rounded up so every object stays aligned and can hold a free list link.
+ */
+NODEPOOL AllocPool(size_t nObjectSize, ALLOCCOUNTERS pCounters)
+{
+    NODEPOOL pPool;
+    size_t nAlign = sizeof(union SlabHeader);
+
+    pPool = (NODEPOOL)malloc(sizeof(*pPool));
+    pPool->nObjectSize = (nObjectSize + nAlign - 1) / nAlign * nAlign;
+    pPool->nObjectsPerSlab = (int)((POOL_SLAB_BYTES - nAlign) / pPool->nObjectSize);
+    if (pPool->nObjectsPerSlab < 1)
+    {
+        pPool->nObjectsPerSlab = 1;
+    }
+    pPool->pSlabs = NULL;
+    pPool->pFreeList = NULL;
+    pPool->pUnused = NULL;
+    pPool->nUnused = 0;
+    pPool->pCounters = pCounters;
+
+    return pPool;
+}
+
+/*
+ * Release every slab owned by the pool in one pass, along with the pool
+ * itself. Any objects still handed out become invalid.
+ */
+void FreePool(NODEPOOL pPool)
+{
+    SLABHEADER pSlab = (SLABHEADER)pPool->pSlabs, pNext;
+    size_t nSlabBytes = sizeof(union SlabHeader) + pPool->nObjectSize * pPool->nObjectsPerSlab;
+
+    while (pSlab != NULL)
+    {
+        pNext = pSlab->pNext;
+        free(pSlab);
+        CountFree(pPool->pCounters, nSlabBytes);
+        pSlab = pNext;
+    }
+
+    free(pPool);
+}
+
+/*
+ * Hand out an object, preferring previously released objects, then the
+ * untouched part of the newest slab, and finally a brand new slab.
+ */
+void *PoolAlloc(NODEPOOL pPool)
+{
+    void *pObject;
+    SLABHEADER pSlab;
+    size_t nSlabBytes;
+
+    if (pPool->pFreeList != NULL)
+    {
+        pObject = pPool->pFreeList;
+        pPool->pFreeList = *(void **)pObject;
+    }
+    else
+    {
+        if (pPool->nUnused == 0)
+        {
+            nSlabBytes = sizeof(union SlabHeader) + pPool->nObjectSize * pPool->nObjectsPerSlab;
+            pSlab = (SLABHEADER)malloc(nSlabBytes);
+            CountAlloc(pPool->pCounters, nSlabBytes);
+            pSlab->pNext = (SLABHEADER)pPool->pSlabs;
+            pPool->pSlabs = pSlab;
+            pPool->pUnused = (char *)(pSlab + 1);
+            pPool->nUnused = pPool->nObjectsPerSlab;
+        }
+
+        pObject = pPool->pUnused;
+        pPool->pUnused += pPool->nObjectSize;
+        pPool->nUnused--;
+    }
+
+    if (pPool->pCounters != NULL)
+    {
+        pPool->pCounters->nObjects++;
+        if (pPool->pCounters->nObjects > pPool->pCounters->nPeakObjects)
+        {
+            pPool->pCounters->nPeakObjects = pPool->pCounters->nObjects;
+        }
+    }
+
+    return pObject;
+}
+
+/*
+ * Return an object to the pool's free list for reuse.
+ */
+void PoolFree(NODEPOOL pPool, void *pObject)
+{
+    *(void **)pObject = pPool->pFreeList;
+    pPool->pFreeList = pObject;
+
+    if (pPool->pCounters != NULL)
+    {
+        pPool->pCounters->nObjects--;
+    }
+}
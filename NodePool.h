@@ -0,0 +1,56 @@
+/*
+ * Slab allocator used to pool fixed size objects (e.g. tree nodes) for a
+ * single tree, along with counters for tracking allocation behaviour.
+ *
+ * Adam Doyle
+ */
+
+#ifndef __NODEPOOL_H__
+#define __NODEPOOL_H__
+
+#include <stddef.h>
+
+
+/* Default number of bytes requested from malloc for each slab */
+#define POOL_SLAB_BYTES 16384
+
+
+/* Counters describing the memory obtained on behalf of a tree */
+typedef struct AllocCounters
+{
+    long nMallocs; /* Number of calls made to malloc */
+    long nFrees; /* Number of calls made to free */
+    long nObjects; /* Number of objects currently handed out */
+    long nPeakObjects; /* Maximum value nObjects has reached */
+    long nBytes; /* Number of bytes currently obtained from malloc */
+    long nPeakBytes; /* Maximum value nBytes has reached */
+} *ALLOCCOUNTERS;
+
+/* Represents a pool of equally sized objects carved out of slabs */
+typedef struct NodePool
+{
+    size_t nObjectSize;
+    int nObjectsPerSlab;
+    void *pSlabs; /* Singly linked list of every slab owned by the pool */
+    void *pFreeList; /* Intrusive list of released objects */
+    char *pUnused; /* Start of the untouched part of the newest slab */
+    int nUnused; /* Number of objects left in the untouched part */
+    ALLOCCOUNTERS pCounters; /* Optional counters to update */
+} *NODEPOOL;
+
+
+/* Memory management */
+NODEPOOL AllocPool(size_t nObjectSize, ALLOCCOUNTERS pCounters);
+void FreePool(NODEPOOL pPool);
+
+/* Object operations */
+void *PoolAlloc(NODEPOOL pPool);
+void PoolFree(NODEPOOL pPool, void *pObject);
+
+/* Counted wrappers around malloc/free for unpooled allocations */
+void *CountedMalloc(size_t nBytes, ALLOCCOUNTERS pCounters);
+void CountedFree(void *pMemory, size_t nBytes, ALLOCCOUNTERS pCounters);
+void *CountedRealloc(void *pMemory, size_t nOldBytes, size_t nBytes, ALLOCCOUNTERS pCounters);
+void ResetAllocCounters(ALLOCCOUNTERS pCounters);
+
+#endif /* __NODEPOOL_H__ */
@@ -0,0 +1,641 @@
+#include <stdlib.h>
+
+#include "BinarySearchTree.h"
+#include "Persistent.h"
+
+/* Method predeclarations */
+/* Memory management */
+void *PersistentAllocTreeAux(TREE pTree);
+void PersistentFree(TREE pTree);
+PERSISTENTNODE PersistentMake(KEY uKey, void *pContent, PERSISTENTNODE pLeft, PERSISTENTNODE pRight, TREE pTree);
+PERSISTENTNODE PersistentRetain(PERSISTENTNODE pNode);
+void PersistentRelease(PERSISTENTNODE pNode);
+void PersistentLock(PERSISTENTTREE pData);
+void PersistentUnlock(PERSISTENTTREE pData);
+PERSISTENTNODE PersistentAcquire(TREE pTree, int *pnSize);
+void PersistentPublish(TREE pTree, PERSISTENTNODE pRoot, int nChange);
+
+/* Path copying */
+short int PersistentHeight(PERSISTENTNODE pNode);
+PERSISTENTNODE PersistentBalance(KEY uKey, void *pContent, PERSISTENTNODE pLeft, PERSISTENTNODE pRight, TREE pTree);
+PERSISTENTNODE PersistentInsertInto(PERSISTENTNODE pNode, KEY uKey, void *pContent, unsigned char ucAssign, TREE pTree, unsigned char *pucInserted);
+PERSISTENTNODE PersistentRemoveFrom(PERSISTENTNODE pNode, KEY uKey, TREE pTree, void **ppContent, unsigned char *pucRemoved);
+PERSISTENTNODE PersistentRemoveFirst(PERSISTENTNODE pNode, KEY *pKey, void **ppContent, TREE pTree);
+
+/* Basic tree operations */
+void *PersistentSearch(KEY uKey, TREE pTree);
+unsigned char PersistentInsert(KEY uKey, void *pContent, TREE pTree);
+unsigned char PersistentRemove(KEY uKey, TREE pTree, void **ppContent);
+unsigned char PersistentAssign(KEY uKey, void *pContent, TREE pTree);
+unsigned char PersistentBuild(KEY *pKeys, void **ppContents, int nCount, TREE pTree);
+PERSISTENTNODE PersistentBuildNodes(KEY *pKeys, void **ppContents, int nCount, TREE pTree);
+
+/* Iteration */
+PERSISTENTNODE PersistentPin(ITERATOR pIter);
+PERSISTENTNODE PersistentCeiling(PERSISTENTNODE pNode, KEY uKey, unsigned char ucStrict, TREE pTree);
+PERSISTENTNODE PersistentFloorBelow(PERSISTENTNODE pNode, KEY uKey, TREE pTree);
+void PersistentSeekEnd(ITERATOR pIter, unsigned char ucDirection);
+void PersistentSeek(ITERATOR pIter, KEY uKey, unsigned char ucStrict);
+void PersistentStep(ITERATOR pIter, unsigned char ucDirection);
+void PersistentCurrent(ITERATOR pIter, KEY *pKey, void **ppContent);
+void PersistentDetach(ITERATOR pIter);
+
+/* Operations forwarded to by the core tree */
+static struct TreeEngine sPersistentEngine =
+{
+    PersistentFree,
+    PersistentSearch,
+    PersistentInsert,
+    PersistentRemove,
+    PersistentSeekEnd,
+    PersistentSeek,
+    PersistentStep,
+    PersistentCurrent,
+    PersistentDetach,
+    NULL,
+    PersistentBuild,
+    PersistentAssign
+};
+
+/*
+ * Allocate a tree whose versions are kept by path copying. Nodes are
+ * shared between trees, so they are never pooled.
+ */
+TREE PersistentAllocTree(int nFlags)
+{
+    return AllocTree(PersistentAllocTreeAux, nFlags & ~(TREE_POOLED | TREE_THREADED | TREE_ORDER_STATS));
+}
+
+/*
+ * Prepare a new persistent tree, installing the engine. The tree's
+ * auxiliary object holds its current version.
+ */
+void *PersistentAllocTreeAux(TREE pTree)
+{
+    PERSISTENTTREE pData;
+
+    pData = (PERSISTENTTREE)malloc(sizeof(*pData));
+    pData->pRoot = NULL;
+    pData->nSize = 0;
+    pData->nLock = 0;
+
+    pTree->pEngine = &sPersistentEngine;
+    pTree->nNodeSize = sizeof(struct PersistentNode);
+
+    return pData;
+}
+
+/*
+ * Return a new tree holding the current version of a persistent tree.
+ * Only the root is shared, so this takes constant time; later updates to
+ * either tree leave the other untouched. The version is released with
+ * FreeTree like any other tree.
+ */
+TREE PersistentVersion(TREE pTree)
+{
+    TREE pVersion = PersistentAllocTree(pTree->nFlags);
+    PERSISTENTTREE pData = PERSISTENT_DATA(pVersion);
+
+    pVersion->nKeyType = pTree->nKeyType;
+    pVersion->cbCompare = pTree->cbCompare;
+    pData->pRoot = PersistentAcquire(pTree, &pData->nSize);
+    pVersion->nSize = pData->nSize;
+
+    return pVersion;
+}
+
+/*
+ * Drop the tree's reference to its current version.
+ */
+void PersistentFree(TREE pTree)
+{
+    PersistentRelease(PERSISTENT_ROOT(pTree));
+    free(PERSISTENT_DATA(pTree));
+    pTree->pAuxiliary = NULL;
+}
+
+/*
+ * Wait for and take the lock guarding a tree's current version. It is
+ * only held for a few instructions, so waiters spin.
+ */
+void PersistentLock(PERSISTENTTREE pData)
+{
+    while (__atomic_exchange_n(&pData->nLock, 1, __ATOMIC_ACQUIRE) != 0)
+    {
+        while (__atomic_load_n(&pData->nLock, __ATOMIC_RELAXED) != 0)
+        {
+        }
+    }
+}
+
+/*
+ * Release the lock guarding a tree's current version.
+ */
+void PersistentUnlock(PERSISTENTTREE pData)
+{
+    __atomic_store_n(&pData->nLock, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Return a new reference to a tree's current version, and its size if
+ * pnSize isn't NULL. The root is retained under the lock so the updating
+ * thread can't free it in between.
+ */
+PERSISTENTNODE PersistentAcquire(TREE pTree, int *pnSize)
+{
+    PERSISTENTTREE pData = PERSISTENT_DATA(pTree);
+    PERSISTENTNODE pRoot;
+
+    PersistentLock(pData);
+    pRoot = PersistentRetain(pData->pRoot);
+    if (pnSize != NULL)
+    {
+        *pnSize = pData->nSize;
+    }
+    PersistentUnlock(pData);
+
+    return pRoot;
+}
+
+/*
+ * Make a new root the tree's current version, changing its size by
+ * nChange, then drop the tree's reference to the version it replaces.
+ */
+void PersistentPublish(TREE pTree, PERSISTENTNODE pRoot, int nChange)
+{
+    PERSISTENTTREE pData = PERSISTENT_DATA(pTree);
+    PERSISTENTNODE pOld;
+
+    PersistentLock(pData);
+    pOld = pData->pRoot;
+    pData->pRoot = pRoot;
+    pData->nSize += nChange;
+    PersistentUnlock(pData);
+
+    PersistentRelease(pOld);
+}
+
+/*
+ * Allocate a node taking over the references to its children. The new
+ * node starts with a single reference, owned by the caller. Nodes
+ * outlive the tree making the update, so no tree counts them.
+ */
+PERSISTENTNODE PersistentMake(KEY uKey, void *pContent, PERSISTENTNODE pLeft, PERSISTENTNODE pRight, TREE pTree)
+{
+    PERSISTENTNODE pNode;
+    short int nLeft = PersistentHeight(pLeft), nRight = PersistentHeight(pRight);
+
+    pNode = (PERSISTENTNODE)malloc(pTree->nNodeSize);
+    pNode->pLeftChild = pLeft;
+    pNode->pRightChild = pRight;
+    pNode->uKey = uKey;
+    pNode->pContent = pContent;
+    pNode->nRefs = 1;
+    pNode->nHeight = (nLeft > nRight ? nLeft : nRight) + 1;
+
+    return pNode;
+}
+
+/*
+ * Take another reference to a node. The caller already holds one, so
+ * the count can't reach zero meanwhile.
+ */
+PERSISTENTNODE PersistentRetain(PERSISTENTNODE pNode)
+{
+    if (pNode != NULL)
+    {
+        __atomic_add_fetch(&pNode->nRefs, 1, __ATOMIC_RELAXED);
+    }
+    return pNode;
+}
+
+/*
+ * Drop a reference to a node, freeing it and releasing its children
+ * once nothing references it. The last drop acquires the other threads'
+ * releases before freeing. Right children are released in a loop so
+ * only the left spine recurses.
+ */
+void PersistentRelease(PERSISTENTNODE pNode)
+{
+    PERSISTENTNODE pRight;
+
+    while (pNode != NULL && __atomic_sub_fetch(&pNode->nRefs, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        PersistentRelease(pNode->pLeftChild);
+        pRight = pNode->pRightChild;
+        free(pNode);
+        pNode = pRight;
+    }
+}
+
+/*
+ * Return the height of a node, 0 for NULL.
+ */
+short int PersistentHeight(PERSISTENTNODE pNode)
+{
+    return pNode != NULL ? pNode->nHeight : 0;
+}
+
+/*
+ * Build a node from an entry and two subtrees whose heights differ by at
+ * most two, rotating through fresh copies if they are out of balance.
+ * Takes over the references to both subtrees.
+ */
+PERSISTENTNODE PersistentBalance(KEY uKey, void *pContent, PERSISTENTNODE pLeft, PERSISTENTNODE pRight, TREE pTree)
+{
+    PERSISTENTNODE pNode, pInner;
+
+    if (PersistentHeight(pLeft) > PersistentHeight(pRight) + 1)
+    {
+        if (PersistentHeight(pLeft->pLeftChild) >= PersistentHeight(pLeft->pRightChild)) /* Right rotation */
+        {
+            pNode = PersistentMake(pLeft->uKey, pLeft->pContent, PersistentRetain(pLeft->pLeftChild),
+                                   PersistentMake(uKey, pContent, PersistentRetain(pLeft->pRightChild), pRight, pTree), pTree);
+        }
+        else /* Left-right rotation */
+        {
+            pInner = pLeft->pRightChild;
+            pNode = PersistentMake(pInner->uKey, pInner->pContent,
+                                   PersistentMake(pLeft->uKey, pLeft->pContent, PersistentRetain(pLeft->pLeftChild), PersistentRetain(pInner->pLeftChild), pTree),
+                                   PersistentMake(uKey, pContent, PersistentRetain(pInner->pRightChild), pRight, pTree), pTree);
+        }
+        PersistentRelease(pLeft);
+        return pNode;
+    }
+
+    if (PersistentHeight(pRight) > PersistentHeight(pLeft) + 1)
+    {
+        if (PersistentHeight(pRight->pRightChild) >= PersistentHeight(pRight->pLeftChild)) /* Left rotation */
+        {
+            pNode = PersistentMake(pRight->uKey, pRight->pContent,
+                                   PersistentMake(uKey, pContent, pLeft, PersistentRetain(pRight->pLeftChild), pTree),
+                                   PersistentRetain(pRight->pRightChild), pTree);
+        }
+        else /* Right-left rotation */
+        {
+            pInner = pRight->pLeftChild;
+            pNode = PersistentMake(pInner->uKey, pInner->pContent,
+                                   PersistentMake(uKey, pContent, pLeft, PersistentRetain(pInner->pLeftChild), pTree),
+                                   PersistentMake(pRight->uKey, pRight->pContent, PersistentRetain(pInner->pRightChild), PersistentRetain(pRight->pRightChild), pTree), pTree);
+        }
+        PersistentRelease(pRight);
+        return pNode;
+    }
+
+    return PersistentMake(uKey, pContent, pLeft, pRight, pTree);
+}
+
+/*
+ * Return a new reference to a subtree with a key inserted, copying the
+ * path down to it. If the key already exists *pucInserted is FALSE, and
+ * either the path is copied with the key's contents replaced (if
+ * ucAssign) or the subtree itself is returned with an extra reference.
+ */
+PERSISTENTNODE PersistentInsertInto(PERSISTENTNODE pNode, KEY uKey, void *pContent, unsigned char ucAssign, TREE pTree, unsigned char *pucInserted)
+{
+    PERSISTENTNODE pChild;
+    int nCompare;
+
+    if (pNode == NULL)
+    {
+        *pucInserted = TRUE;
+        return PersistentMake(uKey, pContent, NULL, NULL, pTree);
+    }
+
+    nCompare = COMPARE_KEYS(pTree, uKey, pNode->uKey);
+    if (nCompare == 0)
+    {
+        *pucInserted = FALSE;
+        if (ucAssign)
+        {
+            return PersistentMake(pNode->uKey, pContent, PersistentRetain(pNode->pLeftChild), PersistentRetain(pNode->pRightChild), pTree);
+        }
+        return PersistentRetain(pNode);
+    }
+
+    if (nCompare < 0)
+    {
+        pChild = PersistentInsertInto(pNode->pLeftChild, uKey, pContent, ucAssign, pTree, pucInserted);
+        if (!*pucInserted && !ucAssign)
+        {
+            PersistentRelease(pChild);
+            return PersistentRetain(pNode);
+        }
+        return PersistentBalance(pNode->uKey, pNode->pContent, pChild, PersistentRetain(pNode->pRightChild), pTree);
+    }
+
+    pChild = PersistentInsertInto(pNode->pRightChild, uKey, pContent, ucAssign, pTree, pucInserted);
+    if (!*pucInserted && !ucAssign)
+    {
+        PersistentRelease(pChild);
+        return PersistentRetain(pNode);
+    }
+    return PersistentBalance(pNode->uKey, pNode->pContent, PersistentRetain(pNode->pLeftChild), pChild, pTree);
+}
+
+/*
+ * Return a new reference to a subtree with a key removed, copying the
+ * path down to it and storing the contents it had in *ppContent if
+ * ppContent isn't NULL. If the key doesn't exist the subtree itself is
+ * returned with an extra reference and *pucRemoved is FALSE.
+ */
+PERSISTENTNODE PersistentRemoveFrom(PERSISTENTNODE pNode, KEY uKey, TREE pTree, void **ppContent, unsigned char *pucRemoved)
+{
+    PERSISTENTNODE pChild;
+    KEY uFirstKey;
+    void *pFirstContent;
+    int nCompare;
+
+    if (pNode == NULL)
+    {
+        *pucRemoved = FALSE;
+        return NULL;
+    }
+
+    nCompare = COMPARE_KEYS(pTree, uKey, pNode->uKey);
+    if (nCompare == 0)
+    {
+        *pucRemoved = TRUE;
+        if (ppContent != NULL)
+        {
+            *ppContent = pNode->pContent;
+        }
+        if (pNode->pLeftChild == NULL)
+        {
+            return PersistentRetain(pNode->pRightChild);
+        }
+        if (pNode->pRightChild == NULL)
+        {
+            return PersistentRetain(pNode->pLeftChild);
+        }
+
+        /* Replace the entry with its successor */
+        pChild = PersistentRemoveFirst(pNode->pRightChild, &uFirstKey, &pFirstContent, pTree);
+        return PersistentBalance(uFirstKey, pFirstContent, PersistentRetain(pNode->pLeftChild), pChild, pTree);
+    }
+
+    if (nCompare < 0)
+    {
+        pChild = PersistentRemoveFrom(pNode->pLeftChild, uKey, pTree, ppContent, pucRemoved);
+        if (!*pucRemoved)
+        {
+            PersistentRelease(pChild);
+            return PersistentRetain(pNode);
+        }
+        return PersistentBalance(pNode->uKey, pNode->pContent, pChild, PersistentRetain(pNode->pRightChild), pTree);
+    }
+
+    pChild = PersistentRemoveFrom(pNode->pRightChild, uKey, pTree, ppContent, pucRemoved);
+    if (!*pucRemoved)
+    {
+        PersistentRelease(pChild);
+        return PersistentRetain(pNode);
+    }
+    return PersistentBalance(pNode->uKey, pNode->pContent, PersistentRetain(pNode->pLeftChild), pChild, pTree);
+}
+
+/*
+ * Return a new reference to a non-empty subtree with its first entry
+ * removed, handing back that entry's key and contents.
+ */
+PERSISTENTNODE PersistentRemoveFirst(PERSISTENTNODE pNode, KEY *pKey, void **ppContent, TREE pTree)
+{
+    PERSISTENTNODE pChild;
+
+    if (pNode->pLeftChild == NULL)
+    {
+        *pKey = pNode->uKey;
+        *ppContent = pNode->pContent;
+        return PersistentRetain(pNode->pRightChild);
+    }
+
+    pChild = PersistentRemoveFirst(pNode->pLeftChild, pKey, ppContent, pTree);
+    return PersistentBalance(pNode->uKey, pNode->pContent, pChild, PersistentRetain(pNode->pRightChild), pTree);
+}
+
+/*
+ * Return the contents stored for a key in the current version,
+ * NULL if missing.
+ */
+void *PersistentSearch(KEY uKey, TREE pTree)
+{
+    PERSISTENTNODE pNode = PERSISTENT_ROOT(pTree);
+    int nCompare;
+
+    while (pNode != NULL)
+    {
+        nCompare = COMPARE_KEYS(pTree, uKey, pNode->uKey);
+        if (nCompare == 0)
+        {
+            return pNode->pContent;
+        }
+        pNode = (nCompare < 0 ? pNode->pLeftChild : pNode->pRightChild);
+    }
+
+    return NULL;
+}
+
+/*
+ * Insert a key into a new version, which replaces the tree's current
+ * version. Returns FALSE if the key already exists.
+ */
+unsigned char PersistentInsert(KEY uKey, void *pContent, TREE pTree)
+{
+    PERSISTENTNODE pRoot;
+    unsigned char ucInserted;
+
+    pRoot = PersistentInsertInto(PERSISTENT_ROOT(pTree), uKey, pContent, FALSE, pTree, &ucInserted);
+    PersistentPublish(pTree, pRoot, ucInserted ? 1 : 0);
+
+    return ucInserted;
+}
+
+/*
+ * Remove a key from a new version, which replaces the tree's current
+ * version. Returns FALSE if the key doesn't exist, otherwise stores the
+ * contents it had in *ppContent if ppContent isn't NULL.
+ */
+unsigned char PersistentRemove(KEY uKey, TREE pTree, void **ppContent)
+{
+    PERSISTENTNODE pRoot;
+    unsigned char ucRemoved;
+
+    pRoot = PersistentRemoveFrom(PERSISTENT_ROOT(pTree), uKey, pTree, ppContent, &ucRemoved);
+    PersistentPublish(pTree, pRoot, ucRemoved ? -1 : 0);
+
+    return ucRemoved;
+}
+
+/*
+ * Insert a key, or replace its contents if it already exists, in a new
+ * version copied along a single path, which replaces the tree's current
+ * version. Returns TRUE if the key was inserted.
+ */
+unsigned char PersistentAssign(KEY uKey, void *pContent, TREE pTree)
+{
+    PERSISTENTNODE pRoot;
+    unsigned char ucInserted;
+
+    pRoot = PersistentInsertInto(PERSISTENT_ROOT(pTree), uKey, pContent, TRUE, pTree, &ucInserted);
+    PersistentPublish(pTree, pRoot, ucInserted ? 1 : 0);
+
+    return ucInserted;
+}
+
+/*
+ * Fill an empty tree from ascending keys, publishing a perfectly
+ * balanced version built from fresh nodes.
+ */
+unsigned char PersistentBuild(KEY *pKeys, void **ppContents, int nCount, TREE pTree)
+{
+    PersistentPublish(pTree, PersistentBuildNodes(pKeys, ppContents, nCount, pTree), nCount);
+    return TRUE;
+}
+
+/*
+ * Return a new reference to a perfectly balanced subtree holding nCount
+ * ascending keys.
+ */
+PERSISTENTNODE PersistentBuildNodes(KEY *pKeys, void **ppContents, int nCount, TREE pTree)
+{
+    PERSISTENTNODE pLeft;
+    int nMiddle = nCount / 2;
+
+    if (nCount <= 0)
+    {
+        return NULL;
+    }
+
+    pLeft = PersistentBuildNodes(pKeys, ppContents, nMiddle, pTree);
+    return PersistentMake(pKeys[nMiddle], ppContents != NULL ? ppContents[nMiddle] : NULL, pLeft,
+        PersistentBuildNodes(pKeys + nMiddle + 1, ppContents != NULL ? ppContents + nMiddle + 1 : NULL, nCount - nMiddle - 1, pTree), pTree);
+}
+
+/*
+ * Return the version an iterator walks, pinning the tree's current
+ * version on first use so later updates don't disturb the iterator.
+ */
+PERSISTENTNODE PersistentPin(ITERATOR pIter)
+{
+    if (pIter->pState == NULL)
+    {
+        pIter->pState = PersistentAcquire(pIter->pTree, NULL);
+    }
+    return (PERSISTENTNODE)pIter->pState;
+}
+
+/*
+ * Return the first node not less than (or if ucStrict, greater
+ * than) a key, NULL if there is none.
+ */
+PERSISTENTNODE PersistentCeiling(PERSISTENTNODE pNode, KEY uKey, unsigned char ucStrict, TREE pTree)
+{
+    PERSISTENTNODE pFound = NULL;
+    int nCompare;
+
+    while (pNode != NULL)
+    {
+        nCompare = COMPARE_KEYS(pTree, pNode->uKey, uKey);
+        if (nCompare > 0 || (nCompare == 0 && !ucStrict))
+        {
+            pFound = pNode;
+            pNode = pNode->pLeftChild;
+        }
+        else
+        {
+            pNode = pNode->pRightChild;
+        }
+    }
+
+    return pFound;
+}
+
+/*
+ * Return the last node less than a key, NULL if there is none.
+ */
+PERSISTENTNODE PersistentFloorBelow(PERSISTENTNODE pNode, KEY uKey, TREE pTree)
+{
+    PERSISTENTNODE pFound = NULL;
+
+    while (pNode != NULL)
+    {
+        if (COMPARE_KEYS(pTree, pNode->uKey, uKey) < 0)
+        {
+            pFound = pNode;
+            pNode = pNode->pRightChild;
+        }
+        else
+        {
+            pNode = pNode->pLeftChild;
+        }
+    }
+
+    return pFound;
+}
+
+/*
+ * Position an iterator at the first or last entry of its version.
+ */
+void PersistentSeekEnd(ITERATOR pIter, unsigned char ucDirection)
+{
+    PERSISTENTNODE pNode = PersistentPin(pIter);
+
+    while (pNode != NULL)
+    {
+        pIter->pCursor = pNode;
+        pNode = (ucDirection == FORWARD ? pNode->pLeftChild : pNode->pRightChild);
+    }
+}
+
+/*
+ * Position an iterator at the first entry not less than (or if
+ * ucStrict, greater than) a key.
+ */
+void PersistentSeek(ITERATOR pIter, KEY uKey, unsigned char ucStrict)
+{
+    pIter->pCursor = PersistentCeiling(PersistentPin(pIter), uKey, ucStrict, pIter->pTree);
+}
+
+/*
+ * Move an iterator one entry in the given direction. Nodes have no
+ * parent links, so the neighbour is found by descending the pinned
+ * version from its root again.
+ */
+void PersistentStep(ITERATOR pIter, unsigned char ucDirection)
+{
+    KEY uKey = ((PERSISTENTNODE)pIter->pCursor)->uKey;
+
+    if (ucDirection == FORWARD)
+    {
+        pIter->pCursor = PersistentCeiling(PersistentPin(pIter), uKey, TRUE, pIter->pTree);
+    }
+    else
+    {
+        pIter->pCursor = PersistentFloorBelow(PersistentPin(pIter), uKey, pIter->pTree);
+    }
+}
+
+/*
+ * Return the key and contents at an iterator's position.
+ */
+void PersistentCurrent(ITERATOR pIter, KEY *pKey, void **ppContent)
+{
+    PERSISTENTNODE pNode = (PERSISTENTNODE)pIter->pCursor;
+
+    if (pKey != NULL)
+    {
+        *pKey = pNode->uKey;
+    }
+    if (ppContent != NULL)
+    {
+        *ppContent = pNode->pContent;
+    }
+}
+
+/*
+ * Unpin the version an iterator walked.
+ */
+void PersistentDetach(ITERATOR pIter)
+{
+    PersistentRelease((PERSISTENTNODE)pIter->pState);
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+/*
+ * Implementation of a persistent AVL tree engine. Updates copy the path
+ * from the root to the changed node instead of modifying nodes in place,
+ * so every version of the tree stays intact and versions share all the
+ * nodes they have in common.
+ *
+ * One thread may update a tree while other threads take versions of it;
+ * each version is then searched, iterated and freed by the thread that
+ * took it. Nodes are shared between trees, so they are not counted in
+ * any tree's allocation counters.
+ *
+ * Adam Doyle
+ */
+
+#ifndef __PERSISTENT_H__
+#define __PERSISTENT_H__
+
+#include "BinarySearchTree.h"
+
+
+/* Represents a single, immutable node shared between versions */
+typedef struct PersistentNode
+{
+    struct PersistentNode *pLeftChild;
+    struct PersistentNode *pRightChild;
+    KEY uKey;
+    void *pContent;
+    int nRefs; /* Number of parents, versions and iterators referencing the node, changed atomically */
+    short int nHeight;
+} *PERSISTENTNODE;
+
+/* Represents a tree's current version, stored as the tree's auxiliary object */
+typedef struct PersistentTree
+{
+    PERSISTENTNODE pRoot;
+    int nSize; /* Entries in the current version, published along with the root */
+    int nLock; /* Held while the root is replaced or retained by another thread */
+} *PERSISTENTTREE;
+
+/* Access the current version of a persistent tree */
+#define PERSISTENT_DATA(pTree) ((PERSISTENTTREE)(pTree)->pAuxiliary)
+#define PERSISTENT_ROOT(pTree) (PERSISTENT_DATA(pTree)->pRoot)
+
+
+/* Allocate persistent tree, TREE_POOLED, TREE_THREADED and TREE_ORDER_STATS are ignored */
+TREE PersistentAllocTree(int nFlags);
+
+/* Return a new handle on the current version of a persistent tree, in constant time */
+TREE PersistentVersion(TREE pTree);
+
+#endif /* __PERSISTENT_H__ */
\ No newline at end of file
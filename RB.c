@@ -0,0 +1,206 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "BinarySearchTree.h"
+#include "RB.h"
+
+/* Method predeclarations */
+/* Memory management */
+void *RBAllocTreeAux(TREE pTree);
+
+/* Coloring and balancing */
+unsigned char RBIsRed(NODE pNode);
+void RBInsertBalance(NODE pNode);
+void RBUnlinkBalance(NODE pNode);
+void RBBuildSetColor(NODE pNode, int nDepth);
+void RBDebugNode(NODE pNode);
+
+/*
+ * Prepare a new red-black tree, reserving room for the red-black
+ * node data inline in every tree Node.
+ */
+void *RBAllocTreeAux(TREE pTree)
+{
+    pTree->nNodeMetaSize = sizeof(struct RBNode);
+    return NULL;
+}
+
+/*
+ * Return whether a node is red, NULL leaves being black.
+ */
+unsigned char RBIsRed(NODE pNode)
+{
+    return (pNode != NULL && RB_NODE(pNode)->ucColor == RB_RED);
+}
+
+/*
+ * Restore the red-black properties after inserting a node, recoloring
+ * up the tree and performing at most two rotations.
+ */
+void RBInsertBalance(NODE pNode)
+{
+    NODE pParent, pGrandparent, pUncle;
+
+    RB_NODE(pNode)->ucColor = RB_RED;
+    while (TRUE)
+    {
+        pParent = pNode->pParent;
+        if (pParent == NULL) /* Root is always black */
+        {
+            RB_NODE(pNode)->ucColor = RB_BLACK;
+            return;
+        }
+        if (!RBIsRed(pParent))
+        {
+            return;
+        }
+
+        pGrandparent = Grandparent(pNode);
+        pUncle = Uncle(pNode);
+        if (RBIsRed(pUncle)) /* Push the grandparent's blackness down and continue above */
+        {
+            RB_NODE(pParent)->ucColor = RB_BLACK;
+            RB_NODE(pUncle)->ucColor = RB_BLACK;
+            RB_NODE(pGrandparent)->ucColor = RB_RED;
+            pNode = pGrandparent;
+            continue;
+        }
+
+        /* Move an inner grandchild to the outside first */
+        if (pNode == pParent->pRightChild && pParent == pGrandparent->pLeftChild)
+        {
+            LeftRotation(pParent);
+            pNode = pParent;
+            pParent = pNode->pParent;
+        }
+        else if (pNode == pParent->pLeftChild && pParent == pGrandparent->pRightChild)
+        {
+            RightRotation(pParent);
+            pNode = pParent;
+            pParent = pNode->pParent;
+        }
+
+        RB_NODE(pParent)->ucColor = RB_BLACK;
+        RB_NODE(pGrandparent)->ucColor = RB_RED;
+        if (pNode == pParent->pLeftChild)
+        {
+            RightRotation(pGrandparent);
+        }
+        else
+        {
+            LeftRotation(pGrandparent);
+        }
+        return;
+    }
+}
+
+/*
+ * Restore the red-black properties before a node with at most one child
+ * is spliced out. A black leaf is treated as doubly black while it is
+ * still linked, performing at most three rotations.
+ */
+void RBUnlinkBalance(NODE pNode)
+{
+    NODE pParent, pSibling, pChildNode;
+
+    if (RBIsRed(pNode))
+    {
+        return;
+    }
+
+    pChildNode = pNode->pLeftChild == NULL ? pNode->pRightChild : pNode->pLeftChild;
+    if (pChildNode != NULL) /* Only child must be red, it takes over the blackness */
+    {
+        RB_NODE(pChildNode)->ucColor = RB_BLACK;
+        return;
+    }
+
+    while (pNode->pParent != NULL && !RBIsRed(pNode))
+    {
+        pParent = pNode->pParent;
+        pSibling = Sibling(pNode);
+
+        if (RBIsRed(pSibling)) /* Rotate so the sibling is black */
+        {
+            RB_NODE(pSibling)->ucColor = RB_BLACK;
+            RB_NODE(pParent)->ucColor = RB_RED;
+            if (pNode == pParent->pLeftChild)
+            {
+                LeftRotation(pParent);
+            }
+            else
+            {
+                RightRotation(pParent);
+            }
+            pSibling = Sibling(pNode);
+        }
+
+        if (!RBIsRed(pSibling->pLeftChild) && !RBIsRed(pSibling->pRightChild))
+        {
+            RB_NODE(pSibling)->ucColor = RB_RED;
+            pNode = pParent;
+            continue;
+        }
+
+        if (pNode == pParent->pLeftChild)
+        {
+            if (!RBIsRed(pSibling->pRightChild))
+            {
+                RB_NODE(pSibling->pLeftChild)->ucColor = RB_BLACK;
+                RB_NODE(pSibling)->ucColor = RB_RED;
+                pSibling = RightRotation(pSibling);
+            }
+            RB_NODE(pSibling)->ucColor = RB_NODE(pParent)->ucColor;
+            RB_NODE(pParent)->ucColor = RB_BLACK;
+            RB_NODE(pSibling->pRightChild)->ucColor = RB_BLACK;
+            LeftRotation(pParent);
+        }
+        else
+        {
+            if (!RBIsRed(pSibling->pLeftChild))
+            {
+                RB_NODE(pSibling->pRightChild)->ucColor = RB_BLACK;
+                RB_NODE(pSibling)->ucColor = RB_RED;
+                pSibling = LeftRotation(pSibling);
+            }
+            RB_NODE(pSibling)->ucColor = RB_NODE(pParent)->ucColor;
+            RB_NODE(pParent)->ucColor = RB_BLACK;
+            RB_NODE(pSibling->pLeftChild)->ucColor = RB_BLACK;
+            RightRotation(pParent);
+        }
+        return;
+    }
+
+    RB_NODE(pNode)->ucColor = RB_BLACK;
+}
+
+/*
+ * Color a node placed by a bulk build. Every level that is completely
+ * filled is black, and the nodes of a partially filled last level are red.
+ */
+void RBBuildSetColor(NODE pNode, int nDepth)
+{
+    RB_NODE(pNode)->ucColor = (2L << nDepth) > pNode->pTree->nSize + 1L ? RB_RED : RB_BLACK;
+}
+
+/*
+ * Print out the red-black data of a node.
+ */
+void RBDebugNode(NODE pNode)
+{
+    printf("Color: %s\n", RBIsRed(pNode) ? "red" : "black");
+}
+
+/*
+ * Allocate a new tree and establish the appropriate callbacks.
+ * nFlags is a combination of the TREE_* creation flags.
+ */
+TREE RBAllocTree(int nFlags)
+{
+    TREE pTree = AllocTree(RBAllocTreeAux, nFlags);
+    pTree->cbInsert = RBInsertBalance;
+    pTree->cbUnlink = RBUnlinkBalance;
+    pTree->cbBuild = RBBuildSetColor;
+    pTree->cbDebugNode = RBDebugNode;
+    return pTree;
+}
\ No newline at end of file
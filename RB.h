@@ -0,0 +1,31 @@
+/*
+ * Implementation of a red-black tree as an extension to BinarySearchTree.
+ *
+ * Adam Doyle
+ */
+
+#ifndef __RB_H__
+#define __RB_H__
+
+#include "BinarySearchTree.h"
+
+
+/* Node colors */
+#define RB_BLACK 0
+#define RB_RED 1
+
+
+/* Represents extra node data required for red-black, stored inline after each node */
+typedef struct RBNode
+{
+    unsigned char ucColor;
+} *RBNODE;
+
+/* Access the red-black data of a tree Node */
+#define RB_NODE(pNode) ((RBNODE)NODE_META(pNode))
+
+
+/* Allocate red-black tree */
+TREE RBAllocTree(int nFlags);
+
+#endif /* __RB_H__ */
\ No newline at end of file
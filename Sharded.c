@@ -0,0 +1,478 @@
+/* Read/write locks are POSIX, hidden by strict ISO C modes */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdlib.h>
+
+#include "BinarySearchTree.h"
+#include "Sharded.h"
+
+/* Method predeclarations */
+/* Memory management */
+SHARD AllocShard(SHARDEDTREE pSharded);
+void FreeShard(SHARD pShard);
+
+/* Shard management */
+int FindShard(KEY uKey, SHARDEDTREE pSharded);
+void SplitShard(KEY uKey, SHARDEDTREE pSharded);
+
+/* Iteration */
+unsigned char ShardedExhausted(SHARDEDITERATOR pIter);
+void ShardedEnter(SHARDEDITERATOR pIter);
+void ShardedLeave(SHARDEDITERATOR pIter);
+void ShardedSkip(SHARDEDITERATOR pIter);
+
+/*
+ * Allocate a sharded tree with nSplits + 1 shards, shard i + 1 holding
+ * the keys from pSplits[i] up to pSplits[i + 1]. The split keys must be
+ * in ascending order. Shards growing past nSplitSize keys are split at
+ * their middle key, unless nSplitSize is 0. Shard trees are created by
+ * cbAllocShard, or AllocTree if it is NULL, with the given flags.
+ */
+SHARDEDTREE AllocShardedTree(AllocShardCallback cbAllocShard, int nFlags, KEY *pSplits, int nSplits, int nSplitSize)
+{
+    SHARDEDTREE pSharded;
+    int i;
+
+    pSharded = (SHARDEDTREE)malloc(sizeof(*pSharded));
+    pSharded->nShards = nSplits + 1;
+    pSharded->nSplitSize = nSplitSize;
+    pSharded->nFlags = nFlags;
+    pSharded->nKeyType = KEY_INT;
+    pSharded->cbCompare = NULL;
+    pSharded->cbAllocShard = cbAllocShard;
+    pthread_rwlock_init(&pSharded->sLayoutLock, NULL);
+
+    pSharded->ppShards = (SHARD *)malloc(sizeof(SHARD) * pSharded->nShards);
+    for (i = 0; i < pSharded->nShards; i++)
+    {
+        pSharded->ppShards[i] = AllocShard(pSharded);
+        if (i > 0)
+        {
+            pSharded->ppShards[i]->uLow = pSplits[i - 1];
+        }
+    }
+
+    return pSharded;
+}
+
+/*
+ * Set the key type of every shard. Only valid before any key
+ * is inserted.
+ */
+void SetShardedKeyType(SHARDEDTREE pSharded, int nKeyType, CompareCallback cbCompare)
+{
+    int i;
+
+    pSharded->nKeyType = nKeyType;
+    pSharded->cbCompare = cbCompare;
+    for (i = 0; i < pSharded->nShards; i++)
+    {
+        SetKeyType(pSharded->ppShards[i]->pTree, nKeyType, cbCompare);
+    }
+}
+
+/*
+ * Free a sharded tree and all of its shards. No other thread
+ * may be using it.
+ */
+void FreeShardedTree(SHARDEDTREE pSharded)
+{
+    int i;
+
+    for (i = 0; i < pSharded->nShards; i++)
+    {
+        FreeShard(pSharded->ppShards[i]);
+    }
+    free(pSharded->ppShards);
+    pthread_rwlock_destroy(&pSharded->sLayoutLock);
+    free(pSharded);
+}
+
+/*
+ * Allocate an empty shard with a tree of the sharded tree's kind.
+ */
+SHARD AllocShard(SHARDEDTREE pSharded)
+{
+    SHARD pShard;
+
+    pShard = (SHARD)malloc(sizeof(*pShard));
+    if (pSharded->cbAllocShard != NULL)
+    {
+        pShard->pTree = pSharded->cbAllocShard(pSharded->nFlags);
+    }
+    else
+    {
+        pShard->pTree = AllocTree(NULL, pSharded->nFlags);
+    }
+    SetKeyType(pShard->pTree, pSharded->nKeyType, pSharded->cbCompare);
+    pShard->uLow.llInt = 0;
+    pthread_rwlock_init(&pShard->sLock, NULL);
+    pthread_mutex_init(&pShard->sAttachLock, NULL);
+
+    return pShard;
+}
+
+/*
+ * Free a shard along with its tree.
+ */
+void FreeShard(SHARD pShard)
+{
+    FreeTree(pShard->pTree);
+    pthread_rwlock_destroy(&pShard->sLock);
+    pthread_mutex_destroy(&pShard->sAttachLock);
+    free(pShard);
+}
+
+/*
+ * Allocate an iterator for a sharded tree.
+ */
+SHARDEDITERATOR AllocShardedIterator()
+{
+    SHARDEDITERATOR pIter;
+
+    pIter = (SHARDEDITERATOR)malloc(sizeof(*pIter));
+    pIter->pSharded = NULL;
+    pIter->pShard = NULL;
+    pIter->pIter = AllocIterator();
+    pIter->uLast.llInt = 0;
+    pIter->ucStarted = FALSE;
+    pIter->ucDirection = FORWARD;
+
+    return pIter;
+}
+
+/*
+ * Free an iterator's memory.
+ */
+void FreeShardedIterator(SHARDEDITERATOR pIter)
+{
+    FreeIterator(pIter->pIter);
+    free(pIter);
+}
+
+/*
+ * Return the index of the shard holding a key, a binary search for the
+ * last shard whose low key is not greater. The caller must hold the
+ * layout lock.
+ */
+int FindShard(KEY uKey, SHARDEDTREE pSharded)
+{
+    TREE pTree = pSharded->ppShards[0]->pTree;
+    int nLow = 1, nHigh = pSharded->nShards, nMiddle;
+
+    while (nLow < nHigh)
+    {
+        nMiddle = (nLow + nHigh) / 2;
+        if (COMPARE_KEYS(pTree, pSharded->ppShards[nMiddle]->uLow, uKey) <= 0)
+        {
+            nLow = nMiddle + 1;
+        }
+        else
+        {
+            nHigh = nMiddle;
+        }
+    }
+
+    return nLow - 1;
+}
+
+/*
+ * Search for a key and return its contents, NULL if missing. Shards
+ * whose trees restructure on lookups, like splay trees, are searched
+ * under the write lock.
+ */
+void *ShardedSearch(KEY uKey, SHARDEDTREE pSharded)
+{
+    SHARD pShard;
+    void *pContent;
+
+    pthread_rwlock_rdlock(&pSharded->sLayoutLock);
+    pShard = pSharded->ppShards[FindShard(uKey, pSharded)];
+    if (pShard->pTree->cbSearch != NULL)
+    {
+        pthread_rwlock_wrlock(&pShard->sLock);
+    }
+    else
+    {
+        pthread_rwlock_rdlock(&pShard->sLock);
+    }
+    pContent = Search(uKey, pShard->pTree);
+    pthread_rwlock_unlock(&pShard->sLock);
+    pthread_rwlock_unlock(&pSharded->sLayoutLock);
+
+    return pContent;
+}
+
+/*
+ * Insert a key into its shard, splitting the shard afterwards if it
+ * has grown too large. Returns FALSE if the key already exists.
+ */
+unsigned char ShardedInsert(KEY uKey, void *pContent, SHARDEDTREE pSharded)
+{
+    SHARD pShard;
+    unsigned char ucResponse, ucSplit;
+
+    pthread_rwlock_rdlock(&pSharded->sLayoutLock);
+    pShard = pSharded->ppShards[FindShard(uKey, pSharded)];
+    pthread_rwlock_wrlock(&pShard->sLock);
+    ucResponse = Insert(uKey, pContent, pShard->pTree);
+    ucSplit = (pSharded->nSplitSize > 0 && pShard->pTree->nSize > pSharded->nSplitSize);
+    pthread_rwlock_unlock(&pShard->sLock);
+    pthread_rwlock_unlock(&pSharded->sLayoutLock);
+
+    if (ucSplit)
+    {
+        SplitShard(uKey, pSharded);
+    }
+
+    return ucResponse;
+}
+
+/*
+ * Remove a key from its shard. Returns FALSE if the key
+ * doesn't exist.
+ */
+unsigned char ShardedRemove(KEY uKey, SHARDEDTREE pSharded)
+{
+    SHARD pShard;
+    unsigned char ucResponse;
+
+    pthread_rwlock_rdlock(&pSharded->sLayoutLock);
+    pShard = pSharded->ppShards[FindShard(uKey, pSharded)];
+    pthread_rwlock_wrlock(&pShard->sLock);
+    ucResponse = Remove(uKey, pShard->pTree);
+    pthread_rwlock_unlock(&pShard->sLock);
+    pthread_rwlock_unlock(&pSharded->sLayoutLock);
+
+    return ucResponse;
+}
+
+/*
+ * Return the number of keys across all shards. Shards are counted
+ * one at a time, so concurrent updates may or may not be included.
+ */
+int ShardedSize(SHARDEDTREE pSharded)
+{
+    int i, nSize = 0;
+
+    pthread_rwlock_rdlock(&pSharded->sLayoutLock);
+    for (i = 0; i < pSharded->nShards; i++)
+    {
+        pthread_rwlock_rdlock(&pSharded->ppShards[i]->sLock);
+        nSize += pSharded->ppShards[i]->pTree->nSize;
+        pthread_rwlock_unlock(&pSharded->ppShards[i]->sLock);
+    }
+    pthread_rwlock_unlock(&pSharded->sLayoutLock);
+
+    return nSize;
+}
+
+/*
+ * Split the shard holding a key at its middle key, if it is still too
+ * large once the layout lock is held exclusively. The shard is also
+ * locked, as iterators inside it hold no layout lock. The upper half
+ * moves into a new shard built from the sorted keys in one pass.
+ */
+void SplitShard(KEY uKey, SHARDEDTREE pSharded)
+{
+    SHARD pShard, pNew;
+    ITERATOR pIter;
+    KEY *pKeys;
+    void **ppContents;
+    int nShard, nMove, i;
+
+    pthread_rwlock_wrlock(&pSharded->sLayoutLock);
+    nShard = FindShard(uKey, pSharded);
+    pShard = pSharded->ppShards[nShard];
+    pthread_rwlock_wrlock(&pShard->sLock);
+    if (pShard->pTree->nSize <= pSharded->nSplitSize)
+    {
+        pthread_rwlock_unlock(&pShard->sLock);
+        pthread_rwlock_unlock(&pSharded->sLayoutLock);
+        return;
+    }
+
+    /* Collect the upper half in key order */
+    nMove = pShard->pTree->nSize / 2;
+    pKeys = (KEY *)malloc(sizeof(KEY) * nMove);
+    ppContents = (void **)malloc(sizeof(void *) * nMove);
+    pIter = AllocIterator();
+    pIter->ucDirection = BACKWARD;
+    Attach(pIter, pShard->pTree);
+    for (i = nMove - 1; i >= 0; i--)
+    {
+        pKeys[i] = CurrentKey(pIter);
+        ppContents[i] = Next(pIter);
+    }
+    Detach(pIter);
+    FreeIterator(pIter);
+
+    pNew = AllocShard(pSharded);
+    pNew->uLow = pKeys[0];
+    BuildFromSorted(pKeys, ppContents, nMove, pNew->pTree);
+    RemoveBatch(pKeys, nMove, NULL, pShard->pTree);
+    pthread_rwlock_unlock(&pShard->sLock);
+    free(pKeys);
+    free(ppContents);
+
+    pSharded->ppShards = (SHARD *)realloc(pSharded->ppShards, sizeof(SHARD) * (pSharded->nShards + 1));
+    for (i = pSharded->nShards; i > nShard + 1; i--)
+    {
+        pSharded->ppShards[i] = pSharded->ppShards[i - 1];
+    }
+    pSharded->ppShards[nShard + 1] = pNew;
+    pSharded->nShards++;
+
+    pthread_rwlock_unlock(&pSharded->sLayoutLock);
+}
+
+/*
+ * Attach an iterator to one end of a sharded tree depending on the
+ * direction of the iterator. Each shard stays read locked while the
+ * iterator is inside it, so updates to that shard wait, but the layout
+ * is only locked while moving between shards so shards can be split.
+ */
+void ShardedAttach(SHARDEDITERATOR pIter, SHARDEDTREE pSharded)
+{
+    pIter->pSharded = pSharded;
+    pIter->pIter->ucDirection = pIter->ucDirection;
+    pIter->ucStarted = FALSE;
+    ShardedEnter(pIter);
+}
+
+/*
+ * Return whether the iterator has run off the end of its shard.
+ */
+unsigned char ShardedExhausted(SHARDEDITERATOR pIter)
+{
+    return pIter->pIter->pNode == NULL && pIter->pIter->pCursor == NULL;
+}
+
+/*
+ * Lock and attach to the first shard in the iterator's direction with
+ * keys past the last one returned. Shards may have been split since
+ * the iterator left its last one, so the shard is found again from
+ * that key, and the iterator set past it.
+ */
+void ShardedEnter(SHARDEDITERATOR pIter)
+{
+    SHARDEDTREE pSharded = pIter->pSharded;
+    SHARD pShard;
+    int nShard, nStep = (pIter->ucDirection == FORWARD ? 1 : -1);
+
+    pthread_rwlock_rdlock(&pSharded->sLayoutLock);
+    if (pIter->ucStarted)
+    {
+        nShard = FindShard(pIter->uLast, pSharded);
+    }
+    else
+    {
+        nShard = (pIter->ucDirection == FORWARD ? 0 : pSharded->nShards - 1);
+    }
+
+    pIter->pShard = NULL;
+    for (; nShard >= 0 && nShard < pSharded->nShards; nShard += nStep)
+    {
+        pShard = pSharded->ppShards[nShard];
+        pthread_rwlock_rdlock(&pShard->sLock);
+        pthread_mutex_lock(&pShard->sAttachLock);
+        if (pIter->ucStarted)
+        {
+            AttachAt(pIter->pIter, pShard->pTree, pIter->uLast);
+            if (!ShardedExhausted(pIter) && COMPARE_KEYS(pShard->pTree, CurrentKey(pIter->pIter), pIter->uLast) == 0)
+            {
+                Next(pIter->pIter);
+            }
+        }
+        else
+        {
+            Attach(pIter->pIter, pShard->pTree);
+        }
+        pthread_mutex_unlock(&pShard->sAttachLock);
+
+        pIter->pShard = pShard;
+        if (!ShardedExhausted(pIter))
+        {
+            break;
+        }
+        ShardedLeave(pIter);
+    }
+
+    pthread_rwlock_unlock(&pSharded->sLayoutLock);
+}
+
+/*
+ * Detach from and unlock the iterator's current shard.
+ */
+void ShardedLeave(SHARDEDITERATOR pIter)
+{
+    SHARD pShard = pIter->pShard;
+
+    pthread_mutex_lock(&pShard->sAttachLock);
+    Detach(pIter->pIter);
+    pthread_mutex_unlock(&pShard->sAttachLock);
+    pthread_rwlock_unlock(&pShard->sLock);
+    pIter->pShard = NULL;
+}
+
+/*
+ * Move the iterator on to the next shard in its direction once
+ * its current shard is exhausted.
+ */
+void ShardedSkip(SHARDEDITERATOR pIter)
+{
+    if (pIter->pShard != NULL && ShardedExhausted(pIter))
+    {
+        ShardedLeave(pIter);
+        ShardedEnter(pIter);
+    }
+}
+
+/*
+ * Return the contents of the current location of the iterator and
+ * advance it, crossing into the next shard when needed.
+ */
+void *ShardedNext(SHARDEDITERATOR pIter)
+{
+    void *pContent;
+
+    if (pIter->pShard == NULL)
+    {
+        return NULL;
+    }
+
+    pIter->uLast = CurrentKey(pIter->pIter);
+    pIter->ucStarted = TRUE;
+    pContent = Next(pIter->pIter);
+    ShardedSkip(pIter);
+
+    return pContent;
+}
+
+/*
+ * Return the key of the current location of the iterator.
+ * The key is zeroed if the iterator is past its end.
+ */
+KEY ShardedCurrentKey(SHARDEDITERATOR pIter)
+{
+    return CurrentKey(pIter->pIter);
+}
+
+/*
+ * Detach the iterator, releasing every lock it holds.
+ */
+void ShardedDetach(SHARDEDITERATOR pIter)
+{
+    if (pIter->pSharded == NULL)
+    {
+        return;
+    }
+
+    if (pIter->pShard != NULL)
+    {
+        ShardedLeave(pIter);
+    }
+    pIter->pSharded = NULL;
+}
\ No newline at end of file
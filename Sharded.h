@@ -0,0 +1,78 @@
+/*
+ * Concurrent container partitioning the key space across several trees,
+ * each guarded by its own lock, so operations on different key ranges
+ * can run in parallel.
+ *
+ * An attached iterator keeps the shard it is in read locked, so the
+ * thread holding it must not insert into or remove from the sharded
+ * tree before detaching it: an update to that shard would wait on the
+ * thread's own lock.
+ *
+ * Adam Doyle
+ */
+
+#ifndef __SHARDED_H__
+#define __SHARDED_H__
+
+#include <pthread.h>
+
+#include "BinarySearchTree.h"
+
+
+/* Allocates the tree of a new shard, e.g. AVLAllocTree */
+typedef TREE (*AllocShardCallback)(int nFlags);
+
+/* Represents one key range of a sharded tree */
+typedef struct Shard
+{
+    TREE pTree;
+    KEY uLow; /* Smallest key the shard holds, unused for the first shard */
+    pthread_rwlock_t sLock; /* Held shared for reads and iteration, exclusively for updates and splits */
+    pthread_mutex_t sAttachLock; /* Serializes iterators attaching to and detaching from pTree */
+} *SHARD;
+
+/* Represents a tree split into shards by key range */
+typedef struct ShardedTree
+{
+    SHARD *ppShards; /* Shards ordered by key range */
+    int nShards;
+    int nSplitSize; /* Shards growing past this many keys are split in two, 0 to never split */
+    int nFlags; /* Flags each shard's tree is created with */
+    int nKeyType;
+    CompareCallback cbCompare;
+    AllocShardCallback cbAllocShard;
+    pthread_rwlock_t sLayoutLock; /* Held shared while finding a shard, exclusively while splitting */
+} *SHARDEDTREE;
+
+/* Represents an iterator visiting every shard in key order */
+typedef struct ShardedIterator
+{
+    SHARDEDTREE pSharded;
+    SHARD pShard; /* Shard currently attached, NULL if past the end */
+    ITERATOR pIter;
+    KEY uLast; /* Last key returned, the next shard is found from it */
+    unsigned char ucStarted; /* Whether uLast is set */
+    unsigned char ucDirection;
+} *SHARDEDITERATOR;
+
+
+/* Memory management */
+SHARDEDTREE AllocShardedTree(AllocShardCallback cbAllocShard, int nFlags, KEY *pSplits, int nSplits, int nSplitSize);
+void SetShardedKeyType(SHARDEDTREE pSharded, int nKeyType, CompareCallback cbCompare);
+void FreeShardedTree(SHARDEDTREE pSharded);
+SHARDEDITERATOR AllocShardedIterator(void);
+void FreeShardedIterator(SHARDEDITERATOR pIter);
+
+/* Basic operations, safe to call from any thread */
+void *ShardedSearch(KEY uKey, SHARDEDTREE pSharded);
+unsigned char ShardedInsert(KEY uKey, void *pContent, SHARDEDTREE pSharded);
+unsigned char ShardedRemove(KEY uKey, SHARDEDTREE pSharded);
+int ShardedSize(SHARDEDTREE pSharded);
+
+/* Iterator operations, an iterator itself belongs to a single thread */
+void ShardedAttach(SHARDEDITERATOR pIter, SHARDEDTREE pSharded);
+void *ShardedNext(SHARDEDITERATOR pIter);
+KEY ShardedCurrentKey(SHARDEDITERATOR pIter);
+void ShardedDetach(SHARDEDITERATOR pIter);
+
+#endif /* __SHARDED_H__ */
\ No newline at end of file
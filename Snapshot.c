@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "BinarySearchTree.h"
+#include "Snapshot.h"
+
+/* Method predeclarations */
+void SnapshotFill(SNAPSHOT pSnapshot, ITERATOR pIter, int nIndex);
+int SnapshotResolve(int nIndex);
+
+/* Branch-free descent of the implicit tree, leaving in nIndex the last
+ * node whose key was not less than uKey (shifted into bits still to be
+ * resolved). ADDRESS is the array prefetched ahead. */
+#define DESCEND_LOOP(LESS, ADDRESS) \
+    while (nIndex <= pSnapshot->nSize) \
+    { \
+        PREFETCH(ADDRESS + (nIndex << SNAPSHOT_PREFETCH_LEVELS)); \
+        nIndex = 2 * nIndex + (LESS); \
+    }
+
+/*
+ * Copy every entry of a tree into a new snapshot, in Eytzinger order.
+ * The tree is left untouched and may change afterwards without
+ * affecting the snapshot.
+ */
+SNAPSHOT Freeze(TREE pTree)
+{
+    SNAPSHOT pSnapshot;
+    ITERATOR pIter;
+    size_t nKeyBytes, nKeysSize;
+    char *pAligned;
+
+    switch (pTree->nKeyType)
+    {
+    case KEY_INT:
+        nKeyBytes = sizeof(int);
+        break;
+    case KEY_INT64:
+        nKeyBytes = sizeof(long long);
+        break;
+    default:
+        nKeyBytes = sizeof(KEY);
+        break;
+    }
+
+    pSnapshot = (SNAPSHOT)malloc(sizeof(*pSnapshot));
+    pSnapshot->nSize = pTree->nSize;
+    pSnapshot->nKeyType = pTree->nKeyType;
+    pSnapshot->cbCompare = pTree->cbCompare;
+
+    /* Keys first, aligned to a cache line, then the contents */
+    nKeysSize = (nKeyBytes * (pTree->nSize + 1) + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+    pSnapshot->pBlock = malloc(SNAPSHOT_ALIGN + nKeysSize + sizeof(void *) * (pTree->nSize + 1));
+    pAligned = (char *)pSnapshot->pBlock + SNAPSHOT_ALIGN - (size_t)pSnapshot->pBlock % SNAPSHOT_ALIGN;
+    pSnapshot->u.pKeys = (KEY *)pAligned;
+    pSnapshot->pContents = (void **)(pAligned + nKeysSize);
+
+    pIter = AllocIterator();
+    Attach(pIter, pTree);
+    SnapshotFill(pSnapshot, pIter, 1);
+    Detach(pIter);
+    FreeIterator(pIter);
+
+    return pSnapshot;
+}
+
+/*
+ * Free a snapshot. The contents it references are not freed.
+ */
+void FreeSnapshot(SNAPSHOT pSnapshot)
+{
+    free(pSnapshot->pBlock);
+    free(pSnapshot);
+}
+
+/*
+ * Fill the implicit subtree rooted at nIndex from an in-order
+ * iterator, consuming one entry per index.
+ */
+void SnapshotFill(SNAPSHOT pSnapshot, ITERATOR pIter, int nIndex)
+{
+    KEY uKey;
+
+    if (nIndex > pSnapshot->nSize)
+    {
+        return;
+    }
+
+    SnapshotFill(pSnapshot, pIter, 2 * nIndex);
+
+    uKey = CurrentKey(pIter);
+    switch (pSnapshot->nKeyType)
+    {
+    case KEY_INT:
+        pSnapshot->u.pInts[nIndex] = uKey.nInt;
+        break;
+    case KEY_INT64:
+        pSnapshot->u.pInt64s[nIndex] = uKey.llInt;
+        break;
+    default:
+        pSnapshot->u.pKeys[nIndex] = uKey;
+        break;
+    }
+    pSnapshot->pContents[nIndex] = Next(pIter);
+
+    SnapshotFill(pSnapshot, pIter, 2 * nIndex + 1);
+}
+
+/*
+ * Recover the index a descent last went left at. Every right turn
+ * appended a one bit, so dropping the trailing ones and the final
+ * left turn's zero leaves the candidate, 0 if there is none.
+ */
+int SnapshotResolve(int nIndex)
+{
+    while (nIndex & 1)
+    {
+        nIndex >>= 1;
+    }
+    return nIndex >> 1;
+}
+
+/*
+ * Return the contents stored for a key, NULL if missing. The descent
+ * never branches on a comparison and prefetches the cache line holding
+ * the node's descendants several levels down.
+ */
+void *SnapshotSearch(KEY uKey, SNAPSHOT pSnapshot)
+{
+    int nIndex = 1;
+
+    switch (pSnapshot->nKeyType)
+    {
+    case KEY_INT:
+        DESCEND_LOOP(pSnapshot->u.pInts[nIndex] < uKey.nInt, pSnapshot->u.pInts);
+        nIndex = SnapshotResolve(nIndex);
+        if (nIndex != 0 && pSnapshot->u.pInts[nIndex] == uKey.nInt)
+        {
+            return pSnapshot->pContents[nIndex];
+        }
+        break;
+    case KEY_INT64:
+        DESCEND_LOOP(pSnapshot->u.pInt64s[nIndex] < uKey.llInt, pSnapshot->u.pInt64s);
+        nIndex = SnapshotResolve(nIndex);
+        if (nIndex != 0 && pSnapshot->u.pInt64s[nIndex] == uKey.llInt)
+        {
+            return pSnapshot->pContents[nIndex];
+        }
+        break;
+    case KEY_STRING:
+        DESCEND_LOOP(strcmp(pSnapshot->u.pKeys[nIndex].szString, uKey.szString) < 0, pSnapshot->u.pKeys);
+        nIndex = SnapshotResolve(nIndex);
+        if (nIndex != 0 && strcmp(pSnapshot->u.pKeys[nIndex].szString, uKey.szString) == 0)
+        {
+            return pSnapshot->pContents[nIndex];
+        }
+        break;
+    default:
+        DESCEND_LOOP(pSnapshot->cbCompare(pSnapshot->u.pKeys[nIndex], uKey) < 0, pSnapshot->u.pKeys);
+        nIndex = SnapshotResolve(nIndex);
+        if (nIndex != 0 && pSnapshot->cbCompare(pSnapshot->u.pKeys[nIndex], uKey) == 0)
+        {
+            return pSnapshot->pContents[nIndex];
+        }
+        break;
+    }
+
+    return NULL;
+}
\ No newline at end of file
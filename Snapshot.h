@@ -0,0 +1,50 @@
+/*
+ * Immutable, read optimized snapshot of a tree. The entries are laid out
+ * in Eytzinger (breadth first) order in a single array so a lookup walks
+ * down an implicit tree with no pointers to chase.
+ *
+ * Adam Doyle
+ */
+
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include "BinarySearchTree.h"
+
+
+/* Alignment of the key array, so each group of descendants shares a cache line */
+#define SNAPSHOT_ALIGN 64
+
+/* Number of levels a lookup prefetches ahead, four levels of int keys fill one cache line */
+#define SNAPSHOT_PREFETCH_LEVELS 4
+
+
+/*
+ * Represents a frozen copy of a tree. Index 0 of every array is unused so
+ * the children of entry k are entries 2k and 2k + 1. Keys are packed by
+ * type, integer keys without the padding of a KEY union.
+ */
+typedef struct Snapshot
+{
+    int nSize;
+    int nKeyType; /* Key type of the tree the snapshot was taken from */
+    CompareCallback cbCompare;
+    union
+    {
+        int *pInts; /* KEY_INT */
+        long long *pInt64s; /* KEY_INT64 */
+        KEY *pKeys; /* KEY_STRING and KEY_CUSTOM */
+    } u;
+    void **pContents;
+    void *pBlock; /* Single allocation holding both arrays */
+} *SNAPSHOT;
+
+
+/* Memory management */
+SNAPSHOT Freeze(TREE pTree);
+void FreeSnapshot(SNAPSHOT pSnapshot);
+
+/* Snapshot operations */
+void *SnapshotSearch(KEY uKey, SNAPSHOT pSnapshot);
+
+#endif /* __SNAPSHOT_H__ */
\ No newline at end of file
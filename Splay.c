@@ -0,0 +1,123 @@
+#include <stdlib.h>
+
+#include "BinarySearchTree.h"
+#include "Splay.h"
+
+/* Method predeclarations */
+void *SplayAllocTreeAux(TREE pTree);
+void SplayFreeTree(TREE pTree);
+void SplayAccess(NODE pNode);
+void SplayNode(NODE pNode, int nMode);
+NODE SplayRotate(NODE pNode, unsigned char ucLeft);
+
+/*
+ * Prepare a new splay tree's options.
+ */
+void *SplayAllocTreeAux(TREE pTree)
+{
+    SPLAYTREE pSplay = (SPLAYTREE)malloc(sizeof(*pSplay));
+
+    pSplay->nMode = SPLAY_FULL;
+    pSplay->nPeriod = 1;
+    pSplay->nAccesses = 0;
+    return pSplay;
+}
+
+/*
+ * Release a splay tree's options.
+ */
+void SplayFreeTree(TREE pTree)
+{
+    free(pTree->pAuxiliary);
+    pTree->pAuxiliary = NULL;
+}
+
+/*
+ * Allocate a new tree and establish the appropriate callbacks.
+ * nFlags is a combination of the TREE_* creation flags.
+ */
+TREE SplayAllocTree(int nFlags)
+{
+    TREE pTree = AllocTree(SplayAllocTreeAux, nFlags);
+    pTree->cbFreeTree = SplayFreeTree;
+    pTree->cbInsert = SplayAccess;
+    pTree->cbSearch = SplayAccess;
+    return pTree;
+}
+
+/*
+ * Change how a splay tree splays. Semi-splaying and splaying less often
+ * both trade some adaptation for fewer rotations, i.e. fewer writes.
+ */
+void SplaySetOptions(TREE pTree, int nMode, int nPeriod)
+{
+    SPLAYTREE pSplay = SPLAY_DATA(pTree);
+
+    pSplay->nMode = nMode;
+    pSplay->nPeriod = nPeriod > 1 ? nPeriod : 1;
+    pSplay->nAccesses = 0;
+}
+
+/*
+ * Splay a node that was just found or inserted, if this access is one
+ * the tree's period asks for.
+ */
+void SplayAccess(NODE pNode)
+{
+    SPLAYTREE pSplay = SPLAY_DATA(pNode->pTree);
+
+    if (++pSplay->nAccesses < pSplay->nPeriod)
+    {
+        return;
+    }
+    pSplay->nAccesses = 0;
+    TREE_STAT(pNode->pTree, nRetraces, 1);
+    SplayNode(pNode, pSplay->nMode);
+}
+
+/*
+ * Rotate a node up to the root. A semi-splay rotates only the parent
+ * over the grandparent when both lie on the same side, then carries on
+ * from the parent, which roughly halves the node's depth instead.
+ */
+void SplayNode(NODE pNode, int nMode)
+{
+    NODE pParent, pGrandparent;
+    unsigned char ucLeft;
+
+    while (pNode != NULL && pNode->pParent != NULL)
+    {
+        TREE_STAT(pNode->pTree, nRetraceSteps, 1);
+        pParent = pNode->pParent;
+        pGrandparent = pParent->pParent;
+        ucLeft = (pParent->pLeftChild == pNode);
+
+        if (pGrandparent == NULL) /* zig */
+        {
+            SplayRotate(pParent, ucLeft);
+        }
+        else if (ucLeft == (pGrandparent->pLeftChild == pParent)) /* zig-zig */
+        {
+            SplayRotate(pGrandparent, ucLeft);
+            if (nMode == SPLAY_SEMI)
+            {
+                pNode = pParent;
+                continue;
+            }
+            SplayRotate(pParent, ucLeft);
+        }
+        else /* zig-zag */
+        {
+            SplayRotate(pParent, ucLeft);
+            SplayRotate(pGrandparent, !ucLeft);
+        }
+    }
+}
+
+/*
+ * Rotate a node's left (if ucLeft) or right child up over it.
+ */
+NODE SplayRotate(NODE pNode, unsigned char ucLeft)
+{
+    return ucLeft ? RightRotation(pNode) : LeftRotation(pNode);
+}
\ No newline at end of file
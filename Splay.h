@@ -0,0 +1,40 @@
+/*
+ * Implementation of a splay tree as an extension to BinarySearchTree.
+ * Found and inserted nodes are rotated towards the root, so frequently
+ * accessed keys stay near the top, whether they are found by Search,
+ * SearchBatch, LowerBound or UpperBound. As these lookups restructure
+ * the tree, a splay tree must not be searched by several threads at once.
+ *
+ * Adam Doyle
+ */
+
+#ifndef __SPLAY_H__
+#define __SPLAY_H__
+
+#include "BinarySearchTree.h"
+
+
+/* Splay modes */
+#define SPLAY_FULL 0 /* Splay accessed nodes all the way to the root */
+#define SPLAY_SEMI 1 /* Semi-splay, halving the path to the node instead */
+
+
+/* Represents the splaying options of a tree */
+typedef struct SplayTree
+{
+    int nMode; /* One of the SPLAY_* modes */
+    int nPeriod; /* Splay only every nPeriod-th access */
+    int nAccesses; /* Accesses since the last splay */
+} *SPLAYTREE;
+
+/* Access the splay data of a tree */
+#define SPLAY_DATA(pTree) ((SPLAYTREE)(pTree)->pAuxiliary)
+
+
+/* Allocate splay tree, splaying fully on every access */
+TREE SplayAllocTree(int nFlags);
+
+/* Change how a splay tree splays, nPeriod being at least 1 */
+void SplaySetOptions(TREE pTree, int nMode, int nPeriod);
+
+#endif /* __SPLAY_H__ */
\ No newline at end of file
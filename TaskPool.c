@@ -0,0 +1,253 @@
+#include <stdlib.h>
+#include <sched.h>
+
+#include "TaskPool.h"
+
+/* Method predeclarations */
+void *TaskMain(void *pArgument);
+TASK TaskTake(TASKWORKER pWorker);
+TASK TaskSteal(TASKWORKER pWorker);
+void TaskRun(TASKWORKER pWorker, TASK pTask);
+void TaskTaken(TASKPOOL pPool);
+
+/*
+ * Allocate a pool and start its worker threads. The thread calling
+ * TaskPoolRun takes part as well, so nThreads may be 0.
+ */
+TASKPOOL AllocTaskPool(int nThreads)
+{
+    TASKPOOL pPool;
+    int i;
+
+    pPool = (TASKPOOL)malloc(sizeof(*pPool));
+    pPool->nThreads = nThreads;
+    pPool->nPending = 0;
+    pPool->ucStop = 0;
+    pthread_mutex_init(&pPool->sLock, NULL);
+    pthread_cond_init(&pPool->sWake, NULL);
+    pthread_mutex_init(&pPool->sRunLock, NULL);
+
+    pPool->pWorkers = (TASKWORKER)malloc(sizeof(struct TaskWorker) * (nThreads + 1));
+    for (i = 0; i <= nThreads; i++)
+    {
+        pPool->pWorkers[i].pPool = pPool;
+        pPool->pWorkers[i].nIndex = i;
+        pPool->pWorkers[i].nTop = 0;
+        pPool->pWorkers[i].nBottom = 0;
+        pthread_mutex_init(&pPool->pWorkers[i].sLock, NULL);
+    }
+    for (i = 0; i < nThreads; i++)
+    {
+        pthread_create(&pPool->pWorkers[i].sThread, NULL, TaskMain, &pPool->pWorkers[i]);
+    }
+
+    return pPool;
+}
+
+/*
+ * Stop the pool's threads and free it. No task may be running.
+ */
+void FreeTaskPool(TASKPOOL pPool)
+{
+    int i;
+
+    pthread_mutex_lock(&pPool->sLock);
+    pPool->ucStop = 1;
+    pthread_cond_broadcast(&pPool->sWake);
+    pthread_mutex_unlock(&pPool->sLock);
+
+    for (i = 0; i < pPool->nThreads; i++)
+    {
+        pthread_join(pPool->pWorkers[i].sThread, NULL);
+    }
+    for (i = 0; i <= pPool->nThreads; i++)
+    {
+        pthread_mutex_destroy(&pPool->pWorkers[i].sLock);
+    }
+
+    pthread_mutex_destroy(&pPool->sLock);
+    pthread_cond_destroy(&pPool->sWake);
+    pthread_mutex_destroy(&pPool->sRunLock);
+    free(pPool->pWorkers);
+    free(pPool);
+}
+
+/*
+ * Body of every worker thread: run tasks while there are any,
+ * sleeping until one is spawned otherwise.
+ */
+void *TaskMain(void *pArgument)
+{
+    TASKWORKER pWorker = (TASKWORKER)pArgument;
+    TASKPOOL pPool = pWorker->pPool;
+    TASK pTask;
+
+    while (1)
+    {
+        pTask = TaskTake(pWorker);
+        if (pTask == NULL)
+        {
+            pTask = TaskSteal(pWorker);
+        }
+        if (pTask != NULL)
+        {
+            TaskRun(pWorker, pTask);
+            continue;
+        }
+
+        pthread_mutex_lock(&pPool->sLock);
+        while (pPool->nPending == 0 && !pPool->ucStop)
+        {
+            pthread_cond_wait(&pPool->sWake, &pPool->sLock);
+        }
+        if (pPool->ucStop)
+        {
+            pthread_mutex_unlock(&pPool->sLock);
+            return NULL;
+        }
+        pthread_mutex_unlock(&pPool->sLock);
+    }
+}
+
+/*
+ * Run a task on the calling thread, letting the pool's workers
+ * steal any tasks it spawns. Returns once the task has finished.
+ */
+void TaskPoolRun(TASKPOOL pPool, TaskCallback cbRun, void *pArgument)
+{
+    pthread_mutex_lock(&pPool->sRunLock);
+    cbRun(&pPool->pWorkers[pPool->nThreads], pArgument);
+    pthread_mutex_unlock(&pPool->sRunLock);
+}
+
+/*
+ * Spawn a task on a worker's deque for it or a thief to run. With no
+ * worker, or a full deque, the task runs immediately instead.
+ */
+void TaskSpawn(TASKWORKER pWorker, TASK pTask, TaskCallback cbRun, void *pArgument)
+{
+    TASKPOOL pPool;
+
+    pTask->cbRun = cbRun;
+    pTask->pArgument = pArgument;
+    pTask->nDone = 0;
+    if (pWorker == NULL)
+    {
+        TaskRun(pWorker, pTask);
+        return;
+    }
+
+    pthread_mutex_lock(&pWorker->sLock);
+    if (pWorker->nBottom - pWorker->nTop == TASKPOOL_DEQUE_SIZE)
+    {
+        pthread_mutex_unlock(&pWorker->sLock);
+        TaskRun(pWorker, pTask);
+        return;
+    }
+    pWorker->ppTasks[pWorker->nBottom % TASKPOOL_DEQUE_SIZE] = pTask;
+    pWorker->nBottom++;
+    pthread_mutex_unlock(&pWorker->sLock);
+
+    pPool = pWorker->pPool;
+    pthread_mutex_lock(&pPool->sLock);
+    pPool->nPending++;
+    pthread_cond_signal(&pPool->sWake);
+    pthread_mutex_unlock(&pPool->sLock);
+}
+
+/*
+ * Wait for a spawned task to finish, running other tasks meanwhile
+ * (usually the awaited task itself, if nobody stole it).
+ */
+void TaskWait(TASKWORKER pWorker, TASK pTask)
+{
+    TASK pOther;
+
+    while (!__atomic_load_n(&pTask->nDone, __ATOMIC_ACQUIRE))
+    {
+        pOther = TaskTake(pWorker);
+        if (pOther == NULL)
+        {
+            pOther = TaskSteal(pWorker);
+        }
+        if (pOther != NULL)
+        {
+            TaskRun(pWorker, pOther);
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+}
+
+/*
+ * Take the newest task from a worker's own deque, NULL if empty.
+ */
+TASK TaskTake(TASKWORKER pWorker)
+{
+    TASK pTask = NULL;
+
+    pthread_mutex_lock(&pWorker->sLock);
+    if (pWorker->nBottom > pWorker->nTop)
+    {
+        pWorker->nBottom--;
+        pTask = pWorker->ppTasks[pWorker->nBottom % TASKPOOL_DEQUE_SIZE];
+    }
+    pthread_mutex_unlock(&pWorker->sLock);
+
+    if (pTask != NULL)
+    {
+        TaskTaken(pWorker->pPool);
+    }
+    return pTask;
+}
+
+/*
+ * Take the oldest task from another worker's deque, trying each
+ * worker in turn. Returns NULL if every deque is empty.
+ */
+TASK TaskSteal(TASKWORKER pWorker)
+{
+    TASKPOOL pPool = pWorker->pPool;
+    TASKWORKER pVictim;
+    TASK pTask = NULL;
+    int i;
+
+    for (i = 1; i <= pPool->nThreads && pTask == NULL; i++)
+    {
+        pVictim = &pPool->pWorkers[(pWorker->nIndex + i) % (pPool->nThreads + 1)];
+        pthread_mutex_lock(&pVictim->sLock);
+        if (pVictim->nBottom > pVictim->nTop)
+        {
+            pTask = pVictim->ppTasks[pVictim->nTop % TASKPOOL_DEQUE_SIZE];
+            pVictim->nTop++;
+        }
+        pthread_mutex_unlock(&pVictim->sLock);
+    }
+
+    if (pTask != NULL)
+    {
+        TaskTaken(pPool);
+    }
+    return pTask;
+}
+
+/*
+ * Run a task and mark it as done for its waiter.
+ */
+void TaskRun(TASKWORKER pWorker, TASK pTask)
+{
+    pTask->cbRun(pWorker, pTask->pArgument);
+    __atomic_store_n(&pTask->nDone, 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Record that a task has left the deques.
+ */
+void TaskTaken(TASKPOOL pPool)
+{
+    pthread_mutex_lock(&pPool->sLock);
+    pPool->nPending--;
+    pthread_mutex_unlock(&pPool->sLock);
+}
\ No newline at end of file
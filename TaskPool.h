@@ -0,0 +1,67 @@
+/*
+ * Small fork/join thread pool. Every worker keeps a deque of spawned
+ * tasks, working on its newest task first, and idle workers steal the
+ * oldest task of another worker.
+ *
+ * Adam Doyle
+ */
+
+#ifndef __TASKPOOL_H__
+#define __TASKPOOL_H__
+
+#include <pthread.h>
+
+
+/* Maximum number of tasks waiting in one worker's deque, further spawns run immediately */
+#define TASKPOOL_DEQUE_SIZE 256
+
+
+/* Predeclarations */
+struct TaskWorker;
+
+/* Runs a task on the given worker, which it may use to spawn further tasks */
+typedef void (*TaskCallback)(struct TaskWorker *pWorker, void *pArgument);
+
+/* Represents a spawned task, owned by the spawner until waited on */
+typedef struct Task
+{
+    TaskCallback cbRun;
+    void *pArgument;
+    int nDone; /* Set once the task has run */
+} *TASK;
+
+/* Represents one thread taking part in running tasks */
+typedef struct TaskWorker
+{
+    struct TaskPool *pPool;
+    int nIndex;
+    TASK ppTasks[TASKPOOL_DEQUE_SIZE]; /* Circular deque, owner end at nBottom */
+    int nTop; /* Oldest task, taken by thieves */
+    int nBottom; /* One past the newest task, taken by the owner */
+    pthread_mutex_t sLock; /* Guards the deque */
+    pthread_t sThread;
+} *TASKWORKER;
+
+/* Represents a pool of worker threads */
+typedef struct TaskPool
+{
+    int nThreads;
+    struct TaskWorker *pWorkers; /* nThreads workers, then one for the thread calling TaskPoolRun */
+    int nPending; /* Number of tasks waiting in any deque */
+    unsigned char ucStop;
+    pthread_mutex_t sLock; /* Guards nPending and ucStop */
+    pthread_cond_t sWake; /* Signalled when a task is spawned or the pool stops */
+    pthread_mutex_t sRunLock; /* Serializes callers of TaskPoolRun */
+} *TASKPOOL;
+
+
+/* Memory management */
+TASKPOOL AllocTaskPool(int nThreads);
+void FreeTaskPool(TASKPOOL pPool);
+
+/* Task operations */
+void TaskPoolRun(TASKPOOL pPool, TaskCallback cbRun, void *pArgument);
+void TaskSpawn(TASKWORKER pWorker, TASK pTask, TaskCallback cbRun, void *pArgument);
+void TaskWait(TASKWORKER pWorker, TASK pTask);
+
+#endif /* __TASKPOOL_H__ */
\ No newline at end of file
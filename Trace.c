@@ -0,0 +1,358 @@
+/* mmap and open are POSIX, hidden by strict ISO C modes */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "BinarySearchTree.h"
+#include "Trace.h"
+
+/* Method predeclarations */
+/* Recording */
+int TraceIterator(TRACEWRITER pWriter, int nEvent, ITERATOR pIter);
+void TraceWriteKey(TRACEWRITER pWriter, KEY uKey);
+
+/* Reading */
+unsigned char TraceReadEvent(TRACEREADER pReader, TRACEEVENT pEvent);
+unsigned char TraceReadKey(TRACEREADER pReader, KEY *pKey);
+
+/*
+ * Start recording every operation on a tree with integer keys into a new
+ * trace file. Events of iterators attached before the trace started are
+ * not recorded. Returns FALSE if tracing wasn't compiled in (see
+ * TREE_TRACE), the tree is already traced, its keys aren't integers or
+ * the file can't be created.
+ */
+unsigned char StartTrace(TREE pTree, const char *szPath)
+{
+#ifdef TREE_TRACE
+    struct TraceHeader sHeader;
+    TRACEWRITER pWriter;
+    FILE *pFile;
+
+    if (pTree->pTrace != NULL || (pTree->nKeyType != KEY_INT && pTree->nKeyType != KEY_INT64))
+    {
+        return FALSE;
+    }
+
+    pFile = fopen(szPath, "wb");
+    if (pFile == NULL)
+    {
+        return FALSE;
+    }
+
+    pWriter = (TRACEWRITER)calloc(1, sizeof(*pWriter));
+    pWriter->pFile = pFile;
+    pWriter->pBuffer = (char *)malloc(TRACE_BUFFER_SIZE);
+    setvbuf(pFile, pWriter->pBuffer, _IOFBF, TRACE_BUFFER_SIZE);
+    pWriter->nKeyType = pTree->nKeyType;
+    pthread_mutex_init(&pWriter->sLock, NULL);
+
+    memset(&sHeader, 0, sizeof(sHeader));
+    memcpy(sHeader.szMagic, TRACE_MAGIC, sizeof(sHeader.szMagic));
+    sHeader.nVersion = TRACE_VERSION;
+    sHeader.nKeyType = pTree->nKeyType;
+    fwrite(&sHeader, sizeof(sHeader), 1, pFile);
+
+    pTree->pTrace = pWriter;
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+/*
+ * Stop recording a tree's operations, closing its trace. Called by
+ * FreeTree for trees still being traced. Returns FALSE if the tree
+ * wasn't traced or writing the trace failed.
+ */
+unsigned char StopTrace(TREE pTree)
+{
+#ifdef TREE_TRACE
+    TRACEWRITER pWriter = pTree->pTrace;
+    unsigned char ucResult;
+
+    if (pWriter == NULL)
+    {
+        return FALSE;
+    }
+
+    pTree->pTrace = NULL;
+    ucResult = !ferror(pWriter->pFile);
+    if (fclose(pWriter->pFile) != 0)
+    {
+        ucResult = FALSE;
+    }
+    pthread_mutex_destroy(&pWriter->sLock);
+    free(pWriter->pBuffer);
+    free(pWriter);
+    return ucResult;
+#else
+    return FALSE;
+#endif
+}
+
+/*
+ * Append an event to a trace. Iterators are numbered while attached;
+ * events of iterators with no number (attached before the trace started,
+ * or beyond TRACE_MAX_ITERATORS) are dropped.
+ */
+void TraceRecord(TRACEWRITER pWriter, int nEvent, ITERATOR pIter, KEY uFirst, KEY uSecond)
+{
+    int nIterator = -1, nByte = nEvent;
+
+    pthread_mutex_lock(&pWriter->sLock);
+
+    if (nEvent >= TRACE_ATTACH)
+    {
+        nIterator = TraceIterator(pWriter, nEvent, pIter);
+        if (nIterator < 0)
+        {
+            pthread_mutex_unlock(&pWriter->sLock);
+            return;
+        }
+        if (nEvent <= TRACE_ATTACH_RANGE && pIter->ucDirection == BACKWARD)
+        {
+            nByte |= TRACE_BACKWARD;
+        }
+    }
+
+    putc(nByte, pWriter->pFile);
+    if (nIterator >= 0)
+    {
+        putc(nIterator, pWriter->pFile);
+    }
+    if (nEvent <= TRACE_REMOVE || nEvent == TRACE_ATTACH_AT || nEvent == TRACE_ATTACH_RANGE)
+    {
+        TraceWriteKey(pWriter, uFirst);
+    }
+    if (nEvent == TRACE_ATTACH_RANGE)
+    {
+        TraceWriteKey(pWriter, uSecond);
+    }
+    pWriter->nEvents++;
+
+    pthread_mutex_unlock(&pWriter->sLock);
+}
+
+/*
+ * Append one search, insert or remove event per key to a trace, the way
+ * batch operations are recorded.
+ */
+void TraceRecordKeys(TRACEWRITER pWriter, int nEvent, KEY *pKeys, int nCount)
+{
+    int i;
+
+    pthread_mutex_lock(&pWriter->sLock);
+    for (i = 0; i < nCount; i++)
+    {
+        putc(nEvent, pWriter->pFile);
+        TraceWriteKey(pWriter, pKeys[i]);
+    }
+    pWriter->nEvents += nCount > 0 ? nCount : 0;
+    pthread_mutex_unlock(&pWriter->sLock);
+}
+
+/*
+ * Return the number of an iterator for an iterator event, -1 if it has
+ * none. Attaching numbers the iterator and detaching frees its number.
+ */
+int TraceIterator(TRACEWRITER pWriter, int nEvent, ITERATOR pIter)
+{
+    int i, nFree = -1;
+
+    for (i = 0; i < TRACE_MAX_ITERATORS; i++)
+    {
+        if (pWriter->pIterators[i] == pIter)
+        {
+            if (nEvent == TRACE_DETACH)
+            {
+                pWriter->pIterators[i] = NULL;
+            }
+            return i;
+        }
+        if (pWriter->pIterators[i] == NULL && nFree < 0)
+        {
+            nFree = i;
+        }
+    }
+
+    if (nEvent <= TRACE_ATTACH_RANGE && nFree >= 0)
+    {
+        pWriter->pIterators[nFree] = pIter;
+    }
+    return nEvent <= TRACE_ATTACH_RANGE ? nFree : -1;
+}
+
+/*
+ * Write a key as the zigzag encoded difference from the previous key,
+ * 7 bits per byte with the high bit set on all but the last byte.
+ */
+void TraceWriteKey(TRACEWRITER pWriter, KEY uKey)
+{
+    long long llKey = (pWriter->nKeyType == KEY_INT ? uKey.nInt : uKey.llInt);
+    unsigned long long llDelta = (unsigned long long)llKey - (unsigned long long)pWriter->llPrevious;
+    unsigned long long llZigzag = (llDelta << 1) ^ (0 - (llDelta >> 63));
+
+    while (llZigzag >= 0x80)
+    {
+        putc((int)(llZigzag & 0x7f) | 0x80, pWriter->pFile);
+        llZigzag >>= 7;
+    }
+    putc((int)llZigzag, pWriter->pFile);
+    pWriter->llPrevious = llKey;
+}
+
+/*
+ * Map a trace for reading, NULL if it can't be read or is not a trace
+ * of this version.
+ */
+TRACEREADER OpenTrace(const char *szPath)
+{
+    struct stat sStat;
+    TRACEREADER pReader;
+    void *pMapping;
+    int nFile;
+
+    nFile = open(szPath, O_RDONLY);
+    if (nFile < 0)
+    {
+        return NULL;
+    }
+    if (fstat(nFile, &sStat) != 0 || (size_t)sStat.st_size < sizeof(struct TraceHeader))
+    {
+        close(nFile);
+        return NULL;
+    }
+    pMapping = mmap(NULL, sStat.st_size, PROT_READ, MAP_PRIVATE, nFile, 0);
+    close(nFile);
+    if (pMapping == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    pReader = (TRACEREADER)malloc(sizeof(*pReader));
+    memcpy(&pReader->sHeader, pMapping, sizeof(pReader->sHeader));
+    pReader->pData = (unsigned char *)pMapping;
+    pReader->nSize = sStat.st_size;
+    pReader->nOffset = sizeof(struct TraceHeader);
+    pReader->llPrevious = 0;
+
+    if (memcmp(pReader->sHeader.szMagic, TRACE_MAGIC, sizeof(pReader->sHeader.szMagic)) != 0 ||
+        pReader->sHeader.nVersion != TRACE_VERSION ||
+        (pReader->sHeader.nKeyType != KEY_INT && pReader->sHeader.nKeyType != KEY_INT64))
+    {
+        CloseTrace(pReader);
+        return NULL;
+    }
+    return pReader;
+}
+
+/*
+ * Unmap a trace and free the reader.
+ */
+void CloseTrace(TRACEREADER pReader)
+{
+    munmap(pReader->pData, pReader->nSize);
+    free(pReader);
+}
+
+/*
+ * Read the next event of a trace. Returns FALSE at the end of the trace,
+ * or at a record that is truncated or corrupt, leaving nOffset at the
+ * start of that record so callers can tell the two apart.
+ */
+unsigned char ReadTraceEvent(TRACEREADER pReader, TRACEEVENT pEvent)
+{
+    size_t nOffset = pReader->nOffset;
+    long long llPrevious = pReader->llPrevious;
+
+    if (TraceReadEvent(pReader, pEvent))
+    {
+        return TRUE;
+    }
+    pReader->nOffset = nOffset;
+    pReader->llPrevious = llPrevious;
+    return FALSE;
+}
+
+/*
+ * Decode one event for ReadTraceEvent, advancing past whatever it reads.
+ */
+unsigned char TraceReadEvent(TRACEREADER pReader, TRACEEVENT pEvent)
+{
+    int nByte;
+
+    if (pReader->nOffset >= pReader->nSize)
+    {
+        return FALSE;
+    }
+
+    nByte = pReader->pData[pReader->nOffset++];
+    pEvent->nEvent = nByte & ~TRACE_BACKWARD;
+    pEvent->ucDirection = (nByte & TRACE_BACKWARD) ? BACKWARD : FORWARD;
+    pEvent->nIterator = -1;
+    pEvent->uFirst = IntKey(0);
+    pEvent->uSecond = IntKey(0);
+    if (pEvent->nEvent >= TRACE_EVENTS)
+    {
+        return FALSE;
+    }
+
+    if (pEvent->nEvent >= TRACE_ATTACH)
+    {
+        if (pReader->nOffset >= pReader->nSize)
+        {
+            return FALSE;
+        }
+        pEvent->nIterator = pReader->pData[pReader->nOffset++];
+        if (pEvent->nIterator >= TRACE_MAX_ITERATORS)
+        {
+            return FALSE;
+        }
+    }
+    if (pEvent->nEvent <= TRACE_REMOVE || pEvent->nEvent == TRACE_ATTACH_AT || pEvent->nEvent == TRACE_ATTACH_RANGE)
+    {
+        if (!TraceReadKey(pReader, &pEvent->uFirst))
+        {
+            return FALSE;
+        }
+    }
+    if (pEvent->nEvent == TRACE_ATTACH_RANGE)
+    {
+        return TraceReadKey(pReader, &pEvent->uSecond);
+    }
+    return TRUE;
+}
+
+/*
+ * Read a key written by TraceWriteKey. Returns FALSE if it is truncated
+ * or too long.
+ */
+unsigned char TraceReadKey(TRACEREADER pReader, KEY *pKey)
+{
+    unsigned long long llZigzag = 0, llDelta;
+    int nShift = 0, nByte;
+
+    do
+    {
+        if (pReader->nOffset >= pReader->nSize || nShift > 63)
+        {
+            return FALSE;
+        }
+        nByte = pReader->pData[pReader->nOffset++];
+        llZigzag |= (unsigned long long)(nByte & 0x7f) << nShift;
+        nShift += 7;
+    } while (nByte & 0x80);
+
+    llDelta = (llZigzag >> 1) ^ (0 - (llZigzag & 1));
+    pReader->llPrevious = (long long)((unsigned long long)pReader->llPrevious + llDelta);
+    *pKey = (pReader->sHeader.nKeyType == KEY_INT ? IntKey((int)pReader->llPrevious) : Int64Key(pReader->llPrevious));
+    return TRUE;
+}
\ No newline at end of file
@@ -0,0 +1,120 @@
+/*
+ * Recording of the operations made on a tree into a compact binary trace,
+ * and reading traces back for replay. Recording is compiled in only when
+ * TREE_TRACE is defined (e.g. -DTREE_TRACE), in which case every source
+ * file must be built with it; otherwise it costs nothing.
+ *
+ * Adam Doyle
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdio.h>
+#include <pthread.h>
+
+#include "BinarySearchTree.h"
+
+
+/* Identifies a trace file, including the terminating null */
+#define TRACE_MAGIC "ADTRACE\n"
+
+/* Version of the trace layout written, traces of any other version are refused */
+#define TRACE_VERSION 1
+
+/* Number of iterators a trace follows at once, events of any further ones are dropped */
+#define TRACE_MAX_ITERATORS 64
+
+/* Bytes buffered before a trace is written out */
+#define TRACE_BUFFER_SIZE (1 << 20)
+
+/* Trace events, the low bits of each record's first byte */
+#define TRACE_SEARCH 0 /* Key */
+#define TRACE_INSERT 1 /* Key */
+#define TRACE_REMOVE 2 /* Key */
+#define TRACE_ATTACH 3 /* Iterator */
+#define TRACE_ATTACH_AT 4 /* Iterator, key */
+#define TRACE_ATTACH_RANGE 5 /* Iterator, low key, high key */
+#define TRACE_NEXT 6 /* Iterator */
+#define TRACE_DETACH 7 /* Iterator */
+#define TRACE_EVENTS 8
+
+/* Set in the first byte of attach events of backward iterators */
+#define TRACE_BACKWARD 0x80
+
+
+/*
+ * Record an event of a tree being traced, if pTree isn't NULL. Keys are
+ * only recorded for the events taking them, and pIter only for iterator
+ * events.
+ */
+#ifdef TREE_TRACE
+#define TREE_TRACE_EVENT(pTree, nEvent, pIter, uFirst, uSecond) \
+    ((pTree) != NULL && (pTree)->pTrace != NULL ? \
+     TraceRecord((pTree)->pTrace, (nEvent), (pIter), (uFirst), (uSecond)) : (void)0)
+#define TREE_TRACE_KEYS(pTree, nEvent, pKeys, nCount) \
+    ((pTree)->pTrace != NULL ? TraceRecordKeys((pTree)->pTrace, (nEvent), (pKeys), (nCount)) : (void)0)
+#else
+#define TREE_TRACE_EVENT(pTree, nEvent, pIter, uFirst, uSecond) ((void)0)
+#define TREE_TRACE_KEYS(pTree, nEvent, pKeys, nCount) ((void)0)
+#endif
+
+
+/*
+ * Represents the header at the start of a trace. Each record after it is
+ * an event byte, then the iterator's number for iterator events, then
+ * the keys for keyed events. Keys are stored as the zigzag encoded
+ * difference from the previous key, 7 bits per byte.
+ */
+typedef struct TraceHeader
+{
+    char szMagic[8]; /* TRACE_MAGIC */
+    unsigned int nVersion; /* TRACE_VERSION */
+    int nKeyType; /* KEY_INT or KEY_INT64 */
+} *TRACEHEADER;
+
+/* Represents a trace being recorded */
+typedef struct TraceWriter
+{
+    FILE *pFile;
+    char *pBuffer; /* Buffer given to pFile */
+    int nKeyType; /* Key type of the traced tree */
+    long long llPrevious; /* Last key written */
+    ITERATOR pIterators[TRACE_MAX_ITERATORS]; /* Attached iterators, by number */
+    long nEvents;
+    pthread_mutex_t sLock; /* Serializes events of concurrent readers */
+} *TRACEWRITER;
+
+/* Represents a trace being read */
+typedef struct TraceReader
+{
+    struct TraceHeader sHeader;
+    unsigned char *pData; /* Mapped trace */
+    size_t nSize;
+    size_t nOffset; /* Offset of the next record */
+    long long llPrevious; /* Last key read */
+} *TRACEREADER;
+
+/* Represents one event read from a trace */
+typedef struct TraceEvent
+{
+    int nEvent; /* One of the TRACE_* events */
+    unsigned char ucDirection; /* FORWARD or BACKWARD, for attach events */
+    int nIterator; /* Number of the iterator, for iterator events */
+    KEY uFirst;
+    KEY uSecond;
+} *TRACEEVENT;
+
+
+/* Recording */
+unsigned char StartTrace(TREE pTree, const char *szPath);
+unsigned char StopTrace(TREE pTree);
+void TraceRecord(TRACEWRITER pWriter, int nEvent, ITERATOR pIter, KEY uFirst, KEY uSecond);
+void TraceRecordKeys(TRACEWRITER pWriter, int nEvent, KEY *pKeys, int nCount);
+
+/* Reading */
+TRACEREADER OpenTrace(const char *szPath);
+void CloseTrace(TRACEREADER pReader);
+unsigned char ReadTraceEvent(TRACEREADER pReader, TRACEEVENT pEvent);
+
+#endif /* __TRACE_H__ */
\ No newline at end of file
@@ -0,0 +1,274 @@
+/* mmap and open are POSIX, hidden by strict ISO C modes */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "BinarySearchTree.h"
+#include "TreeFile.h"
+
+/* Method predeclarations */
+unsigned char SaveContents(void **ppContents, int nCount, FILE *pFile, SerializeCallback cbSerialize, TREEFILEHEADER pHeader);
+unsigned char CheckHeader(TREEFILEHEADER pHeader, size_t nFileSize, DeserializeCallback cbDeserialize);
+unsigned char LoadContents(TREEFILEHEADER pHeader, TREE pTree, DeserializeCallback cbDeserialize);
+
+/*
+ * Write every entry of a tree with integer keys to a file. Contents are
+ * written through cbSerialize, or as their pointer values if it is NULL.
+ * Returns FALSE if the keys aren't integers or writing fails.
+ */
+unsigned char SaveTree(TREE pTree, const char *szPath, SerializeCallback cbSerialize)
+{
+    struct TreeFileHeader sHeader;
+    ITERATOR pIter;
+    FILE *pFile;
+    void **ppContents;
+    KEY uKey;
+    unsigned char ucResult;
+    int i;
+
+    if (pTree->nKeyType != KEY_INT && pTree->nKeyType != KEY_INT64)
+    {
+        return FALSE;
+    }
+
+    pFile = fopen(szPath, "wb");
+    if (pFile == NULL)
+    {
+        return FALSE;
+    }
+
+    memset(&sHeader, 0, sizeof(sHeader));
+    memcpy(sHeader.szMagic, TREEFILE_MAGIC, sizeof(sHeader.szMagic));
+    sHeader.nVersion = TREEFILE_VERSION;
+    sHeader.nByteOrder = TREEFILE_BYTE_ORDER;
+    sHeader.nKeySize = sizeof(KEY);
+    sHeader.nPointerSize = sizeof(void *);
+    sHeader.nKeyType = pTree->nKeyType;
+    sHeader.nContentFormat = cbSerialize != NULL ? TREEFILE_CONTENTS_SERIALIZED : TREEFILE_CONTENTS_RAW;
+    sHeader.llCount = pTree->nSize;
+    fwrite(&sHeader, sizeof(sHeader), 1, pFile);
+
+    /* Keys go out as they are visited, contents are kept for their own section */
+    ppContents = (void **)malloc(sizeof(void *) * (pTree->nSize + 1));
+    pIter = AllocIterator();
+    Attach(pIter, pTree);
+    for (i = 0; i < pTree->nSize; i++)
+    {
+        if (pTree->nKeyType == KEY_INT)
+        {
+            uKey = IntKey(CurrentKey(pIter).nInt);
+        }
+        else
+        {
+            uKey = Int64Key(CurrentKey(pIter).llInt);
+        }
+        fwrite(&uKey, sizeof(uKey), 1, pFile);
+        ppContents[i] = Next(pIter);
+    }
+    Detach(pIter);
+    FreeIterator(pIter);
+
+    ucResult = SaveContents(ppContents, pTree->nSize, pFile, cbSerialize, &sHeader);
+    free(ppContents);
+
+    if (ferror(pFile))
+    {
+        ucResult = FALSE;
+    }
+    if (fclose(pFile) != 0)
+    {
+        ucResult = FALSE;
+    }
+    return ucResult;
+}
+
+/*
+ * Write the content section of a file. Serialized contents are preceded
+ * by their offsets, which are only known once the blob has been written,
+ * so the offsets are filled in afterwards along with the blob's size in
+ * the header.
+ */
+unsigned char SaveContents(void **ppContents, int nCount, FILE *pFile, SerializeCallback cbSerialize, TREEFILEHEADER pHeader)
+{
+    long long *pOffsets;
+    long nOffsetsStart, nBlobStart;
+    unsigned char ucResult = TRUE;
+    int i;
+
+    if (cbSerialize == NULL)
+    {
+        fwrite(ppContents, sizeof(void *), nCount, pFile);
+        return TRUE;
+    }
+
+    pOffsets = (long long *)malloc(sizeof(long long) * (nCount + 1));
+    nOffsetsStart = ftell(pFile);
+    nBlobStart = nOffsetsStart + (long)(sizeof(long long) * (nCount + 1));
+    fseek(pFile, nBlobStart, SEEK_SET);
+    for (i = 0; i < nCount && ucResult; i++)
+    {
+        pOffsets[i] = ftell(pFile) - nBlobStart;
+        ucResult = cbSerialize(ppContents[i], pFile);
+    }
+    pOffsets[nCount] = ftell(pFile) - nBlobStart;
+    pHeader->llBlobSize = pOffsets[nCount];
+
+    if (ucResult)
+    {
+        fseek(pFile, nOffsetsStart, SEEK_SET);
+        fwrite(pOffsets, sizeof(long long), nCount + 1, pFile);
+        fseek(pFile, 0, SEEK_SET);
+        fwrite(pHeader, sizeof(*pHeader), 1, pFile);
+    }
+
+    free(pOffsets);
+    return ucResult;
+}
+
+/*
+ * Fill an empty tree from a file written by SaveTree, setting the tree's
+ * key type to the file's. The file is mapped into memory and its key
+ * array handed to BuildFromSorted as is, so loading takes linear time
+ * with no parsing, except on engines without a bulk build (concurrent
+ * trees), which take the keys one by one. Serialized contents are
+ * rebuilt through cbDeserialize, which must be NULL for files of raw
+ * contents. Returns FALSE if the file can't be read, is not a valid tree
+ * file for this machine, or the tree isn't empty. Contents already
+ * rebuilt when a corrupt file's keys turn out not to be ascending are
+ * not released.
+ */
+unsigned char LoadTree(TREE pTree, const char *szPath, DeserializeCallback cbDeserialize)
+{
+    struct stat sStat;
+    TREEFILEHEADER pHeader;
+    void *pMapping;
+    unsigned char ucResult;
+    int nFile;
+
+    if (pTree->nSize > 0)
+    {
+        return FALSE;
+    }
+
+    nFile = open(szPath, O_RDONLY);
+    if (nFile < 0)
+    {
+        return FALSE;
+    }
+    if (fstat(nFile, &sStat) != 0 || (size_t)sStat.st_size < sizeof(struct TreeFileHeader))
+    {
+        close(nFile);
+        return FALSE;
+    }
+    pMapping = mmap(NULL, sStat.st_size, PROT_READ, MAP_PRIVATE, nFile, 0);
+    close(nFile);
+    if (pMapping == MAP_FAILED)
+    {
+        return FALSE;
+    }
+
+    pHeader = (TREEFILEHEADER)pMapping;
+    ucResult = CheckHeader(pHeader, sStat.st_size, cbDeserialize) &&
+        SetKeyType(pTree, pHeader->nKeyType, NULL);
+    if (ucResult)
+    {
+        ucResult = LoadContents(pHeader, pTree, cbDeserialize);
+    }
+
+    munmap(pMapping, sStat.st_size);
+    return ucResult;
+}
+
+/*
+ * Check that a file's header was written by SaveTree on a machine like
+ * this one, in the content format matching cbDeserialize, and that the
+ * file is long enough for the sections it describes.
+ */
+unsigned char CheckHeader(TREEFILEHEADER pHeader, size_t nFileSize, DeserializeCallback cbDeserialize)
+{
+    unsigned long long llNeeded;
+
+    if (memcmp(pHeader->szMagic, TREEFILE_MAGIC, sizeof(pHeader->szMagic)) != 0 ||
+        pHeader->nVersion != TREEFILE_VERSION ||
+        pHeader->nByteOrder != TREEFILE_BYTE_ORDER ||
+        pHeader->nKeySize != sizeof(KEY) ||
+        pHeader->nPointerSize != sizeof(void *) ||
+        (pHeader->nKeyType != KEY_INT && pHeader->nKeyType != KEY_INT64) ||
+        pHeader->llCount < 0 || pHeader->llCount > INT_MAX || pHeader->llBlobSize < 0)
+    {
+        return FALSE;
+    }
+
+    llNeeded = sizeof(*pHeader) + sizeof(KEY) * (unsigned long long)pHeader->llCount;
+    if (pHeader->nContentFormat == TREEFILE_CONTENTS_RAW && cbDeserialize == NULL)
+    {
+        llNeeded += sizeof(void *) * (unsigned long long)pHeader->llCount;
+    }
+    else if (pHeader->nContentFormat == TREEFILE_CONTENTS_SERIALIZED && cbDeserialize != NULL)
+    {
+        llNeeded += sizeof(long long) * (unsigned long long)(pHeader->llCount + 1) + pHeader->llBlobSize;
+    }
+    else
+    {
+        return FALSE;
+    }
+
+    return llNeeded <= nFileSize;
+}
+
+/*
+ * Build the tree from the keys and content section following a mapped
+ * file's header. Raw contents are used in place; serialized ones are
+ * checked to lie within the blob before any of them is rebuilt.
+ */
+unsigned char LoadContents(TREEFILEHEADER pHeader, TREE pTree, DeserializeCallback cbDeserialize)
+{
+    KEY *pKeys = (KEY *)(pHeader + 1);
+    int nCount = (int)pHeader->llCount;
+    const long long *pOffsets;
+    const char *pBlob;
+    void **ppContents;
+    unsigned char ucResult;
+    int i;
+
+    if (cbDeserialize == NULL)
+    {
+        return BuildFromSorted(pKeys, (void **)(pKeys + nCount), nCount, pTree);
+    }
+
+    pOffsets = (const long long *)(pKeys + nCount);
+    pBlob = (const char *)(pOffsets + nCount + 1);
+    if (pOffsets[0] != 0)
+    {
+        return FALSE;
+    }
+    for (i = 0; i < nCount; i++)
+    {
+        if (pOffsets[i + 1] < pOffsets[i])
+        {
+            return FALSE;
+        }
+    }
+    if (pOffsets[nCount] != pHeader->llBlobSize)
+    {
+        return FALSE;
+    }
+
+    ppContents = (void **)malloc(sizeof(void *) * (nCount + 1));
+    for (i = 0; i < nCount; i++)
+    {
+        ppContents[i] = cbDeserialize(pBlob + pOffsets[i], (size_t)(pOffsets[i + 1] - pOffsets[i]));
+    }
+    ucResult = BuildFromSorted(pKeys, ppContents, nCount, pTree);
+
+    free(ppContents);
+    return ucResult;
+}
\ No newline at end of file
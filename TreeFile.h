@@ -0,0 +1,62 @@
+/*
+ * Binary snapshot files of trees with integer keys. A file holds a header
+ * followed by the keys in ascending order and then the contents, laid out
+ * so loading maps the file and builds the tree straight from it.
+ *
+ * Adam Doyle
+ */
+
+#ifndef __TREEFILE_H__
+#define __TREEFILE_H__
+
+#include <stdio.h>
+
+#include "BinarySearchTree.h"
+
+
+/* Identifies a tree file, including the terminating null */
+#define TREEFILE_MAGIC "ADTREE\n"
+
+/* Version of the file layout written, files of any other version are refused */
+#define TREEFILE_VERSION 1
+
+/* Written in native byte order, so files from a machine of another byte order are recognized */
+#define TREEFILE_BYTE_ORDER 0x01020304
+
+/* Content formats */
+#define TREEFILE_CONTENTS_RAW 0 /* The contents' pointer values, for trees storing plain values in them */
+#define TREEFILE_CONTENTS_SERIALIZED 1 /* Offsets into a blob of bytes written by a SerializeCallback */
+
+
+/* Writes the bytes representing a content payload to the file, returning FALSE on failure */
+typedef unsigned char (*SerializeCallback)(void *pContent, FILE *pFile);
+/* Rebuilds a content payload from the nSize bytes its SerializeCallback wrote */
+typedef void *(*DeserializeCallback)(const void *pData, size_t nSize);
+
+
+/*
+ * Represents the header at the start of a tree file. It is padded to
+ * 64 bytes so the key array following it is aligned. The keys are KEY
+ * unions with unused bytes zeroed, then come either nCount raw content
+ * pointers or nCount + 1 offsets into the content blob following them.
+ */
+typedef struct TreeFileHeader
+{
+    char szMagic[8]; /* TREEFILE_MAGIC */
+    unsigned int nVersion; /* TREEFILE_VERSION */
+    unsigned int nByteOrder; /* TREEFILE_BYTE_ORDER */
+    unsigned int nKeySize; /* sizeof(KEY) */
+    unsigned int nPointerSize; /* sizeof(void *) */
+    int nKeyType; /* KEY_INT or KEY_INT64 */
+    int nContentFormat; /* One of the TREEFILE_CONTENTS_* formats */
+    long long llCount; /* Number of entries */
+    long long llBlobSize; /* Bytes of serialized contents */
+    char szPadding[16];
+} *TREEFILEHEADER;
+
+
+/* File operations */
+unsigned char SaveTree(TREE pTree, const char *szPath, SerializeCallback cbSerialize);
+unsigned char LoadTree(TREE pTree, const char *szPath, DeserializeCallback cbDeserialize);
+
+#endif /* __TREEFILE_H__ */
\ No newline at end of file
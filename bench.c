@@ -0,0 +1,494 @@
+/* getopt, clock_gettime and getrusage are POSIX, hidden by strict ISO C modes */
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 600
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "BinarySearchTree.h"
+#include "AVL.h"
+#include "RB.h"
+#include "BTree.h"
+#include "Compact.h"
+#include "Lean.h"
+#include "Splay.h"
+
+/* Key distributions */
+#define KEYS_SEQUENTIAL 0
+#define KEYS_RANDOM 1
+#define KEYS_REVERSE 2
+#define KEYS_ZIPF 3
+
+/* Operations of the mixed phase */
+#define OP_READ 0
+#define OP_INSERT 1
+#define OP_REMOVE 2
+#define OP_SCAN 3
+
+
+/* Represents a benchmark run, as given on the command line */
+typedef struct BenchConfig
+{
+    const char *szTree; /* plain, avl, rb, btree, compact, lean, splay or semisplay */
+    int nFlags; /* TREE_* creation flags */
+    int nKeys; /* One of the KEYS_* distributions */
+    int nSize; /* Number of keys loaded, and the key space of the mixed phase */
+    long nOperations; /* Number of operations in the mixed phase */
+    int nReadPercent; /* Share of reads in the mixed phase */
+    int nScanPercent; /* Share of range scans in the mixed phase, the rest are writes */
+    int nScanLength; /* Entries visited per range scan */
+    double dTheta; /* Skew of the Zipf distribution */
+    int nSplayPeriod; /* Accesses per splay of splay trees */
+    unsigned int nSeed;
+} *BENCHCONFIG;
+
+/* Represents a key stream following a distribution */
+typedef struct KeyStream
+{
+    int nKeys;
+    int nSize;
+    long nCursor; /* Position of sequential and reverse streams */
+    double dTheta, dAlpha, dZeta, dEta; /* Zipf constants, see KeyStreamNext */
+} *KEYSTREAM;
+
+
+/* Method predeclarations */
+/* Setup */
+unsigned char ParseArguments(int argc, char **argv, BENCHCONFIG pConfig);
+TREE AllocBenchTree(BENCHCONFIG pConfig);
+void Usage(const char *szProgram);
+
+/* Keys */
+void KeyStreamInit(KEYSTREAM pStream, BENCHCONFIG pConfig);
+int KeyStreamNext(KEYSTREAM pStream);
+int *LoadOrder(BENCHCONFIG pConfig);
+int Scramble(int nRank, int nSize);
+
+/* Phases */
+void RunLoad(TREE pTree, BENCHCONFIG pConfig);
+void RunMix(TREE pTree, BENCHCONFIG pConfig);
+
+/* Reporting */
+long long NowNanoseconds(void);
+int CompareLatencies(const void *pLeft, const void *pRight);
+void Report(const char *szPhase, long long *pLatencies, long nCount, double dSeconds, TREE pTree, BENCHCONFIG pConfig);
+
+/*
+ * Load a tree and run a mixed workload against it, printing one JSON
+ * object per phase to stdout.
+ */
+int main(int argc, char **argv)
+{
+    struct BenchConfig sConfig;
+    TREE pTree;
+
+    if (!ParseArguments(argc, argv, &sConfig))
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    srand(sConfig.nSeed);
+    pTree = AllocBenchTree(&sConfig);
+    if (pTree == NULL)
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    RunLoad(pTree, &sConfig);
+    if (sConfig.nOperations > 0)
+    {
+        RunMix(pTree, &sConfig);
+    }
+
+    FreeTree(pTree);
+    return 0;
+}
+
+/*
+ * Fill in a configuration from the command line, returning FALSE if
+ * it is invalid.
+ */
+unsigned char ParseArguments(int argc, char **argv, BENCHCONFIG pConfig)
+{
+    int nOption;
+
+    pConfig->szTree = "avl";
+    pConfig->nFlags = 0;
+    pConfig->nKeys = KEYS_RANDOM;
+    pConfig->nSize = 100000;
+    pConfig->nOperations = -1;
+    pConfig->nReadPercent = 90;
+    pConfig->nScanPercent = 0;
+    pConfig->nScanLength = 100;
+    pConfig->dTheta = 0.99;
+    pConfig->nSplayPeriod = 1;
+    pConfig->nSeed = 1;
+
+    while ((nOption = getopt(argc, argv, "t:k:n:o:r:s:l:z:K:S:PTOh")) != -1)
+    {
+        switch (nOption)
+        {
+        case 't':
+            pConfig->szTree = optarg;
+            break;
+        case 'k':
+            if (strcmp(optarg, "seq") == 0)
+                pConfig->nKeys = KEYS_SEQUENTIAL;
+            else if (strcmp(optarg, "random") == 0)
+                pConfig->nKeys = KEYS_RANDOM;
+            else if (strcmp(optarg, "reverse") == 0)
+                pConfig->nKeys = KEYS_REVERSE;
+            else if (strcmp(optarg, "zipf") == 0)
+                pConfig->nKeys = KEYS_ZIPF;
+            else
+                return FALSE;
+            break;
+        case 'n':
+            pConfig->nSize = atoi(optarg);
+            break;
+        case 'o':
+            pConfig->nOperations = atol(optarg);
+            break;
+        case 'r':
+            pConfig->nReadPercent = atoi(optarg);
+            break;
+        case 's':
+            pConfig->nScanPercent = atoi(optarg);
+            break;
+        case 'l':
+            pConfig->nScanLength = atoi(optarg);
+            break;
+        case 'z':
+            pConfig->dTheta = atof(optarg);
+            break;
+        case 'K':
+            pConfig->nSplayPeriod = atoi(optarg);
+            break;
+        case 'S':
+            pConfig->nSeed = (unsigned int)atol(optarg);
+            break;
+        case 'P':
+            pConfig->nFlags |= TREE_POOLED;
+            break;
+        case 'T':
+            pConfig->nFlags |= TREE_THREADED;
+            break;
+        case 'O':
+            pConfig->nFlags |= TREE_ORDER_STATS;
+            break;
+        default:
+            return FALSE;
+        }
+    }
+
+    if (pConfig->nOperations < 0)
+    {
+        pConfig->nOperations = pConfig->nSize;
+    }
+
+    return (optind == argc && pConfig->nSize > 0 &&
+        pConfig->nReadPercent >= 0 && pConfig->nScanPercent >= 0 &&
+        pConfig->nReadPercent + pConfig->nScanPercent <= 100 &&
+        pConfig->nScanLength > 0 && pConfig->dTheta > 0 && pConfig->dTheta != 1 && pConfig->nSplayPeriod > 0);
+}
+
+/*
+ * Allocate the tree named by the configuration, NULL if unknown.
+ */
+TREE AllocBenchTree(BENCHCONFIG pConfig)
+{
+    TREE pTree;
+
+    if (strcmp(pConfig->szTree, "plain") == 0)
+        return AllocTree(NULL, pConfig->nFlags);
+    if (strcmp(pConfig->szTree, "avl") == 0)
+        return AVLAllocTree(pConfig->nFlags);
+    if (strcmp(pConfig->szTree, "rb") == 0)
+        return RBAllocTree(pConfig->nFlags);
+    if (strcmp(pConfig->szTree, "btree") == 0)
+        return BTreeAllocTree(pConfig->nFlags);
+    if (strcmp(pConfig->szTree, "compact") == 0)
+        return CompactAllocTree(pConfig->nFlags);
+    if (strcmp(pConfig->szTree, "lean") == 0)
+        return LeanAllocTree(pConfig->nFlags);
+    if (strcmp(pConfig->szTree, "splay") == 0)
+    {
+        pTree = SplayAllocTree(pConfig->nFlags);
+        SplaySetOptions(pTree, SPLAY_FULL, pConfig->nSplayPeriod);
+        return pTree;
+    }
+    if (strcmp(pConfig->szTree, "semisplay") == 0)
+    {
+        pTree = SplayAllocTree(pConfig->nFlags);
+        SplaySetOptions(pTree, SPLAY_SEMI, pConfig->nSplayPeriod);
+        return pTree;
+    }
+    return NULL;
+}
+
+/*
+ * Print the command line options.
+ */
+void Usage(const char *szProgram)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -t tree     plain, avl, rb, btree, compact, lean, splay or semisplay (avl)\n"
+        "  -k keys     seq, random, reverse or zipf (random)\n"
+        "  -n size     keys loaded before the mixed phase (100000)\n"
+        "  -o ops      operations in the mixed phase, 0 to skip it (size)\n"
+        "  -r percent  reads in the mixed phase (90)\n"
+        "  -s percent  range scans in the mixed phase, the rest are inserts and removes (0)\n"
+        "  -l length   entries visited per range scan (100)\n"
+        "  -z theta    skew of zipf keys, not 1 (0.99)\n"
+        "  -K period   splay trees splay every period-th access (1)\n"
+        "  -S seed     random seed (1)\n"
+        "  -P -T -O    pooled, threaded and order statistics tree flags\n"
+        "The plain tree degenerates into a list on seq and reverse keys.\n",
+        szProgram);
+}
+
+/*
+ * Prepare a stream of keys in [0, nSize) following the configured
+ * distribution.
+ */
+void KeyStreamInit(KEYSTREAM pStream, BENCHCONFIG pConfig)
+{
+    int i;
+
+    pStream->nKeys = pConfig->nKeys;
+    pStream->nSize = pConfig->nSize;
+    pStream->nCursor = 0;
+    pStream->dTheta = pConfig->dTheta;
+    if (pStream->nKeys != KEYS_ZIPF)
+    {
+        return;
+    }
+
+    pStream->dZeta = 0;
+    for (i = 1; i <= pStream->nSize; i++)
+    {
+        pStream->dZeta += 1.0 / pow((double)i, pStream->dTheta);
+    }
+    pStream->dAlpha = 1.0 / (1.0 - pStream->dTheta);
+    pStream->dEta = (1.0 - pow(2.0 / pStream->nSize, 1.0 - pStream->dTheta)) /
+        (1.0 - (1.0 + 1.0 / pow(2.0, pStream->dTheta)) / pStream->dZeta);
+}
+
+/*
+ * Return the stream's next key. Sequential and reverse streams cycle
+ * through the key space; Zipf ranks come from the method of Gray et al.
+ * ("Quickly generating billion-record synthetic databases") and are
+ * scattered over the key space so the hot keys aren't neighbours.
+ */
+int KeyStreamNext(KEYSTREAM pStream)
+{
+    double dUniform, dScaled;
+    int nRank;
+
+    switch (pStream->nKeys)
+    {
+    case KEYS_SEQUENTIAL:
+        return (int)(pStream->nCursor++ % pStream->nSize);
+    case KEYS_REVERSE:
+        return pStream->nSize - 1 - (int)(pStream->nCursor++ % pStream->nSize);
+    case KEYS_ZIPF:
+        dUniform = (double)rand() / ((double)RAND_MAX + 1);
+        dScaled = dUniform * pStream->dZeta;
+        if (dScaled < 1.0)
+            nRank = 0;
+        else if (dScaled < 1.0 + pow(0.5, pStream->dTheta))
+            nRank = 1;
+        else
+            nRank = (int)(pStream->nSize * pow(pStream->dEta * dUniform - pStream->dEta + 1, pStream->dAlpha));
+        if (nRank >= pStream->nSize)
+            nRank = pStream->nSize - 1;
+        return Scramble(nRank, pStream->nSize);
+    default:
+        return (int)(((unsigned long)rand() * ((unsigned long)RAND_MAX + 1) + rand()) % pStream->nSize);
+    }
+}
+
+/*
+ * Return every key of [0, nSize) in the order the load phase inserts
+ * them: ascending, descending, or shuffled for random and Zipf keys.
+ */
+int *LoadOrder(BENCHCONFIG pConfig)
+{
+    int *pKeys = (int *)malloc(sizeof(int) * pConfig->nSize);
+    int i, j, nSwap;
+
+    for (i = 0; i < pConfig->nSize; i++)
+    {
+        pKeys[i] = (pConfig->nKeys == KEYS_REVERSE ? pConfig->nSize - 1 - i : i);
+    }
+    if (pConfig->nKeys == KEYS_RANDOM || pConfig->nKeys == KEYS_ZIPF)
+    {
+        for (i = pConfig->nSize - 1; i > 0; i--)
+        {
+            j = (int)(((unsigned long)rand() * ((unsigned long)RAND_MAX + 1) + rand()) % (i + 1));
+            nSwap = pKeys[i];
+            pKeys[i] = pKeys[j];
+            pKeys[j] = nSwap;
+        }
+    }
+    return pKeys;
+}
+
+/*
+ * Map a rank onto the key space through a fixed permutation, a
+ * multiplication by a prime, coprime with any smaller size.
+ */
+int Scramble(int nRank, int nSize)
+{
+    return (int)(((unsigned long long)nRank * 2654435761ULL) % (unsigned long long)nSize);
+}
+
+/*
+ * Insert every key of the key space, timing each insertion.
+ */
+void RunLoad(TREE pTree, BENCHCONFIG pConfig)
+{
+    long long *pLatencies = (long long *)malloc(sizeof(long long) * pConfig->nSize);
+    int *pKeys = LoadOrder(pConfig);
+    long long llStart, llBefore, llAfter;
+    int i;
+
+    llStart = NowNanoseconds();
+    llAfter = llStart;
+    for (i = 0; i < pConfig->nSize; i++)
+    {
+        llBefore = llAfter;
+        Insert(IntKey(pKeys[i]), (void *)(long)(pKeys[i] + 1), pTree);
+        llAfter = NowNanoseconds();
+        pLatencies[i] = llAfter - llBefore;
+    }
+
+    Report("load", pLatencies, pConfig->nSize, (llAfter - llStart) / 1e9, pTree, pConfig);
+    free(pKeys);
+    free(pLatencies);
+}
+
+/*
+ * Run the mixed phase: reads, range scans, and inserts and removes in
+ * equal shares, all on keys drawn from the configured distribution.
+ */
+void RunMix(TREE pTree, BENCHCONFIG pConfig)
+{
+    long long *pLatencies = (long long *)malloc(sizeof(long long) * pConfig->nOperations);
+    struct KeyStream sStream;
+    ITERATOR pIter = AllocIterator();
+    long long llStart, llBefore, llAfter;
+    volatile long nChecksum = 0;
+    int nOperation, nChoice, nKey, j;
+    long i;
+
+    KeyStreamInit(&sStream, pConfig);
+
+    llStart = NowNanoseconds();
+    llAfter = llStart;
+    for (i = 0; i < pConfig->nOperations; i++)
+    {
+        nChoice = rand() % 100;
+        if (nChoice < pConfig->nReadPercent)
+            nOperation = OP_READ;
+        else if (nChoice < pConfig->nReadPercent + pConfig->nScanPercent)
+            nOperation = OP_SCAN;
+        else
+            nOperation = (nChoice % 2 ? OP_INSERT : OP_REMOVE);
+        nKey = KeyStreamNext(&sStream);
+
+        llBefore = NowNanoseconds();
+        switch (nOperation)
+        {
+        case OP_READ:
+            nChecksum += (long)Search(IntKey(nKey), pTree);
+            break;
+        case OP_INSERT:
+            Insert(IntKey(nKey), (void *)(long)(nKey + 1), pTree);
+            break;
+        case OP_REMOVE:
+            Remove(IntKey(nKey), pTree);
+            break;
+        case OP_SCAN:
+            AttachAt(pIter, pTree, IntKey(nKey));
+            for (j = 0; j < pConfig->nScanLength; j++)
+            {
+                nChecksum += (long)Next(pIter);
+            }
+            Detach(pIter);
+            break;
+        }
+        llAfter = NowNanoseconds();
+        pLatencies[i] = llAfter - llBefore;
+    }
+
+    Report("mix", pLatencies, pConfig->nOperations, (llAfter - llStart) / 1e9, pTree, pConfig);
+    FreeIterator(pIter);
+    free(pLatencies);
+}
+
+/*
+ * Return a monotonic timestamp in nanoseconds.
+ */
+long long NowNanoseconds()
+{
+    struct timespec sTime;
+    clock_gettime(CLOCK_MONOTONIC, &sTime);
+    return (long long)sTime.tv_sec * 1000000000LL + sTime.tv_nsec;
+}
+
+/*
+ * qsort comparison of two latencies.
+ */
+int CompareLatencies(const void *pLeft, const void *pRight)
+{
+    return COMPARE_VALUES(*(const long long *)pLeft, *(const long long *)pRight);
+}
+
+/*
+ * Print a phase's throughput, latency percentiles, the process's peak
+ * resident set size and the tree's height as one line of JSON, with the
+ * phase's tree statistics if they were compiled in. Sorts pLatencies and
+ * resets the statistics for the next phase.
+ */
+void Report(const char *szPhase, long long *pLatencies, long nCount, double dSeconds, TREE pTree, BENCHCONFIG pConfig)
+{
+    static const char *szKeys[] = { "seq", "random", "reverse", "zipf" };
+    struct TreeStats sStats;
+    struct rusage sUsage;
+    unsigned char ucStats;
+
+    qsort(pLatencies, nCount, sizeof(long long), CompareLatencies);
+    getrusage(RUSAGE_SELF, &sUsage);
+    ucStats = GetTreeStats(pTree, &sStats);
+    ResetTreeStats(pTree);
+
+    printf("{\"phase\":\"%s\",\"tree\":\"%s\",\"flags\":%d,\"keys\":\"%s\",\"size\":%d,"
+        "\"read_pct\":%d,\"scan_pct\":%d,\"ops\":%ld,\"seconds\":%.6f,\"ops_per_sec\":%.0f,"
+        "\"p50_ns\":%lld,\"p90_ns\":%lld,\"p99_ns\":%lld,\"p999_ns\":%lld,\"max_ns\":%lld,"
+        "\"tree_size\":%d,\"height\":%d,\"tree_bytes\":%ld,\"peak_rss_kb\":%ld",
+        szPhase, pConfig->szTree, pConfig->nFlags, szKeys[pConfig->nKeys], pConfig->nSize,
+        pConfig->nReadPercent, pConfig->nScanPercent, nCount, dSeconds, dSeconds > 0 ? nCount / dSeconds : 0.0,
+        pLatencies[nCount * 50 / 100], pLatencies[nCount * 90 / 100], pLatencies[nCount * 99 / 100],
+        pLatencies[nCount * 999 / 1000], pLatencies[nCount - 1],
+        pTree->nSize, sStats.nHeight, sStats.nBytes, (long)sUsage.ru_maxrss);
+    if (ucStats)
+    {
+        printf(",\"comparisons\":%ld,\"descents\":%ld,\"avg_descent\":%.2f,\"max_descent\":%ld,"
+            "\"rotations\":%ld,\"retrace_steps\":%ld,\"allocations\":%ld",
+            sStats.nComparisons, sStats.nDescents,
+            sStats.nDescents > 0 ? (double)sStats.nNodesVisited / sStats.nDescents : 0.0,
+            sStats.nMaxDescent, sStats.nRotations, sStats.nRetraceSteps, sStats.nAllocations);
+    }
+    printf("}\n");
+    fflush(stdout);
+}
\ No newline at end of file
@@ -11,7 +11,7 @@
 
 int main(int argc, char** argv)
 {
-    TREE pTree = AllocTree(NULL);
+    TREE pTree = AllocTree(NULL, 0);
     void *pContents;
     ITERATOR pIter;
 
@@ -35,17 +35,17 @@ int main(int argc, char** argv)
         case 1:
             printf("Key: ");
             BTSCAN("%d", &nKey);
-            Insert(nKey, "temp", pTree);
+            Insert(IntKey(nKey), "temp", pTree);
             break;
         case 2:
             printf("Key: ");
             BTSCAN("%d", &nKey);
-            Remove(nKey, pTree);
+            Remove(IntKey(nKey), pTree);
             break;
         case 3:
             printf("Key: " );
             BTSCAN("%d", &nKey);
-            pContents = Search(nKey, pTree);
+            pContents = Search(IntKey(nKey), pTree);
             if (pContents != NULL)
             {
                 printf("Contents: %s\n", pContents);
@@ -82,13 +82,13 @@ int main(int argc, char** argv)
         case 6:
             for (nKey = 100; nKey > 0; nKey--)
             {
-                Insert(nKey, "temp", pTree);
+                Insert(IntKey(nKey), "temp", pTree);
             }
             break;
         case 7:
             for (nKey = 100; nKey > 0; nKey--)
             {
-                Remove(nKey, pTree);
+                Remove(IntKey(nKey), pTree);
             }
             break;
         default:
@@ -0,0 +1,271 @@
+/* getopt, clock_gettime and getrusage are POSIX, hidden by strict ISO C modes */
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 600
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "BinarySearchTree.h"
+#include "AVL.h"
+#include "RB.h"
+#include "BTree.h"
+#include "Compact.h"
+#include "Lean.h"
+#include "Persistent.h"
+#include "Splay.h"
+#include "Trace.h"
+
+
+/* Method predeclarations */
+TREE AllocReplayTree(const char *szTree, int nFlags, int nSplayPeriod);
+TRACEEVENT ReadEvents(TRACEREADER pReader, long *pnCount);
+void Replay(TREE pTree, TRACEEVENT pEvents, long nCount, long *pnCounts, long *pnFound);
+long long NowNanoseconds(void);
+void Usage(const char *szProgram);
+
+/*
+ * Replay a trace recorded by StartTrace against a new tree, printing the
+ * time taken as one line of JSON to stdout.
+ */
+int main(int argc, char **argv)
+{
+    static const char *szEvents[TRACE_EVENTS] =
+        { "searches", "inserts", "removes", "attaches", "attaches_at", "attaches_range", "nexts", "detaches" };
+    const char *szTree = "avl";
+    long pnCounts[TRACE_EVENTS] = { 0 };
+    TRACEREADER pReader;
+    TRACEEVENT pEvents;
+    TREE pTree;
+    struct rusage sUsage;
+    long long llStart, llEnd;
+    long nCount, nFound = 0;
+    int nOption, nFlags = 0, nSplayPeriod = 1, i;
+
+    while ((nOption = getopt(argc, argv, "t:K:PTOh")) != -1)
+    {
+        switch (nOption)
+        {
+        case 't':
+            szTree = optarg;
+            break;
+        case 'K':
+            nSplayPeriod = atoi(optarg);
+            break;
+        case 'P':
+            nFlags |= TREE_POOLED;
+            break;
+        case 'T':
+            nFlags |= TREE_THREADED;
+            break;
+        case 'O':
+            nFlags |= TREE_ORDER_STATS;
+            break;
+        default:
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc - 1 || nSplayPeriod <= 0)
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    pReader = OpenTrace(argv[optind]);
+    if (pReader == NULL)
+    {
+        fprintf(stderr, "%s: not a readable trace\n", argv[optind]);
+        return 1;
+    }
+    pTree = AllocReplayTree(szTree, nFlags, nSplayPeriod);
+    if (pTree == NULL)
+    {
+        CloseTrace(pReader);
+        Usage(argv[0]);
+        return 1;
+    }
+    SetKeyType(pTree, pReader->sHeader.nKeyType, NULL);
+
+    /* Decode everything up front so only the tree operations are timed */
+    pEvents = ReadEvents(pReader, &nCount);
+    if (pReader->nOffset < pReader->nSize)
+    {
+        fprintf(stderr, "%s: truncated or corrupt after %ld events, replaying those\n", argv[optind], nCount);
+    }
+    CloseTrace(pReader);
+
+    llStart = NowNanoseconds();
+    Replay(pTree, pEvents, nCount, pnCounts, &nFound);
+    llEnd = NowNanoseconds();
+    getrusage(RUSAGE_SELF, &sUsage);
+
+    printf("{\"trace\":\"%s\",\"tree\":\"%s\",\"flags\":%d,\"events\":%ld,\"seconds\":%.6f,\"events_per_sec\":%.0f",
+        argv[optind], szTree, nFlags, nCount, (llEnd - llStart) / 1e9,
+        llEnd > llStart ? nCount / ((llEnd - llStart) / 1e9) : 0.0);
+    for (i = 0; i < TRACE_EVENTS; i++)
+    {
+        printf(",\"%s\":%ld", szEvents[i], pnCounts[i]);
+    }
+    printf(",\"found\":%ld,\"tree_size\":%d,\"peak_rss_kb\":%ld}\n", nFound, pTree->nSize, (long)sUsage.ru_maxrss);
+
+    FreeTree(pTree);
+    free(pEvents);
+    return 0;
+}
+
+/*
+ * Allocate the named tree variant, NULL if unknown. Splay trees splay
+ * every nSplayPeriod-th access.
+ */
+TREE AllocReplayTree(const char *szTree, int nFlags, int nSplayPeriod)
+{
+    TREE pTree;
+
+    if (strcmp(szTree, "plain") == 0)
+        return AllocTree(NULL, nFlags);
+    if (strcmp(szTree, "avl") == 0)
+        return AVLAllocTree(nFlags);
+    if (strcmp(szTree, "rb") == 0)
+        return RBAllocTree(nFlags);
+    if (strcmp(szTree, "btree") == 0)
+        return BTreeAllocTree(nFlags);
+    if (strcmp(szTree, "compact") == 0)
+        return CompactAllocTree(nFlags);
+    if (strcmp(szTree, "lean") == 0)
+        return LeanAllocTree(nFlags);
+    if (strcmp(szTree, "persistent") == 0)
+        return PersistentAllocTree(nFlags);
+    if (strcmp(szTree, "splay") == 0)
+    {
+        pTree = SplayAllocTree(nFlags);
+        SplaySetOptions(pTree, SPLAY_FULL, nSplayPeriod);
+        return pTree;
+    }
+    if (strcmp(szTree, "semisplay") == 0)
+    {
+        pTree = SplayAllocTree(nFlags);
+        SplaySetOptions(pTree, SPLAY_SEMI, nSplayPeriod);
+        return pTree;
+    }
+    return NULL;
+}
+
+/*
+ * Read every event of a trace into an array, up to the first bad record.
+ */
+TRACEEVENT ReadEvents(TRACEREADER pReader, long *pnCount)
+{
+    long nCapacity = 1024, nCount = 0;
+    TRACEEVENT pEvents = (TRACEEVENT)malloc(sizeof(struct TraceEvent) * nCapacity);
+
+    while (ReadTraceEvent(pReader, &pEvents[nCount]))
+    {
+        nCount++;
+        if (nCount == nCapacity)
+        {
+            nCapacity *= 2;
+            pEvents = (TRACEEVENT)realloc(pEvents, sizeof(struct TraceEvent) * nCapacity);
+        }
+    }
+
+    *pnCount = nCount;
+    return pEvents;
+}
+
+/*
+ * Apply a trace's events to a tree, counting them by type and the
+ * searches and iterator steps that found an entry. Iterators still
+ * attached at the end of the trace are detached.
+ */
+void Replay(TREE pTree, TRACEEVENT pEvents, long nCount, long *pnCounts, long *pnFound)
+{
+    ITERATOR pIterators[TRACE_MAX_ITERATORS] = { NULL };
+    ITERATOR pIter = NULL;
+    TRACEEVENT pEvent;
+    long i;
+
+    for (i = 0; i < nCount; i++)
+    {
+        pEvent = &pEvents[i];
+        pnCounts[pEvent->nEvent]++;
+
+        if (pEvent->nIterator >= 0)
+        {
+            pIter = pIterators[pEvent->nIterator];
+            if (pIter == NULL)
+            {
+                pIter = pIterators[pEvent->nIterator] = AllocIterator();
+            }
+            if (pEvent->nEvent <= TRACE_ATTACH_RANGE)
+            {
+                Detach(pIter);
+                pIter->ucDirection = pEvent->ucDirection;
+            }
+        }
+
+        switch (pEvent->nEvent)
+        {
+        case TRACE_SEARCH:
+            *pnFound += (Search(pEvent->uFirst, pTree) != NULL);
+            break;
+        case TRACE_INSERT:
+            Insert(pEvent->uFirst, (void *)1, pTree);
+            break;
+        case TRACE_REMOVE:
+            Remove(pEvent->uFirst, pTree);
+            break;
+        case TRACE_ATTACH:
+            Attach(pIter, pTree);
+            break;
+        case TRACE_ATTACH_AT:
+            AttachAt(pIter, pTree, pEvent->uFirst);
+            break;
+        case TRACE_ATTACH_RANGE:
+            AttachRange(pIter, pTree, pEvent->uFirst, pEvent->uSecond);
+            break;
+        case TRACE_NEXT:
+            *pnFound += (Next(pIter) != NULL);
+            break;
+        case TRACE_DETACH:
+            Detach(pIter);
+            break;
+        }
+    }
+
+    for (i = 0; i < TRACE_MAX_ITERATORS; i++)
+    {
+        if (pIterators[i] != NULL)
+        {
+            Detach(pIterators[i]);
+            FreeIterator(pIterators[i]);
+        }
+    }
+}
+
+/*
+ * Return a monotonic timestamp in nanoseconds.
+ */
+long long NowNanoseconds()
+{
+    struct timespec sTime;
+    clock_gettime(CLOCK_MONOTONIC, &sTime);
+    return (long long)sTime.tv_sec * 1000000000LL + sTime.tv_nsec;
+}
+
+/*
+ * Print the command line options.
+ */
+void Usage(const char *szProgram)
+{
+    fprintf(stderr,
+        "Usage: %s [options] trace\n"
+        "  -t tree     plain, avl, rb, btree, compact, lean, persistent, splay or semisplay (avl)\n"
+        "  -K period   splay trees splay every period-th access (1)\n"
+        "  -P -T -O    pooled, threaded and order statistics tree flags\n",
+        szProgram);
+}
\ No newline at end of file